@@ -21,7 +21,7 @@
 #include <functional>
 
 #include "cemitter.h"
-#include "async_queued_progress_worker.hpp"
+#include "async_event_emitting_worker.hpp"
 #include "eventemitter_impl.hpp"
 
 namespace NodeEvent {
@@ -32,46 +32,66 @@ namespace NodeEvent {
 /// single-threaded C library code, and passing to those C functions an emitter which can report back events as they
 /// happen. The emitter will enqueue the events to be picked up and handled by the v8 thread, and so will not block
 /// the worker thread for longer than 3 mutex acquires. If the number of queued events exceeds SIZE, subsequent
-/// events will be silently discarded.
-template <size_t SIZE>
-class AsyncEventEmittingCWorker : public AsyncQueuedProgressWorker<EventEmitter::ProgressReport, SIZE> {
+/// events will be silently discarded. Events given to prioritize() are queued separately (PRIORITY_SIZE), and never
+/// discarded.
+template <size_t SIZE, size_t PRIORITY_SIZE = 16>
+class AsyncEventEmittingCWorker : public AsyncEventEmittingWorker<SIZE, PRIORITY_SIZE> {
  public:
+    typedef typename AsyncEventEmittingWorker<SIZE, PRIORITY_SIZE>::ExecutionProgressSender ExecutionProgressSender;
+
     /// @param[in] callback - the callback to invoke after Execute completes. (unless overridden, is called from
     ///                      HandleOKCallback with no arguments, and called from HandleErrorCallback with the errors
     ///                      reported (if any)
     /// @param[in] emitter - The emitter object to use for notifying JS callbacks for given events.
     AsyncEventEmittingCWorker(Nan::Callback* callback, std::shared_ptr<EventEmitter> emitter)
-        : AsyncQueuedProgressWorker<EventEmitter::ProgressReport, SIZE>(callback), emitter_(emitter) {}
+        : AsyncEventEmittingWorker<SIZE, PRIORITY_SIZE>(callback, emitter) {}
 
     /// The work you need to happen in a worker thread
-    /// @param[in] fn - Function suitable for passing to single-threaded C code (uses a thread_local static)
+    /// @param[in] fn - Function suitable for passing to single-threaded C code (uses a thread_local static); returns
+    ///                 EVENTEMITTER_DROPPED (0) for a throttled event, so that it is retried (see emit_status)
     virtual void ExecuteWithEmitter(eventemitter_fn fn) = 0;
 
-    /// emit the ProgressReport as an event via the given emitter, ignores whether or not the emit is successful
-    ///
-    /// @param[in] report - an array (of size 1) of a ProgressReport (which is a pair, where first is the "key" and
-    ///                     second is the "value")
-    /// @param[in] size - size of the array (should always be 1)
-    virtual void HandleProgressCallback(const EventEmitter::ProgressReport* report, size_t size) override {
-        UNUSED(size);
-        Nan::HandleScope scope;
+ protected:
+    /// The function given to ExecuteWithEmitter, but returning EVENTEMITTER_THROTTLED for a throttled event rather
+    /// than EVENTEMITTER_DROPPED (see cemitter.h); valid on the same thread
+    static int emit_status(const char* ev, const char* value) { return emitterFunc(nullptr)(ev, value); }
+
+    /// Batch counterparts of the function given to ExecuteWithEmitter, to pass to the C code along with it (see
+    /// cemitter.h); valid on the same thread
+    static int emit_batch(const char* const* evs, const char* const* values, size_t count) {
+        return batchFunc(nullptr)(evs, values, count, false);
+    }
 
-        emitter_->emit(report[0].first, report[0].second);
+    static int emit_values(const char* ev, const char* const* values, size_t count) {
+        return batchFunc(nullptr)(&ev, values, count, true);
     }
 
+    /// Lossless counterpart of the function given to ExecuteWithEmitter (see cemitter.h); valid on the same thread
+    static int emit_blocking(const char* ev, const char* value, long timeout_ms) {
+        return blockingFunc(nullptr)(ev, value, timeout_ms);
+    }
+
+    /// Cancellation poll for the C code (see cemitter.h): non-zero once the work has been cancelled; valid on the
+    /// same thread
+    static int is_cancelled() { return cancelledFunc(nullptr)(); }
+
  private:
-    virtual void Execute(const typename AsyncQueuedProgressWorker<EventEmitter::ProgressReport, SIZE>::ExecutionProgressSender&
-                             sender) final override {
+    virtual void Execute(const ExecutionProgressSender& sender) final override {
         // XXX(jrb): This will not work if the C library is multithreaded, as the c_emitter_func_ will be
         // uninitialized in any threads other than the one we're running in right now
-        emitterFunc([&sender](const char* ev, const char* val) -> int {
-            // base class uses delete[], so we have to make sure we use new[]
-            auto reports = new EventEmitter::ProgressReport[1];
-            reports[0] = {ev, val};
-
-            return static_cast<int>(sender.Send(reports, 1));
+        emitterFunc([this, &sender](const char* ev, const char* val) -> int {
+            return this->emitEvent(sender, ev, val);
         });
+        batchFunc([this, &sender](const char* const* evs, const char* const* values, size_t count,
+                                  bool same_event) -> int {
+            return this->emitEvents(sender, evs, values, count, same_event);
+        });
+        blockingFunc([this, &sender](const char* ev, const char* val, long timeout_ms) -> int {
+            return this->emitEvent(sender, ev, val, this->waitFor(timeout_ms));
+        });
+        cancelledFunc([this]() -> int { return this->IsCancelled(); });
         ExecuteWithEmitter(this->emit);
+        this->flushAggregates(sender);
     }
 
     static std::function<int(const char*, const char*)> emitterFunc(std::function<int(const char*, const char*)> fn) {
@@ -83,8 +103,44 @@ class AsyncEventEmittingCWorker : public AsyncQueuedProgressWorker<EventEmitter:
         return c_emitter_func_;
     }
 
-    static int emit(const char* ev, const char* val) { return emitterFunc(nullptr)(ev, val); }
-    std::shared_ptr<EventEmitter> emitter_;
+    typedef std::function<int(const char* const*, const char* const*, size_t, bool)> BatchFunc;
+
+    static BatchFunc batchFunc(BatchFunc fn) {
+        // XXX(jrb): This will not work if the C library is multithreaded
+        static thread_local BatchFunc c_batch_func_ = nullptr;
+        if (fn != nullptr) {
+            c_batch_func_ = fn;
+        }
+        return c_batch_func_;
+    }
+
+    typedef std::function<int(const char*, const char*, long)> BlockingFunc;
+
+    static BlockingFunc blockingFunc(BlockingFunc fn) {
+        // XXX(jrb): This will not work if the C library is multithreaded
+        static thread_local BlockingFunc c_blocking_func_ = nullptr;
+        if (fn != nullptr) {
+            c_blocking_func_ = fn;
+        }
+        return c_blocking_func_;
+    }
+
+    typedef std::function<int()> CancelledFunc;
+
+    static CancelledFunc cancelledFunc(CancelledFunc fn) {
+        // XXX(jrb): This will not work if the C library is multithreaded
+        static thread_local CancelledFunc c_cancelled_func_ = nullptr;
+        if (fn != nullptr) {
+            c_cancelled_func_ = fn;
+        }
+        return c_cancelled_func_;
+    }
+
+    static int emit(const char* ev, const char* val) {
+        int r = emitterFunc(nullptr)(ev, val);
+        // cancellation stays non-zero, so that a loop retrying until the emit succeeds ends
+        return r == EVENTEMITTER_THROTTLED ? EVENTEMITTER_DROPPED : r;
+    }
 };
 
 }  // namespace NodeEvent
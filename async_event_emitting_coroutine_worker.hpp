@@ -0,0 +1,112 @@
+/*
+ * Copyright 2017 Scoop Technologies
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE
+ * WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+ * OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#pragma once
+#ifndef _NODE_EVENT_ASYNC_EVENT_EMITTING_COROUTINE_WORKER_H
+#define _NODE_EVENT_ASYNC_EVENT_EMITTING_COROUTINE_WORKER_H
+
+// Coroutines need C++20; with an older standard this header is empty, so it can be included unconditionally
+#if defined(__cpp_impl_coroutine) && __cpp_impl_coroutine >= 201902L
+
+#include <chrono>
+#include <exception>
+#include <utility>
+
+#include "async_event_emitting_worker.hpp"
+#include "emit_task.hpp"
+#include "eventemitter_impl.hpp"
+
+namespace NodeEvent {
+/// AsyncEventEmittingCoroutineWorker runs any number of EmitTasks (see emit_task.hpp) on the one worker thread,
+/// switching between them as they emit and wait, rather than occupying a thread per source of events which is mostly
+/// idle. A task whose event doesn't fit in the queue is suspended until the loop thread has made room, so events are
+/// never dropped, while the other tasks run on; the worker thread only parks once every task is waiting. The worker
+/// completes once all its tasks have, with the error of the first task to throw, if any.
+///
+///     auto worker = new AsyncEventEmittingCoroutineWorker<64>(callback, emitter);
+///     for (auto& sensor : sensors) {
+///         worker->Spawn(poll(sensor));
+///     }
+///     Nan::AsyncQueueWorker(worker);
+///
+/// Once the work is cancelled (see AsyncQueuedProgressWorker::Cancel), tasks are destroyed rather than resumed, which
+/// runs the destructors of their locals; a task waiting on a Resumer is destroyed once it is resumed.
+///
+/// Events go the way they would from any worker (see AsyncEventEmittingWorker::emitEvent). A worker under flow control
+/// should be given credits which don't park (FlowCredits(n, false)); a task which is throttled waits, as for room.
+template <size_t SIZE, size_t PRIORITY_SIZE = 16>
+class AsyncEventEmittingCoroutineWorker : public AsyncEventEmittingWorker<SIZE, PRIORITY_SIZE> {
+ public:
+    typedef typename AsyncEventEmittingWorker<SIZE, PRIORITY_SIZE>::ExecutionProgressSender ExecutionProgressSender;
+
+    /// @param[in] callback - the callback to invoke once every task has completed. (unless overridden, is called
+    ///                      from HandleOKCallback with no arguments, and called from HandleErrorCallback with the
+    ///                      error of the first task to throw, if any)
+    /// @param[in] emitter - The emitter object to use for notifying JS callbacks for given events.
+    AsyncEventEmittingCoroutineWorker(Nan::Callback* callback, std::shared_ptr<EventEmitter> emitter)
+        : AsyncEventEmittingWorker<SIZE, PRIORITY_SIZE>(callback, emitter),
+          runner_([this]() { this->WakeSenders(); }) {}
+
+    /// Add a task. Must be called before the worker is queued.
+    ///
+    /// @param[in] task - the task
+    void Spawn(EmitTask task) { runner_.spawn(std::move(task)); }
+
+ private:
+    /// The worker as its runner sees it, for the duration of Execute
+    class Host {
+     public:
+        Host(AsyncEventEmittingCoroutineWorker& worker, const ExecutionProgressSender& sender)
+            : worker_(worker), sender_(sender) {}
+
+        bool prioritized(const char* ev) { return worker_.prioritized(ev); }
+        bool writable() { return worker_.Writable(); }
+        int emit(const char* ev, const char* value) { return worker_.emitEvent(sender_, ev, value); }
+        bool cancelled() { return worker_.IsCancelled(); }
+
+        template <class Ready>
+        bool wait(Ready ready, std::chrono::nanoseconds timeout) {
+            return worker_.WaitForQueue(ready, timeout);
+        }
+
+     private:
+        AsyncEventEmittingCoroutineWorker& worker_;
+        const ExecutionProgressSender& sender_;
+    };
+
+    virtual void Execute(const ExecutionProgressSender& sender) final override {
+        Host host{*this, sender};
+        runner_.run(host);
+        if (auto exception = runner_.exception()) {
+            try {
+                std::rethrow_exception(exception);
+            } catch (const std::exception& e) {
+                this->SetErrorMessage(e.what());
+            } catch (...) {
+                this->SetErrorMessage("unknown exception in EmitTask");
+            }
+        }
+        this->flushAggregates(sender);
+    }
+
+    EmitTaskRunner runner_;
+};
+
+}  // namespace NodeEvent
+
+#endif  // __cpp_impl_coroutine
+
+#endif
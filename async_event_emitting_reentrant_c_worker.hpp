@@ -21,7 +21,7 @@
 #include <memory>
 
 #include "cemitter.h"
-#include "async_queued_progress_worker.hpp"
+#include "async_event_emitting_worker.hpp"
 #include "eventemitter_impl.hpp"
 
 namespace NodeEvent {
@@ -29,50 +29,88 @@ namespace NodeEvent {
 #define UNUSED(x) (void)(x)
 #endif
 
-template <size_t SIZE>
-class AsyncEventEmittingReentrantCWorker : public AsyncQueuedProgressWorker<EventEmitter::ProgressReport, SIZE> {
+template <size_t SIZE, size_t PRIORITY_SIZE = 16>
+class AsyncEventEmittingReentrantCWorker : public AsyncEventEmittingWorker<SIZE, PRIORITY_SIZE> {
  public:
-    typedef typename AsyncQueuedProgressWorker<EventEmitter::ProgressReport, SIZE>::ExecutionProgressSender ExecutionProgressSender;
+    typedef typename AsyncEventEmittingWorker<SIZE, PRIORITY_SIZE>::ExecutionProgressSender ExecutionProgressSender;
     /// @param[in] callback - the callback to invoke after Execute completes. (unless overridden, is called from
     ///                      HandleOKCallback with no arguments, and called from HandleErrorCallback with the errors
     ///                      reported (if any)
     /// @param[in] emitter - The emitter object to use for notifying JS callbacks for given events.
     AsyncEventEmittingReentrantCWorker(Nan::Callback* callback, std::shared_ptr<EventEmitter> emitter)
-        : AsyncQueuedProgressWorker<EventEmitter::ProgressReport, SIZE>(callback), emitter_(emitter) {}
-
-    /// emit the EventEmitter::ProgressReport as an event via the given emitter, ignores whether or not the emit is successful
-    ///
-    /// @param[in] report - an array (of size 1) of a EventEmitter::ProgressReport (which is a pair, where first is the "key" and
-    ///                     second is the "value")
-    /// @param[in] size - size of the array (should always be 1)
-    virtual void HandleProgressCallback(const EventEmitter::ProgressReport* report, size_t size) override {
-        UNUSED(size);
-        Nan::HandleScope scope;
-        emitter_->emit(report[0].first, report[0].second);
-    }
+        : AsyncEventEmittingWorker<SIZE, PRIORITY_SIZE>(callback, emitter) {}
 
     /// The work you need to happen in a worker thread
     ///
     /// @param[in] sender - An object you must pass as the first argument of fn
-    /// @param[in] fn - Function suitable for passing to multi-threaded C code
+    /// @param[in] fn - Function suitable for passing to multi-threaded C code; returns EVENTEMITTER_DROPPED (0) for a
+    ///                 throttled event, so that it is retried (see reentrant_emit_status)
     virtual void ExecuteWithEmitter(const ExecutionProgressSender* sender, eventemitter_fn_r fn) = 0;
 
- private:
-    virtual void Execute(const ExecutionProgressSender& sender) override {
-        ExecuteWithEmitter(&sender, this->reentrant_emit);
+ protected:
+    /// The function given to ExecuteWithEmitter, but returning EVENTEMITTER_THROTTLED for a throttled event rather
+    /// than EVENTEMITTER_DROPPED (see cemitter.h); takes the same sender
+    static int reentrant_emit_status(const void* sender, const char* ev, const char* value) {
+        if (sender) {
+            auto emitter = static_cast<const ExecutionProgressSender*>(sender);
+            auto& worker = static_cast<AsyncEventEmittingReentrantCWorker&>(emitter->Worker());
+            return worker.emitEvent(*emitter, ev, value);
+        }
+        return false;
     }
 
-    static int reentrant_emit(const void* sender, const char* ev, const char* value) {
+    /// Batch counterparts of the function given to ExecuteWithEmitter, to pass to the C code along with it (see
+    /// cemitter.h); take the same sender
+    static int reentrant_emit_batch(const void* sender, const char* const* evs, const char* const* values,
+                                    size_t count) {
+        if (sender) {
+            auto emitter = static_cast<const ExecutionProgressSender*>(sender);
+            auto& worker = static_cast<AsyncEventEmittingReentrantCWorker&>(emitter->Worker());
+            return worker.emitEvents(*emitter, evs, values, count, false);
+        }
+        return false;
+    }
+
+    static int reentrant_emit_values(const void* sender, const char* ev, const char* const* values, size_t count) {
+        if (sender) {
+            auto emitter = static_cast<const ExecutionProgressSender*>(sender);
+            auto& worker = static_cast<AsyncEventEmittingReentrantCWorker&>(emitter->Worker());
+            return worker.emitEvents(*emitter, &ev, values, count, true);
+        }
+        return false;
+    }
+
+    /// Lossless counterpart of the function given to ExecuteWithEmitter (see cemitter.h); takes the same sender
+    static int reentrant_emit_blocking(const void* sender, const char* ev, const char* value, long timeout_ms) {
+        if (sender) {
+            auto emitter = static_cast<const ExecutionProgressSender*>(sender);
+            auto& worker = static_cast<AsyncEventEmittingReentrantCWorker&>(emitter->Worker());
+            return worker.emitEvent(*emitter, ev, value, worker.waitFor(timeout_ms));
+        }
+        return false;
+    }
+
+    /// Cancellation poll for the C code (see cemitter.h): non-zero once the work has been cancelled; takes the same
+    /// sender
+    static int reentrant_is_cancelled(const void* sender) {
         if (sender) {
-            auto reports = new EventEmitter::ProgressReport[1];
-            reports[0] = {ev, value};
             auto emitter = static_cast<const ExecutionProgressSender*>(sender);
-            return static_cast<int>(emitter->Send(reports, 1));
+            return emitter->Worker().IsCancelled();
         }
         return false;
     }
 
-    std::shared_ptr<EventEmitter> emitter_;
+ private:
+    virtual void Execute(const ExecutionProgressSender& sender) override {
+        ExecuteWithEmitter(&sender, this->reentrant_emit);
+        this->flushAggregates(sender);
+    }
+
+    static int reentrant_emit(const void* sender, const char* ev, const char* value) {
+        int r = reentrant_emit_status(sender, ev, value);
+        // cancellation stays non-zero, so that a loop retrying until the emit succeeds ends
+        return r == EVENTEMITTER_THROTTLED ? EVENTEMITTER_DROPPED : r;
+    }
 };
 
 }  // namespace NodeEvent
@@ -0,0 +1,479 @@
+/*
+ * Copyright 2017 Scoop Technologies
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE
+ * WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+ * OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#pragma once
+#ifndef _NODE_EVENT_ASYNC_EVENT_EMITTING_WORKER_H
+#define _NODE_EVENT_ASYNC_EVENT_EMITTING_WORKER_H
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "async_queued_progress_worker.hpp"
+#include "cemitter.h"
+#include "event_aggregator.hpp"
+#include "event_limiter.hpp"
+#include "eventemitter_impl.hpp"
+#include "probes.hpp"
+
+namespace NodeEvent {
+/// AsyncEventEmittingWorker is what AsyncEventEmittingCWorker and AsyncEventEmittingReentrantCWorker have in common:
+/// the path an event takes from the worker thread into the queue, and its dispatch to the EventEmitter on the v8
+/// thread.
+template <size_t SIZE, size_t PRIORITY_SIZE = 16>
+class AsyncEventEmittingWorker : public AsyncQueuedProgressWorker<EventEmitter::ProgressReport, SIZE, PRIORITY_SIZE> {
+ public:
+    typedef typename AsyncQueuedProgressWorker<EventEmitter::ProgressReport, SIZE,
+                                               PRIORITY_SIZE>::ExecutionProgressSender ExecutionProgressSender;
+
+    /// @param[in] callback - the callback to invoke after Execute completes. (unless overridden, is called from
+    ///                      HandleOKCallback with no arguments, and called from HandleErrorCallback with the errors
+    ///                      reported (if any)
+    /// @param[in] emitter - The emitter object to use for notifying JS callbacks for given events.
+    AsyncEventEmittingWorker(Nan::Callback* callback, std::shared_ptr<EventEmitter> emitter)
+        : AsyncQueuedProgressWorker<EventEmitter::ProgressReport, SIZE, PRIORITY_SIZE>(callback,
+                                                                                       emitter->queueStats()),
+          emitter_(emitter),
+          cancellations_(emitter->cancellations()),
+          aggregator_(),
+          limiter_(),
+          priorities_(),
+          expiry_(nullptr) {}
+
+    /// emit each ProgressReport as an event via the given emitter, ignores whether or not the emit is successful
+    ///
+    /// @param[in] report - an array of ProgressReports (which are pairs, where first is the "key" and second is the
+    ///                     "value", carrying the hash of the key)
+    /// @param[in] size - size of the array
+    virtual void HandleProgressCallback(const EventEmitter::ProgressReport* report, size_t size) override {
+        Nan::HandleScope scope;
+
+        for (size_t i = 0; i < size; ++i) {
+            if (report[i].pinned != EventReport::unpinned) {
+                emitter_->emit(report[i].pinned, report[i].second, this->ProgressEnqueuedAt());
+            } else {
+                emitter_->emit(report[i].first, report[i].hash, report[i].second, this->ProgressEnqueuedAt());
+            }
+        }
+    }
+
+    /// Aggregate the numeric values of an event: rather than one event per value, the loop thread listeners receive
+    /// one summary per window (see EventAggregator). Inline native listeners still receive every value. A timer on
+    /// the loop thread closes the windows which have elapsed, so the summary of a window whose event has gone quiet
+    /// is delivered at most the shortest window later, rather than held until the next value or the end of the work.
+    /// Must be called on the loop thread, before the worker is queued.
+    ///
+    /// @param[in] ev - event name
+    /// @param[in] window - length of each window
+    void aggregate(const std::string& ev, std::chrono::milliseconds window) {
+        aggregator_.aggregate(ev, window);
+        if (!expiry_) {
+            expiry_ = new uv_timer_t();
+            uv_timer_init(uv_default_loop(), expiry_);
+            expiry_->data = this;
+        }
+        uint64_t period = std::max<uint64_t>(1, static_cast<uint64_t>(aggregator_.shortest().count()));
+        uv_timer_start(expiry_, Expire, period, period);
+    }
+
+    /// Rate limit an event: at most per_second are delivered on average, in bursts of up to burst, and the rest are
+    /// suppressed as they are emitted, before anything is allocated or queued (see EventLimiter). Must be called
+    /// before the worker is queued.
+    ///
+    /// @param[in] ev - event name
+    /// @param[in] per_second - the sustained rate; must be positive
+    /// @param[in] burst - the most events delivered back to back
+    ///
+    /// @throws std::invalid_argument if the rate is out of range (see EventLimiter::rateLimit)
+    void rateLimit(const std::string& ev, double per_second, double burst = 1) {
+        limiter_.rateLimit(ev, per_second, burst);
+    }
+
+    /// Deliver only every nth of an event, suppressing the rest as they are emitted (see EventLimiter). Must be
+    /// called before the worker is queued.
+    ///
+    /// @param[in] ev - event name
+    /// @param[in] n - sampling period
+    void sample(const std::string& ev, uint32_t n) { limiter_.sample(ev, n); }
+
+    /// Send an event through the priority lane, so that it overtakes the ordinary events queued before it and is
+    /// never dropped (see AsyncQueuedProgressWorker). Meant for rare events, such as errors and completion. Must be
+    /// called before the worker is queued.
+    ///
+    /// @param[in] ev - event name
+    void prioritize(const std::string& ev) { priorities_.push_back(ev); }
+
+    /// @returns how many of each rate limited or sampled event were delivered and suppressed
+    std::vector<EventLimiter::Suppressed> Suppressed() const { return limiter_.suppressed(); }
+
+    /// @returns true once the work has been cancelled, through Cancel() or the emitter's cancel()
+    virtual bool IsCancelled() const override {
+        return AsyncQueuedProgressWorker<EventEmitter::ProgressReport, SIZE, PRIORITY_SIZE>::IsCancelled() ||
+               emitter_->cancellations() != cancellations_;
+    }
+
+    /// stop closing aggregation windows on the timer (the rest are flushed as the work completes), then close the
+    /// queue
+    virtual void Destroy() override {
+        if (expiry_) {
+            uv_timer_stop(expiry_);
+            // NOTABUG: libuv handles are all uv_handle_t underneath
+            uv_close(reinterpret_cast<uv_handle_t*>(expiry_), ExpiryClosed);
+            expiry_ = nullptr;
+        }
+        AsyncQueuedProgressWorker<EventEmitter::ProgressReport, SIZE, PRIORITY_SIZE>::Destroy();
+    }
+
+ protected:
+    /// Deliver an event from the worker thread, unless it is rate limited or sampled out: take a flow control credit
+    /// if the worker is flow controlled, notify the inline native listeners, then fold it into its window if it is
+    /// aggregated, otherwise queue it for the loop thread (unless it is dropped there and then because no listener on
+    /// the loop thread wants it; see EventEmitter::dropUnheard). If the emitter is capturing, an event delivered (or
+    /// suppressed) is written to its log as emitted.
+    ///
+    /// @param[in] sender - sender for this worker
+    /// @param[in] ev - event name
+    /// @param[in] value - event value
+    /// @param[in] wait - how long to wait for room if the queue is full, rather than dropping the event (see
+    ///                   waitFor); this bounds the wait for a credit, too
+    ///
+    /// @returns EVENTEMITTER_DROPPED (0) if the event was dropped because the queue was full, EVENTEMITTER_THROTTLED
+    ///          if there were no credits (and the worker doesn't park, or none was granted within a blocking emit's
+    ///          wait), EVENTEMITTER_CANCELLED if the work has been
+    ///          cancelled (the event is discarded), EVENTEMITTER_OK otherwise (including when it was suppressed, which
+    ///          isn't worth retrying)
+    int emitEvent(const ExecutionProgressSender& sender, const char* ev, const char* value,
+                  std::chrono::nanoseconds wait = std::chrono::nanoseconds::zero()) {
+        return emitEvent(sender, ev, unpinned, value, wait);
+    }
+
+    /// emitEvent for an event the emitter has pinned (see EventEmitter::pin), whose listeners are found without
+    /// looking its name up, both here and on the loop thread
+    ///
+    /// @param[in] sender - sender for this worker
+    /// @param[in] ev - event name
+    /// @param[in] pinned - the number the emitter pinned ev as, or unpinned
+    /// @param[in] value - event value
+    /// @param[in] wait - how long to wait for room if the queue is full
+    ///
+    /// @returns as emitEvent
+    int emitEvent(const ExecutionProgressSender& sender, const char* ev, size_t pinned, const char* value,
+                  std::chrono::nanoseconds wait = std::chrono::nanoseconds::zero()) {
+        uint64_t emitted = emitter_->capturing() ? uv_hrtime() : 0;
+        int r = deliverEvent(sender, ev, pinned, value, wait);
+        if (emitted != 0 && r == EVENTEMITTER_OK) {
+            capture(emitted, &ev, &value, 1, true);
+        }
+        return r;
+    }
+
+    /// @param[in] timeout_ms - a blocking emit function's timeout (see cemitter.h)
+    ///
+    /// @returns the wait for emitEvent
+    static std::chrono::nanoseconds waitFor(long timeout_ms) {
+        if (timeout_ms < 0) {
+            return std::chrono::nanoseconds::max();
+        }
+        return std::chrono::milliseconds(timeout_ms);
+    }
+
+    /// Deliver a batch of events from the worker thread. Each event goes the way emitEvent would send it, except that
+    /// the ordinary events to be queued go together, in one report: one slot of the queue, one credit, one wakeup of
+    /// the loop thread. A batch of only prioritized events takes no credit, as they wouldn't singly. If the emitter is
+    /// capturing, the batch is written to its log as emitted once it is delivered.
+    ///
+    /// @param[in] sender - sender for this worker
+    /// @param[in] evs - event names (only evs[0] if same_event)
+    /// @param[in] values - event values
+    /// @param[in] count - number of events
+    /// @param[in] same_event - whether every event is evs[0]
+    ///
+    /// @returns EVENTEMITTER_DROPPED (0) if the events to be queued were dropped, EVENTEMITTER_THROTTLED if there
+    ///          were no credits (and nothing else happened), EVENTEMITTER_CANCELLED if the work has been cancelled (and
+    ///          nothing else happened), EVENTEMITTER_OK otherwise
+    int emitEvents(const ExecutionProgressSender& sender, const char* const* evs, const char* const* values,
+                   size_t count, bool same_event) {
+        uint64_t emitted = emitter_->capturing() ? uv_hrtime() : 0;
+        int r = deliverEvents(sender, evs, values, count, same_event);
+        if (emitted != 0 && r == EVENTEMITTER_OK && count > 0) {
+            capture(emitted, evs, values, count, same_event);
+        }
+        return r;
+    }
+
+    /// Send the summaries of all the open aggregation windows; called once the work is complete
+    ///
+    /// @param[in] sender - sender for this worker
+    void flushAggregates(const ExecutionProgressSender& sender) {
+        if (aggregator_.empty()) {
+            return;
+        }
+        std::vector<EventAggregator::Summary> summaries;
+        aggregator_.flush(summaries);
+        sendSummaries(sender, summaries);
+    }
+
+    /// @returns true if ev goes through the priority lane
+    bool prioritized(const char* ev) const {
+        for (auto& priority : priorities_) {
+            if (std::strcmp(priority.c_str(), ev) == 0) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    /// the pinned number of an event which isn't pinned
+    static constexpr size_t unpinned = EventReport::unpinned;
+
+    std::shared_ptr<EventEmitter> emitter_;
+
+ private:
+    /// emitEvent, but for capturing
+    int deliverEvent(const ExecutionProgressSender& sender, const char* ev, size_t pinned, const char* value,
+                     std::chrono::nanoseconds wait) {
+        NODE_EVENT_PROBE2(emit, ev, value);
+        if (this->IsCancelled()) {
+            return EVENTEMITTER_CANCELLED;
+        }
+        // take the credit first, so that a throttled event has had no effect at all (not even on the limiter) and can
+        // simply be emitted again
+        bool priority = prioritized(ev);
+        if (!priority && !acquireCredit(wait)) {
+            if (this->IsCancelled()) {
+                return EVENTEMITTER_CANCELLED;
+            }
+            NODE_EVENT_PROBE1(throttle, ev);
+            return EVENTEMITTER_THROTTLED;
+        }
+        if (!limiter_.empty() && !limiter_.admit(ev)) {
+            refund(priority);
+            NODE_EVENT_PROBE1(suppress, ev);
+            return EVENTEMITTER_OK;
+        }
+        // an unpinned name is hashed once, here, for both the inline listeners and the loop thread; a pinned one is
+        // found by its number on both, and only hashed if it has to be folded into a window
+        uint64_t hash = pinned == unpinned ? StringHash::of(ev) : 0;
+        // inline native listeners are notified here; the event may skip the queue if the loop thread has no listeners
+        bool needs_loop =
+            pinned == unpinned ? emitter_->emitInline(ev, hash, value) : emitter_->emitInline(pinned, value);
+        if (!needs_loop) {
+            refund(priority);
+            return EVENTEMITTER_OK;
+        }
+
+        if (!aggregator_.empty()) {
+            if (pinned != unpinned) {
+                hash = StringHash::of(ev);
+            }
+            std::vector<EventAggregator::Summary> summaries;
+            if (aggregator_.fold(ev, hash, value, summaries)) {
+                refund(priority);
+                sendSummaries(sender, summaries);
+                return EVENTEMITTER_OK;
+            }
+        }
+
+        // base class uses delete[], so we have to make sure we use new[]
+        auto reports = new EventEmitter::ProgressReport[1];
+        reports[0] = {ev, value, hash, pinned};
+
+        if (!send(sender, reports, 1, priority, wait)) {
+            delete[] reports;
+            refund(priority);
+            // a blocking send gives up without dropping once the work is cancelled
+            return wait != std::chrono::nanoseconds::zero() && this->IsCancelled() ? EVENTEMITTER_CANCELLED
+                                                                                     : EVENTEMITTER_DROPPED;
+        }
+        return EVENTEMITTER_OK;
+    }
+
+    /// emitEvents, but for capturing
+    int deliverEvents(const ExecutionProgressSender& sender, const char* const* evs, const char* const* values,
+                      size_t count, bool same_event) {
+        if (this->IsCancelled()) {
+            return EVENTEMITTER_CANCELLED;
+        }
+        if (count == 0) {
+            return EVENTEMITTER_OK;
+        }
+        // the credit is taken up front, so that a throttled batch has had no effect at all; but only if there is an
+        // ordinary event which might need it
+        bool ordinary = false;
+        for (size_t i = 0; i < (same_event ? 1 : count) && !ordinary; ++i) {
+            ordinary = !prioritized(evs[i]);
+        }
+        if (ordinary && !this->AcquireCredit()) {
+            if (this->IsCancelled()) {
+                return EVENTEMITTER_CANCELLED;
+            }
+            NODE_EVENT_PROBE1(throttle, evs[0]);
+            return EVENTEMITTER_THROTTLED;
+        }
+
+        int r = EVENTEMITTER_OK;
+        auto reports = new EventEmitter::ProgressReport[count];
+        size_t queued = 0;
+        std::vector<EventAggregator::Summary> summaries;
+        for (size_t i = 0; i < count; ++i) {
+            const char* ev = same_event ? evs[0] : evs[i];
+            NODE_EVENT_PROBE2(emit, ev, values[i]);
+            if (!limiter_.empty() && !limiter_.admit(ev)) {
+                NODE_EVENT_PROBE1(suppress, ev);
+                continue;
+            }
+            uint64_t hash = StringHash::of(ev);
+            if (!emitter_->emitInline(ev, hash, values[i])) {
+                continue;
+            }
+            if (!aggregator_.empty() && aggregator_.fold(ev, hash, values[i], summaries)) {
+                continue;
+            }
+            if (prioritized(ev)) {
+                auto report = new EventEmitter::ProgressReport[1];
+                report[0] = {ev, values[i], hash};
+                if (!send(sender, report, 1, true)) {
+                    delete[] report;
+                    r = EVENTEMITTER_DROPPED;
+                }
+                continue;
+            }
+            reports[queued++] = {ev, values[i], hash};
+        }
+        sendSummaries(sender, summaries);
+
+        if (queued == 0) {
+            delete[] reports;
+            refund(!ordinary);
+            return r;
+        }
+        if (!send(sender, reports, queued)) {
+            delete[] reports;
+            this->RefundCredit();
+            return EVENTEMITTER_DROPPED;
+        }
+        return r;
+    }
+
+    /// Take a credit for an ordinary event. A blocking emit parks for it for no longer than its wait, and is left to
+    /// wait for room in the queue only for what remains.
+    ///
+    /// @param[in,out] wait - how long emitEvent may wait
+    ///
+    /// @returns as AcquireCredit
+    bool acquireCredit(std::chrono::nanoseconds& wait) {
+        if (wait == std::chrono::nanoseconds::zero()) {
+            return this->AcquireCredit();
+        }
+        if (wait == std::chrono::nanoseconds::max()) {
+            return this->AcquireCredit(wait);
+        }
+        auto started = std::chrono::steady_clock::now();
+        if (!this->AcquireCredit(wait)) {
+            return false;
+        }
+        // at least a nanosecond, so the send still counts as blocking (see send)
+        auto waited = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - started);
+        wait = std::max(std::chrono::nanoseconds(1), wait - waited);
+        return true;
+    }
+
+    bool send(const ExecutionProgressSender& sender, const EventEmitter::ProgressReport* reports, size_t size,
+              bool priority = false, std::chrono::nanoseconds wait = std::chrono::nanoseconds::zero()) {
+        if (wait != std::chrono::nanoseconds::zero() && !priority) {
+            return sender.SendBlocking(reports, size, wait);
+        }
+        return sender.Send(reports, size, priority);
+    }
+
+    // Invoked on the loop thread by the expiry timer: dispatch the windows which have elapsed, after what's already
+    // queued (including the summaries of earlier windows), so that the summaries of an event stay in order
+    static void Expire(uv_timer_t* timer) {
+        auto worker = static_cast<AsyncEventEmittingWorker*>(timer->data);
+        if (!worker->HandleQueuedProgress()) {
+            // try again once the overflow has been replayed
+            return;
+        }
+        std::vector<EventAggregator::Summary> summaries;
+        worker->aggregator_.expire(summaries);
+
+        Nan::HandleScope scope;
+        for (auto& summary : summaries) {
+            worker->emitter_->emit(summary.first, summary.second);
+        }
+    }
+
+    // The worker may be deleted before the timer's handle is closed, so the handle is freed on its own
+    static void ExpiryClosed(uv_handle_t* handle) { delete reinterpret_cast<uv_timer_t*>(handle); }
+
+    /// Write events to the emitter's capture log as they were emitted
+    ///
+    /// @param[in] emitted - when they were emitted
+    /// @param[in] evs - event names (only evs[0] if same_event)
+    /// @param[in] values - event values
+    /// @param[in] count - number of events
+    /// @param[in] same_event - whether every event is evs[0]
+    void capture(uint64_t emitted, const char* const* evs, const char* const* values, size_t count,
+                 bool same_event) const {
+        std::vector<EventEmitter::ProgressReport> reports;
+        reports.reserve(count);
+        for (size_t i = 0; i < count; ++i) {
+            reports.emplace_back(same_event ? evs[0] : evs[i], values[i]);
+        }
+        emitter_->capture(emitted, reports.data(), count);
+    }
+
+    /// Give back the credit an ordinary event took, as it won't be queued after all
+    void refund(bool priority) {
+        if (!priority) {
+            this->RefundCredit();
+        }
+    }
+
+    bool sendSummaries(const ExecutionProgressSender& sender, std::vector<EventAggregator::Summary>& summaries) {
+        if (summaries.empty()) {
+            return true;
+        }
+        auto reports = new EventEmitter::ProgressReport[summaries.size()];
+        for (size_t i = 0; i < summaries.size(); ++i) {
+            reports[i] = std::move(summaries[i]);
+        }
+        // summaries are few, and come due as windows close; they don't wait for credits, but are still paced by them
+        this->ConsumeCredit();
+        if (!send(sender, reports, summaries.size())) {
+            delete[] reports;
+            this->RefundCredit();
+            return false;
+        }
+        return true;
+    }
+
+    // the emitter's cancellations() when the worker was created
+    uint64_t cancellations_;
+    EventAggregator aggregator_;
+    EventLimiter limiter_;
+    std::vector<std::string> priorities_;
+    // closes the elapsed aggregation windows, on the loop thread; only while events are aggregated
+    uv_timer_t* expiry_;
+};
+
+}  // namespace NodeEvent
+
+#endif
@@ -0,0 +1,89 @@
+/*
+ * Copyright 2017 Scoop Technologies
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE
+ * WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+ * OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#pragma once
+#ifndef _NODE_EVENT_ASYNC_EVENT_LOG_REPLAY_WORKER_H
+#define _NODE_EVENT_ASYNC_EVENT_LOG_REPLAY_WORKER_H
+
+#include <chrono>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <thread>
+
+#include "async_event_emitting_worker.hpp"
+#include "event_log.hpp"
+#include "eventemitter_impl.hpp"
+
+namespace NodeEvent {
+/// AsyncEventLogReplayWorker emits the events of a captured log (see EventEmitter::startCapture) through an emitter,
+/// exactly as the workers which sent them did, so that listeners and the library can be benchmarked against real event
+/// streams without the C library or its input. Unlike the C workers, a full queue is waited out rather than dropping
+/// events, so every captured event is replayed. If the log can't be read, the callback receives the error.
+template <size_t SIZE>
+class AsyncEventLogReplayWorker : public AsyncEventEmittingWorker<SIZE> {
+ public:
+    typedef typename AsyncEventEmittingWorker<SIZE>::ExecutionProgressSender ExecutionProgressSender;
+
+    /// @param[in] callback - the callback to invoke once the log has been replayed
+    /// @param[in] emitter - the emitter to replay the events through
+    /// @param[in] path - the log to replay
+    /// @param[in] speed - 1 to replay at the speed the events were captured, 2 for twice as fast, etc.; 0 to replay
+    ///                    as fast as possible
+    AsyncEventLogReplayWorker(Nan::Callback* callback, std::shared_ptr<EventEmitter> emitter, const std::string& path,
+                              double speed)
+        : AsyncEventEmittingWorker<SIZE>(callback, emitter), path_(path), speed_(speed) {}
+
+ private:
+    virtual void Execute(const ExecutionProgressSender& sender) final override {
+        try {
+            EventLog::Reader reader{path_};
+            EventLog::Record record;
+            auto start = std::chrono::steady_clock::now();
+            uint64_t first = 0;
+
+            for (bool more = reader.next(record); more && !this->IsCancelled(); more = reader.next(record)) {
+                if (speed_ > 0) {
+                    if (first == 0) {
+                        first = record.timestamp;
+                    }
+                    std::chrono::duration<double, std::nano> offset((record.timestamp - first) / speed_);
+                    std::this_thread::sleep_until(
+                        start + std::chrono::duration_cast<std::chrono::steady_clock::duration>(offset));
+                }
+                for (auto& report : record.reports) {
+                    int r;
+                    while ((r = this->emitEvent(sender, report.first.c_str(), report.second.c_str())) !=
+                           EVENTEMITTER_OK) {
+                        if (r == EVENTEMITTER_CANCELLED) {
+                            return;
+                        }
+                        std::this_thread::yield();
+                    }
+                }
+            }
+        } catch (const std::exception& e) {
+            this->SetErrorMessage(e.what());
+        }
+    }
+
+    std::string path_;
+    double speed_;
+};
+
+}  // namespace NodeEvent
+
+#endif
@@ -18,6 +18,8 @@
 #ifndef _NODE_EVENT_ASYNC_QUEUED_PROGRESS_WORKER_H
 #define _NODE_EVENT_ASYNC_QUEUED_PROGRESS_WORKER_H
 
+#include <atomic>
+#include <chrono>
 #include <functional>
 #include <memory>
 #include <string>
@@ -25,7 +27,10 @@
 #include <nan.h>
 #include <uv.h>
 
-#include "shared_ringbuffer.hpp"
+#include "flow_credits.hpp"
+#include "probes.hpp"
+#include "progress_queue.hpp"
+#include "spill_file.hpp"
 
 namespace NodeEvent {
 /// Unfortunately, the AsyncProgressWorker in NAN uses a single element which it populates and notifies the handler
@@ -34,7 +39,11 @@ namespace NodeEvent {
 ///
 /// AsyncQueuedProgressWorker provides a ringbuffer (to avoid reallocations and poor locality of reference) to help
 /// prevent lost progress
-template <class T, size_t SIZE>
+///
+/// Reports sent with priority go through a lane of their own, with a ring of PRIORITY_SIZE which overflows into
+/// memory rather than dropping. The loop thread always empties the priority lane before handling the next ordinary
+/// report, so rare but urgent reports (errors, completion) neither wait behind a backlog nor get lost in one.
+template <class T, size_t SIZE, size_t PRIORITY_SIZE = 16>
 class AsyncQueuedProgressWorker : public Nan::AsyncWorker {
  public:
     class ExecutionProgressSender {
@@ -43,9 +52,27 @@ class AsyncQueuedProgressWorker : public Nan::AsyncWorker {
         ///
         /// @param[in] data - data to send, must be array (because it will be free'd via delete[])
         /// @param[in] count - size of array
+        /// @param[in] priority - send through the priority lane
         ///
         /// @returns true if successfully enqueued, false otherwise
-        bool Send(const T* data, size_t count) const { return worker_.SendProgress(data, count); }
+        bool Send(const T* data, size_t count, bool priority = false) const {
+            return worker_.SendProgress(data, count, priority);
+        }
+
+        /// Send, waiting for room if the queue is full rather than dropping (see ProgressQueue::push_blocking)
+        ///
+        /// @param[in] data - data to send, must be array (because it will be free'd via delete[])
+        /// @param[in] count - size of array
+        /// @param[in] timeout - the longest to wait; std::chrono::nanoseconds::max() to wait indefinitely
+        ///
+        /// @returns true if successfully enqueued, false if the queue was still full at the timeout or the worker was
+        ///          cancelled while waiting
+        bool SendBlocking(const T* data, size_t count, std::chrono::nanoseconds timeout) const {
+            return worker_.SendProgressBlocking(data, count, timeout);
+        }
+
+        /// @returns the worker bound to this instance
+        AsyncQueuedProgressWorker& Worker() const { return worker_; }
 
      private:
         friend void AsyncQueuedProgressWorker::Execute();
@@ -57,7 +84,18 @@ class AsyncQueuedProgressWorker : public Nan::AsyncWorker {
     /// @param[in] callback - the callback to invoke after Execute completes. (unless overridden, is called from
     ///                      HandleOKCallback with no arguments, and called from HandleErrorCallback with the errors
     ///                      reported (if any)
-    explicit AsyncQueuedProgressWorker(Nan::Callback* callback) : AsyncWorker(callback), buffer_() {
+    /// @param[in] stats - where to count what happens to the queue; may be shared between workers
+    explicit AsyncQueuedProgressWorker(Nan::Callback* callback,
+                                       std::shared_ptr<QueueStats> stats = std::make_shared<QueueStats>())
+        : AsyncWorker(callback),
+          queue_(stats),
+          priority_(stats),
+          enqueued_(0),
+          closing_(false),
+          credits_(),
+          replenish_(false),
+          cancelled_(false) {
+        priority_.setOverflow(std::unique_ptr<ProgressOverflow<T>>(new MemoryOverflow<T>()));
         async_ = std::unique_ptr<uv_async_t>(new uv_async_t());
         uv_async_init(uv_default_loop(), async_.get(), asyncNotifyProgressQueue);
         async_->data = this;
@@ -86,6 +124,12 @@ class AsyncQueuedProgressWorker : public Nan::AsyncWorker {
 
     /// close our async_t handle and free resources (via AsyncClose method)
     virtual void Destroy() override {
+        if (overflowing()) {
+            // replay what's left of the overflow a batch at a time, as it arrived, and close once it's done
+            closing_ = true;
+            uv_async_send(async_.get());
+            return;
+        }
         // NOTABUG: Nan uses reinterpret_cast to pass uv_async_t around
         uv_close(reinterpret_cast<uv_handle_t*>(async_.get()), AsyncClose);
     }
@@ -101,27 +145,163 @@ class AsyncQueuedProgressWorker : public Nan::AsyncWorker {
     /// @param[in] size - size of the array
     virtual void HandleProgressCallback(const T* data, size_t size) = 0;
 
+    /// Rather than dropping progress reports when the queue is full, append them to memory mapped files in directory
+    /// (see SpillFile), and replay them once the queue has caught up. Requires a SpillCodec for T. Must be called
+    /// before the worker is queued.
+    ///
+    /// @param[in] directory - where to create the spill files
+    /// @param[in] segment_size - size of each spill file, in bytes
+    ///
+    /// @throws std::system_error if a file can't be created in the directory
+    void SpillToDisk(const std::string& directory, size_t segment_size = 64 << 20) {
+        queue_.setOverflow(std::unique_ptr<ProgressOverflow<T>>(new SpillFile<T>(directory, segment_size)));
+    }
+
+    /// Regulate the ordinary lane with credits (see FlowCredits): senders take a credit per report, and park or are
+    /// throttled once they run out, rather than overrunning the queue. Must be called before the worker is queued.
+    ///
+    /// @param[in] credits - the credits; may be shared with other workers, and granted to from elsewhere (e.g. by
+    ///                      javascript as it is ready for more)
+    /// @param[in] replenish - grant a credit back for every report the loop thread handles, so that senders are
+    ///                        paced to the loop thread's real throughput
+    void FlowControl(std::shared_ptr<FlowCredits> credits, bool replenish = true) {
+        credits_ = std::move(credits);
+        replenish_ = replenish;
+    }
+
+    /// @returns the counters for this worker's queue
+    const QueueStats& Stats() const { return queue_.stats(); }
+
+    /// Ask the work to stop early: IsCancelled() is true from now on, and senders parked waiting for room or credits
+    /// are woken to notice. It is up to Execute to stop; once it has, the callback receives a "cancelled" error. Safe
+    /// to call from any thread, while the worker exists.
+    void Cancel() {
+        cancelled_.store(true, std::memory_order_relaxed);
+        WakeSenders();
+        if (credits_) {
+            credits_->wake();
+        }
+    }
+
+    /// @returns true once the work has been cancelled; cheap enough to poll between units of work
+    virtual bool IsCancelled() const { return cancelled_.load(std::memory_order_relaxed); }
+
+    /// @returns the uv_hrtime() at which the report being handled was sent; only meaningful from
+    ///          HandleProgressCallback
+    uint64_t ProgressEnqueuedAt() const { return enqueued_; }
+
     /// Execute implements the Nan::AsyncWorker interface. It should not be overridden, override
     /// virtual void Execute(const ExecutionProgressSender& progress) instead
     void Execute() final override {
         ExecutionProgressSender sender{*this};
         Execute(sender);
+        if (IsCancelled() && ErrorMessage() == nullptr) {
+            SetErrorMessage("cancelled");
+        }
+    }
+
+ protected:
+    /// Take a credit for an ordinary report, if the worker is flow controlled
+    ///
+    /// @param[in] timeout - the longest to park for a credit; std::chrono::nanoseconds::max() waits for as long as it
+    ///                      takes
+    ///
+    /// @returns false if the sender is throttled, or the worker was cancelled while it was parked, or there was still
+    ///          no credit at the timeout
+    bool AcquireCredit(std::chrono::nanoseconds timeout = std::chrono::nanoseconds::max()) {
+        return !credits_ || credits_->acquire([this]() { return IsCancelled(); }, timeout);
+    }
+
+    /// Take a credit for an ordinary report which mustn't wait, if the worker is flow controlled
+    void ConsumeCredit() {
+        if (credits_) {
+            credits_->consume();
+        }
+    }
+
+    /// Give back a credit taken for a report which wasn't sent after all
+    void RefundCredit() {
+        if (credits_) {
+            credits_->grant();
+        }
+    }
+
+    /// @returns true if an ordinary report sent now would be queued rather than dropped (certain only while there is
+    ///          a single sending thread)
+    bool Writable() const { return queue_.writable(); }
+
+    /// Park the sending thread, as a sender blocked on a full queue is parked, until ready returns true. It is
+    /// retried whenever the loop thread frees a slot, and on WakeSenders().
+    ///
+    /// @param[in] ready - returns true once the wait is over
+    /// @param[in] timeout - the longest to wait; std::chrono::nanoseconds::max() waits for as long as it takes
+    ///
+    /// @returns true if ready returned true, false if it was still false at the timeout
+    template <class Ready>
+    bool WaitForQueue(Ready ready, std::chrono::nanoseconds timeout) {
+        return queue_.wait(ready, timeout);
+    }
+
+    /// Wake senders parked in WaitForQueue (or blocked on a full queue) to check again; may be called from any thread
+    void WakeSenders() { queue_.wake(); }
+
+    /// Handle the reports queued so far, as the loop thread does once it is notified of them; must be called on the
+    /// loop thread
+    ///
+    /// @returns false if reports are left in the overflow, to be handled later
+    bool HandleQueuedProgress() {
+        HandleProgressQueue(SIZE);
+        return !overflowing();
     }
 
  private:
-    void HandleProgressQueue() {
-        std::pair<const T*, size_t> elem;
-        while (this->buffer_.pop(elem)) {
-            HandleProgressCallback(elem.first, elem.second);
-            if (elem.second > 0) {
-                delete[] elem.first;
+    /// @param[in] limit - the most reports to replay from the overflow before yielding to the rest of the loop
+    void HandleProgressQueue(size_t limit) {
+        typename ProgressQueue<T, SIZE>::Entry elem;
+        size_t drained = 0;
+        uint64_t wakeup = 0;
+        NODE_EVENT_PROBE1(drain__start, this);
+        for (;;) {
+            bool urgent = !priority_.empty() && priority_.pop(elem);
+            if (!urgent && !queue_.pop(elem)) {
+                break;
+            }
+            uint64_t now = uv_hrtime();
+            uint64_t wait = now > elem.enqueued ? now - elem.enqueued : 0;
+            if (drained++ == 0) {
+                wakeup = wait;
+            }
+            NODE_EVENT_PROBE2(dequeue, elem.size, wait);
+            enqueued_ = elem.enqueued;
+            HandleProgressCallback(elem.data, elem.size);
+            if (elem.size > 0) {
+                delete[] elem.data;
             }
+            if (!urgent && replenish_) {
+                credits_->grant();
+            }
+            if (drained >= limit && overflowing()) {
+                // the overflow can hold far more than should be handled in one go; carry on next time around
+                uv_async_send(async_.get());
+                break;
+            }
+        }
+        if (drained > 0) {
+            queue_.stats().drained(drained, wakeup);
         }
+        NODE_EVENT_PROBE2(drain__end, this, drained);
     }
 
-    bool SendProgress(const T* data, size_t size) {
+    bool SendProgress(const T* data, size_t size, bool priority) {
         // use non_blocking and just drop any excessive items
-        bool r = buffer_.push({data, size});
+        bool r = priority ? priority_.push(data, size, uv_hrtime()) : queue_.push(data, size, uv_hrtime());
+        uv_async_send(async_.get());
+        return r;
+    }
+
+    bool SendProgressBlocking(const T* data, size_t size, std::chrono::nanoseconds timeout) {
+        // a full queue has already signalled the loop thread, which wakes parked senders as it drains
+        bool r = queue_.push_blocking(data, size, uv_hrtime(), timeout, [this]() { return IsCancelled(); });
         uv_async_send(async_.get());
         return r;
     }
@@ -130,7 +310,11 @@ class AsyncQueuedProgressWorker : public Nan::AsyncWorker {
     // loop is running on, so it can safely touch v8 data structures
     static NAUV_WORK_CB(asyncNotifyProgressQueue) {
         auto worker = static_cast<AsyncQueuedProgressWorker*>(async->data);
-        worker->HandleProgressQueue();
+        worker->HandleProgressQueue(SIZE);
+        if (worker->closing_ && !worker->overflowing()) {
+            worker->closing_ = false;
+            uv_close(reinterpret_cast<uv_handle_t*>(async), AsyncClose);
+        }
     }
 
     // This is invoked after Destroy(), which executes on the thread that the default loop is running on, and so can
@@ -138,13 +322,22 @@ class AsyncQueuedProgressWorker : public Nan::AsyncWorker {
     static void AsyncClose(uv_handle_t* handle) {
         auto worker = static_cast<AsyncQueuedProgressWorker*>(handle->data);
         // Destroy happens in the v8 main loop; so we can flush out the Progress queue here before destroying
-        if (worker->buffer_.read_available()) {
-            worker->HandleProgressQueue();
+        if (worker->queue_.read_available() || worker->priority_.read_available()) {
+            worker->HandleProgressQueue(static_cast<size_t>(-1));
         }
         delete worker;
     }
 
-    RingBuffer<std::pair<const T*, size_t>, SIZE> buffer_;
+    /// @returns true if either lane has reports in its overflow still to be handled
+    bool overflowing() const { return queue_.overflowing() || priority_.overflowing(); }
+
+    ProgressQueue<T, SIZE> queue_;
+    ProgressQueue<T, PRIORITY_SIZE> priority_;
+    uint64_t enqueued_;
+    bool closing_;
+    std::shared_ptr<FlowCredits> credits_;
+    bool replenish_;
+    std::atomic<bool> cancelled_;
     std::unique_ptr<uv_async_t> async_;
 };
 
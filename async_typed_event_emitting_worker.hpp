@@ -0,0 +1,94 @@
+/*
+ * Copyright 2017 Scoop Technologies
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE
+ * WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+ * OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#pragma once
+#ifndef _NODE_EVENT_ASYNC_TYPED_EVENT_EMITTING_WORKER_H
+#define _NODE_EVENT_ASYNC_TYPED_EVENT_EMITTING_WORKER_H
+
+#include <chrono>
+#include <memory>
+#include <string>
+#include <type_traits>
+
+#include "async_event_emitting_worker.hpp"
+#include "event_schema.hpp"
+#include "typed_event_emitter.hpp"
+
+namespace NodeEvent {
+/// AsyncTypedEventEmittingWorker emits the events of a schema by tag, through a TypedEventEmitter for the same schema:
+///
+///     void ExecuteTyped(const ExecutionProgressSender& sender) override {
+///         for (int i = 0; i < 100; ++i) {
+///             this->template emitEvent<Progress>(sender, i / 100.0);
+///         }
+///         this->template emitEvent<Done>(sender);
+///     }
+///
+/// An event outside the schema, or a value of the wrong type, doesn't compile. The listeners of an event are found by
+/// its pinned number, both inline and on the loop thread, so its name isn't hashed; aggregate(), rateLimit(), sample()
+/// and prioritize() apply to the schema's events by name as for any other worker.
+template <class Schema, size_t SIZE, size_t PRIORITY_SIZE = 16>
+class AsyncTypedEventEmittingWorker : public AsyncEventEmittingWorker<SIZE, PRIORITY_SIZE> {
+ public:
+    typedef typename AsyncEventEmittingWorker<SIZE, PRIORITY_SIZE>::ExecutionProgressSender ExecutionProgressSender;
+
+    /// @param[in] callback - the callback to invoke after Execute completes. (unless overridden, is called from
+    ///                      HandleOKCallback with no arguments, and called from HandleErrorCallback with the errors
+    ///                      reported (if any)
+    /// @param[in] emitter - The emitter object to use for notifying JS callbacks for given events.
+    AsyncTypedEventEmittingWorker(Nan::Callback* callback, std::shared_ptr<TypedEventEmitter<Schema>> emitter)
+        : AsyncEventEmittingWorker<SIZE, PRIORITY_SIZE>(callback, emitter) {}
+
+    /// The work you need to happen in a worker thread
+    ///
+    /// @param[in] sender - An object you must pass as the first argument of emitEvent
+    virtual void ExecuteTyped(const ExecutionProgressSender& sender) = 0;
+
+ protected:
+    using AsyncEventEmittingWorker<SIZE, PRIORITY_SIZE>::emitEvent;
+
+    /// Deliver the event E from the worker thread (see AsyncEventEmittingWorker::emitEvent)
+    ///
+    /// @param[in] sender - sender for this worker
+    /// @param[in] value - event value
+    /// @param[in] wait - how long to wait for room if the queue is full, rather than dropping the event
+    ///
+    /// @returns as AsyncEventEmittingWorker::emitEvent
+    template <class E>
+    int emitEvent(const ExecutionProgressSender& sender, const typename E::value_type& value,
+                  std::chrono::nanoseconds wait = std::chrono::nanoseconds::zero()) {
+        std::string encoded = EventValue<typename E::value_type>::encode(value);
+        return emitEvent(sender, E::name(), Schema::template index<E>(), encoded.c_str(), wait);
+    }
+
+    /// Deliver the event E, which has no value, from the worker thread
+    template <class E>
+    int emitEvent(const ExecutionProgressSender& sender,
+                  std::chrono::nanoseconds wait = std::chrono::nanoseconds::zero()) {
+        static_assert(std::is_void<typename E::value_type>::value, "the event has a value");
+        return emitEvent(sender, E::name(), Schema::template index<E>(), "", wait);
+    }
+
+ private:
+    virtual void Execute(const ExecutionProgressSender& sender) override {
+        ExecuteTyped(sender);
+        this->flushAggregates(sender);
+    }
+};
+
+}  // namespace NodeEvent
+
+#endif
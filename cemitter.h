@@ -18,11 +18,48 @@
 #ifndef _GLPK_EVENTEMITTER_CEMITER_H
 #define _GLPK_EVENTEMITTER_CEMITER_H
 
+#include <stddef.h>
+
 #ifdef __cplusplus
 extern "C" {
 #endif
+/* What the emit functions return */
+#define EVENTEMITTER_OK 1         /* the event was delivered or queued */
+#define EVENTEMITTER_DROPPED 0    /* the queue was full, and the event was lost */
+#define EVENTEMITTER_THROTTLED -1 /* out of flow control credits: nothing happened, emit it again later */
+#define EVENTEMITTER_CANCELLED -2 /* the work was cancelled: nothing happened, stop emitting and return */
+#define EVENTEMITTER_TOO_LARGE -3 /* the event can never be queued (errno EMSGSIZE): don't emit it again */
+
+/*
+ * The emitter given to ExecuteWithEmitter returns EVENTEMITTER_DROPPED for a throttled event, so that
+ * `while (!emitter(ev, value))` retries it until it is delivered, and EVENTEMITTER_CANCELLED (non-zero) once the work
+ * has been cancelled, so that such a loop ends. The workers' emit_status and reentrant_emit_status take the same
+ * arguments, and return the codes above.
+ */
 typedef int (*eventemitter_fn)(const char*, const char*);
 typedef int (*eventemitter_fn_r)(const void* sender, const char*, const char*);
+/*
+ * Batches: count events in one call, queued together in a single report (one queue slot, one wakeup of the loop
+ * thread), so the per-event cost is little more than a copy. The return code is for the batch as a whole.
+ */
+typedef int (*eventemitter_batch_fn)(const char* const* evs, const char* const* values, size_t count);
+typedef int (*eventemitter_batch_fn_r)(const void* sender, const char* const* evs, const char* const* values,
+                                       size_t count);
+/* ... of count values of the same event */
+typedef int (*eventemitter_values_fn)(const char* ev, const char* const* values, size_t count);
+typedef int (*eventemitter_values_fn_r)(const void* sender, const char* ev, const char* const* values, size_t count);
+/*
+ * Lossless emit: if the queue is full, wait for room (spinning briefly, then parked) rather than dropping the event.
+ * Returns EVENTEMITTER_DROPPED if there was still no room after timeout_ms; a negative timeout waits indefinitely.
+ * The timeout bounds the wait for a flow control credit too: EVENTEMITTER_THROTTLED if none was granted in time.
+ */
+typedef int (*eventemitter_blocking_fn)(const char* ev, const char* value, long timeout_ms);
+typedef int (*eventemitter_blocking_fn_r)(const void* sender, const char* ev, const char* value, long timeout_ms);
+/* Polls for cancellation: non-zero once the work has been cancelled (emit functions then return CANCELLED) */
+typedef int (*eventemitter_cancelled_fn)(void);
+typedef int (*eventemitter_cancelled_fn_r)(const void* sender);
+/* A native listener: receives the user data given at registration, the event name, and the value */
+typedef void (*eventlistener_fn)(void* data, const char* ev, const char* value);
 #ifdef __cplusplus
 };
 #endif
@@ -0,0 +1,220 @@
+/*
+ * Copyright 2017 Scoop Technologies
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE
+ * WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+ * OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#pragma once
+#ifndef _NODE_EVENT_CEMITTER_SHM_H
+#define _NODE_EVENT_CEMITTER_SHM_H
+
+/*
+ * Producer side of the shared memory event transport: lets a C library running in another process emit events to the
+ * listeners of an EventEmitter in the node process (see SharedMemoryEventSource, which creates the ring and drains it
+ * on the loop thread).
+ *
+ *     cemitter_shm* shm = cemitter_shm_open("/my-ring", notify_fd);
+ *     cemitter_shm_emit(shm, "progress", "42");
+ *     cemitter_shm_close(shm);
+ *
+ * cemitter_shm_emit has the eventemitter_fn_r signature, so code written against the reentrant workers can emit
+ * through the ring unchanged. It may be called from any number of threads (and processes) at once.
+ *
+ * The ring is a bounded multi-producer/single-consumer queue of fixed size slots in POSIX shared memory. A producer
+ * claims a slot by advancing the enqueue position, copies the event into it and then publishes it by advancing the
+ * slot's sequence number; the consumer takes slots in order once they are published. A producer which dies between
+ * claiming and publishing a slot stalls the ring behind that slot.
+ *
+ * Depends only on cemitter.h, POSIX and the GCC/clang __atomic builtins; link with -lrt on glibc older than 2.34.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "cemitter.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define CEMITTER_SHM_MAGIC 0x314d48534d56454eULL /* "NEVMSHM1" */
+#define CEMITTER_SHM_CACHELINE 64
+
+/* Start of the shared memory; the slots follow it. Written by the consumer before the magic is published. */
+struct cemitter_shm_header {
+    uint64_t magic;
+    uint32_t capacity;  /* number of slots, a power of two */
+    uint32_t slot_size; /* bytes per slot, including struct cemitter_shm_slot */
+    uint32_t sleeping;  /* non-zero when the consumer is waiting to be notified */
+    uint64_t dropped;   /* events rejected because the ring was full */
+    /* the positions are kept on their own cache lines, as they are written by different sides */
+    uint64_t enqueue_pos __attribute__((aligned(CEMITTER_SHM_CACHELINE)));
+    uint64_t dequeue_pos __attribute__((aligned(CEMITTER_SHM_CACHELINE)));
+} __attribute__((aligned(CEMITTER_SHM_CACHELINE)));
+
+/* A slot: the event name and the value follow, each NUL terminated */
+struct cemitter_shm_slot {
+    uint64_t seq;       /* == position when free for that position, position + 1 once published */
+    uint64_t timestamp; /* CLOCK_MONOTONIC nanoseconds (as uv_hrtime()) when the event was emitted */
+    uint32_t ev_len;
+    uint32_t value_len;
+};
+
+typedef struct {
+    struct cemitter_shm_header* header;
+    size_t size;
+    int notify_fd;
+} cemitter_shm;
+
+static inline struct cemitter_shm_slot* cemitter_shm_slot_at(struct cemitter_shm_header* header, uint64_t pos) {
+    return (struct cemitter_shm_slot*)((char*)(header + 1) + (pos & (header->capacity - 1)) * header->slot_size);
+}
+
+/* Bytes of shared memory for a ring of the given geometry */
+static inline size_t cemitter_shm_size(uint32_t capacity, uint32_t slot_size) {
+    return sizeof(struct cemitter_shm_header) + (size_t)capacity * slot_size;
+}
+
+/*
+ * Queue an event, and wake the consumer if it is waiting.
+ *
+ * Returns EVENTEMITTER_OK (1) if the event was queued, EVENTEMITTER_DROPPED (0) if the ring is full (try again later),
+ * or EVENTEMITTER_TOO_LARGE (errno EMSGSIZE) if the event can never fit in a slot, and mustn't be retried.
+ */
+static inline int cemitter_shm_push(const cemitter_shm* shm, const char* ev, const char* value) {
+    struct cemitter_shm_header* header = shm->header;
+    size_t ev_len = strlen(ev);
+    size_t value_len = strlen(value);
+    if (sizeof(struct cemitter_shm_slot) + ev_len + value_len + 2 > header->slot_size) {
+        errno = EMSGSIZE;
+        return EVENTEMITTER_TOO_LARGE;
+    }
+
+    uint64_t pos = __atomic_load_n(&header->enqueue_pos, __ATOMIC_RELAXED);
+    struct cemitter_shm_slot* slot;
+    for (;;) {
+        slot = cemitter_shm_slot_at(header, pos);
+        int64_t diff = (int64_t)(__atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE) - pos);
+        if (diff == 0) {
+            if (__atomic_compare_exchange_n(&header->enqueue_pos, &pos, pos + 1, 1, __ATOMIC_RELAXED,
+                                            __ATOMIC_RELAXED)) {
+                break;
+            }
+        } else if (diff < 0) {
+            __atomic_fetch_add(&header->dropped, 1, __ATOMIC_RELAXED);
+            return EVENTEMITTER_DROPPED;
+        } else {
+            pos = __atomic_load_n(&header->enqueue_pos, __ATOMIC_RELAXED);
+        }
+    }
+
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    slot->timestamp = (uint64_t)now.tv_sec * 1000000000ULL + (uint64_t)now.tv_nsec;
+    slot->ev_len = (uint32_t)ev_len;
+    slot->value_len = (uint32_t)value_len;
+    char* data = (char*)(slot + 1);
+    memcpy(data, ev, ev_len + 1);
+    memcpy(data + ev_len + 1, value, value_len + 1);
+    __atomic_store_n(&slot->seq, pos + 1, __ATOMIC_RELEASE);
+
+    /* pairs with the fence in the consumer between setting sleeping and checking for published slots */
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&header->sleeping, __ATOMIC_RELAXED) &&
+        __atomic_exchange_n(&header->sleeping, 0, __ATOMIC_ACQ_REL) && shm->notify_fd >= 0) {
+        uint64_t one = 1;
+        ssize_t ignored = write(shm->notify_fd, &one, sizeof(one));
+        (void)ignored;
+    }
+    return EVENTEMITTER_OK;
+}
+
+/* eventemitter_fn_r compatible: shm is the cemitter_shm* */
+static inline int cemitter_shm_emit(const void* shm, const char* ev, const char* value) {
+    return cemitter_shm_push((const cemitter_shm*)shm, ev, value);
+}
+
+/*
+ * Attach to a ring created by the node process.
+ *
+ * name - the shared memory object name of the ring (as given to SharedMemoryEventSource)
+ * notify_fd - the ring's eventfd, inherited from the node process (e.g. passed in the stdio of a spawned child), or -1
+ *             if the consumer doesn't need waking
+ *
+ * Returns NULL, with errno set, if the ring can't be opened (EINVAL if it isn't a ring).
+ */
+static inline cemitter_shm* cemitter_shm_open(const char* name, int notify_fd) {
+    int fd = shm_open(name, O_RDWR, 0);
+    if (fd < 0) {
+        return NULL;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        int err = errno;
+        close(fd);
+        errno = err;
+        return NULL;
+    }
+    if ((size_t)st.st_size < sizeof(struct cemitter_shm_header)) {
+        close(fd);
+        errno = EINVAL;
+        return NULL;
+    }
+    void* addr = mmap(NULL, (size_t)st.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    int err = errno;
+    close(fd);
+    if (addr == MAP_FAILED) {
+        errno = err;
+        return NULL;
+    }
+
+    struct cemitter_shm_header* header = (struct cemitter_shm_header*)addr;
+    if (__atomic_load_n(&header->magic, __ATOMIC_ACQUIRE) != CEMITTER_SHM_MAGIC ||
+        cemitter_shm_size(header->capacity, header->slot_size) != (size_t)st.st_size) {
+        munmap(addr, (size_t)st.st_size);
+        errno = EINVAL;
+        return NULL;
+    }
+
+    cemitter_shm* shm = (cemitter_shm*)malloc(sizeof(cemitter_shm));
+    if (!shm) {
+        munmap(addr, (size_t)st.st_size);
+        errno = ENOMEM;
+        return NULL;
+    }
+    shm->header = header;
+    shm->size = (size_t)st.st_size;
+    shm->notify_fd = notify_fd;
+    return shm;
+}
+
+/* Detach from the ring. Does not close notify_fd. */
+static inline void cemitter_shm_close(cemitter_shm* shm) {
+    if (shm) {
+        munmap(shm->header, shm->size);
+        free(shm);
+    }
+}
+
+#ifdef __cplusplus
+};
+#endif
+
+#endif
@@ -0,0 +1,358 @@
+/*
+ * Copyright 2017 Scoop Technologies
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE
+ * WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+ * OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#pragma once
+#ifndef _NODE_EVENT_EMIT_TASK_H
+#define _NODE_EVENT_EMIT_TASK_H
+
+// Coroutines need C++20; with an older standard this header is empty, so it can be included unconditionally
+#if defined(__cpp_impl_coroutine) && __cpp_impl_coroutine >= 201902L
+
+#include <atomic>
+#include <chrono>
+#include <coroutine>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "cemitter.h"
+
+namespace NodeEvent {
+/// An event for an EmitTask to co_yield
+struct Event {
+    Event(std::string name, std::string value) : name(std::move(name)), value(std::move(value)) {}
+    Event() : name(), value() {}
+
+    std::string name;
+    std::string value;
+};
+
+class EmitTaskScheduler;
+
+/// EmitTask is the coroutine type of the tasks run by AsyncEventEmittingCoroutineWorker (or any EmitTaskRunner): a
+/// coroutine returning it emits events with co_yield, and waits for anything else (I/O completions, timers) with
+/// co_await suspend(...).
+///
+///     EmitTask poll(Sensor& sensor) {
+///         std::string reading;
+///         while (sensor.open()) {
+///             co_await suspend([&](Resumer resume) { sensor.read(reading, resume); });
+///             co_yield Event{"reading", reading};
+///         }
+///     }
+///
+/// A task starts suspended and runs once its runner does. It owns its coroutine frame until then.
+class EmitTask {
+ public:
+    struct promise_type {
+        EmitTask get_return_object() { return EmitTask{std::coroutine_handle<promise_type>::from_promise(*this)}; }
+        std::suspend_always initial_suspend() noexcept { return {}; }
+        std::suspend_always final_suspend() noexcept { return {}; }
+        void return_void() {}
+        void unhandled_exception() { exception = std::current_exception(); }
+
+        // the task suspends on every co_yield, and its runner resumes it once the event is emitted
+        std::suspend_always yield_value(const Event& ev) {
+            event = ev;
+            yielded = true;
+            return {};
+        }
+
+        EmitTaskScheduler* scheduler = nullptr;
+        Event event;
+        bool yielded = false;
+        std::exception_ptr exception;
+    };
+
+    typedef std::coroutine_handle<promise_type> Handle;
+
+    EmitTask(EmitTask&& other) noexcept : handle_(std::exchange(other.handle_, nullptr)) {}
+    EmitTask& operator=(EmitTask&& other) noexcept {
+        std::swap(handle_, other.handle_);
+        return *this;
+    }
+    EmitTask(const EmitTask& other) = delete;
+    EmitTask& operator=(const EmitTask& other) = delete;
+
+    ~EmitTask() {
+        if (handle_) {
+            handle_.destroy();
+        }
+    }
+
+    /// Give up ownership of the coroutine frame
+    ///
+    /// @returns the coroutine
+    Handle release() { return std::exchange(handle_, nullptr); }
+
+ private:
+    explicit EmitTask(Handle handle) : handle_(handle) {}
+
+    Handle handle_;
+};
+
+/// What a suspended EmitTask is resumed through
+class EmitTaskScheduler {
+ public:
+    virtual ~EmitTaskScheduler() {}
+
+    /// Make a task suspended by suspend() runnable again; may be called from any thread
+    ///
+    /// @param[in] task - the task
+    virtual void resume(EmitTask::Handle task) = 0;
+};
+
+/// Resumes a task suspended by suspend(). Must be called exactly once, from any thread.
+class Resumer {
+ public:
+    explicit Resumer(EmitTask::Handle task) : task_(task) {}
+
+    void operator()() const { task_.promise().scheduler->resume(task_); }
+
+ private:
+    EmitTask::Handle task_;
+};
+
+/// Awaitable returned by suspend()
+template <class Start>
+class Suspension {
+ public:
+    explicit Suspension(Start start) : start_(std::move(start)) {}
+
+    bool await_ready() const noexcept { return false; }
+    void await_suspend(EmitTask::Handle task) { start_(Resumer{task}); }
+    void await_resume() const noexcept {}
+
+ private:
+    Start start_;
+};
+
+/// Suspend an EmitTask until whatever start begins calls the Resumer it is given; its runner runs the other tasks in
+/// the meantime. This adapts any callback based API:
+///
+///     co_await suspend([&](Resumer resume) { uv_fs_read(loop, &req, file, &buf, 1, -1, [resume] { resume(); }); });
+///
+/// @param[in] start - called with the task's Resumer, once the task is suspended
+///
+/// @returns what to co_await
+template <class Start>
+Suspension<Start> suspend(Start start) {
+    return Suspension<Start>{std::move(start)};
+}
+
+/// EmitTaskRunner runs EmitTasks on one thread, switching between them as they emit and wait: the scheduling of
+/// AsyncEventEmittingCoroutineWorker, which depends on neither uv nor v8, so it can be tested on its own. Events go to
+/// a Host, which run() is given:
+///
+///     bool prioritized(const char* ev);             // whether ev skips the queue, and so never waits for room
+///     bool writable();                              // whether an ordinary event emitted now would be queued
+///     int emit(const char* ev, const char* value);  // an EVENTEMITTER_ result, as from emit_status
+///     bool cancelled();
+///     template <class Ready>                        // park until ready returns true or the timeout; ready is retried
+///     bool wait(Ready ready, std::chrono::nanoseconds timeout);  // as room is made, and when wake is called
+///
+/// A task whose event doesn't fit (or is throttled) waits, while the other tasks run on; run() only waits once every
+/// task is waiting.
+class EmitTaskRunner : private EmitTaskScheduler {
+ public:
+    /// how many events a task may emit in a row before the other tasks get their turn
+    static constexpr unsigned batch = 64;
+
+    /// how often throttled tasks retry, as credits are granted without waking the runner
+    static constexpr std::chrono::milliseconds throttle_poll{1};
+
+    /// @param[in] wake - wakes run() from its Host's wait; called from the thread resuming a task
+    explicit EmitTaskRunner(std::function<void()> wake)
+        : wake_(std::move(wake)), ready_(), blocked_(), suspended_(0), exception_(), lock_(), resumed_(), pending_(0) {}
+
+    EmitTaskRunner(const EmitTaskRunner& other) = delete;
+    EmitTaskRunner& operator=(const EmitTaskRunner& other) = delete;
+
+    virtual ~EmitTaskRunner() {
+        // only tasks which never ran are left
+        for (auto task : ready_) {
+            task.destroy();
+        }
+    }
+
+    /// Add a task. Must be called before run().
+    ///
+    /// @param[in] task - the task
+    void spawn(EmitTask task) {
+        auto handle = task.release();
+        handle.promise().scheduler = this;
+        ready_.push_back(handle);
+    }
+
+    /// Run every task until it completes. Once the Host is cancelled, tasks are destroyed rather than resumed, which
+    /// runs the destructors of their locals; a task waiting on a Resumer is destroyed once it is resumed.
+    ///
+    /// @param[in] host - where events go
+    template <class Host>
+    void run(Host& host) {
+        while (!ready_.empty() || !blocked_.empty() || suspended_ > 0) {
+            takeResumed();
+            if (host.cancelled()) {
+                abandon(host);
+                continue;
+            }
+            bool throttled = unblock(host);
+            if (ready_.empty()) {
+                // parked until room is made, a task is resumed, or the work is cancelled. Room doesn't help a
+                // throttled task, so it only retries at the timeout.
+                auto timeout = throttled ? std::chrono::nanoseconds(throttle_poll) : std::chrono::nanoseconds::max();
+                host.wait(
+                    [this, &host, throttled]() {
+                        return pending_.load() > 0 || (!throttled && !blocked_.empty() && host.writable()) ||
+                               host.cancelled();
+                    },
+                    timeout);
+                continue;
+            }
+            auto task = ready_.front();
+            ready_.pop_front();
+            step(host, task);
+        }
+    }
+
+    /// @returns the exception of the first task to throw, if any
+    std::exception_ptr exception() const { return exception_; }
+
+ private:
+    virtual void resume(EmitTask::Handle task) override {
+        // wake the runner before letting go of the lock: it can't see the task, and so can't complete and be
+        // deleted, until then
+        std::lock_guard<std::mutex> guard{lock_};
+        resumed_.push_back(task);
+        pending_.fetch_add(1);
+        wake_();
+    }
+
+    /// Resume a task until it waits, completes, or has had its turn
+    template <class Host>
+    void step(Host& host, EmitTask::Handle task) {
+        for (unsigned i = 0; i < batch; ++i) {
+            task.resume();
+            auto& promise = task.promise();
+            if (task.done()) {
+                complete(task);
+                return;
+            }
+            if (!promise.yielded) {
+                // suspended; it is resumed through resume()
+                ++suspended_;
+                return;
+            }
+            if (!emit(host, task)) {
+                blocked_.push_back(task);
+                return;
+            }
+        }
+        ready_.push_back(task);
+    }
+
+    /// Emit a task's yielded event, unless there is no room for it
+    ///
+    /// @returns true if the event was emitted, false if the task has to wait
+    template <class Host>
+    bool emit(Host& host, EmitTask::Handle task) {
+        auto& promise = task.promise();
+        const char* ev = promise.event.name.c_str();
+        // this is the only thread sending ordinary events, so there is still room when the event is sent
+        if (!host.prioritized(ev) && !host.writable()) {
+            return false;
+        }
+        if (host.emit(ev, promise.event.value.c_str()) != EVENTEMITTER_OK) {
+            return false;
+        }
+        promise.yielded = false;
+        return true;
+    }
+
+    /// Emit the events of blocked tasks, in the order they blocked, while there is room
+    ///
+    /// @returns true if a task is still blocked because it was throttled, rather than by a full queue
+    template <class Host>
+    bool unblock(Host& host) {
+        while (!blocked_.empty()) {
+            if (!emit(host, blocked_.front())) {
+                return host.writable();
+            }
+            ready_.push_back(blocked_.front());
+            blocked_.pop_front();
+        }
+        return false;
+    }
+
+    /// Destroy every task which can be, once the work is cancelled; tasks waiting to be resumed are destroyed as they
+    /// are
+    template <class Host>
+    void abandon(Host& host) {
+        for (auto task : ready_) {
+            task.destroy();
+        }
+        ready_.clear();
+        for (auto task : blocked_) {
+            task.destroy();
+        }
+        blocked_.clear();
+        if (suspended_ > 0) {
+            host.wait([this]() { return pending_.load() > 0; }, std::chrono::nanoseconds::max());
+        }
+    }
+
+    void takeResumed() {
+        if (pending_.load() == 0) {
+            return;
+        }
+        std::lock_guard<std::mutex> guard{lock_};
+        ready_.insert(ready_.end(), resumed_.begin(), resumed_.end());
+        suspended_ -= resumed_.size();
+        pending_.fetch_sub(resumed_.size());
+        resumed_.clear();
+    }
+
+    void complete(EmitTask::Handle task) {
+        auto exception = task.promise().exception;
+        task.destroy();
+        if (exception && !exception_) {
+            exception_ = exception;
+        }
+    }
+
+    std::function<void()> wake_;
+
+    // only touched by the running thread
+    std::deque<EmitTask::Handle> ready_;
+    std::deque<EmitTask::Handle> blocked_;
+    size_t suspended_;
+    std::exception_ptr exception_;
+
+    // tasks resumed from other threads, waiting to be picked up by the running thread
+    std::mutex lock_;
+    std::vector<EmitTask::Handle> resumed_;
+    std::atomic<size_t> pending_;
+};
+
+}  // namespace NodeEvent
+
+#endif  // __cpp_impl_coroutine
+
+#endif
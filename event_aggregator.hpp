@@ -0,0 +1,196 @@
+/*
+ * Copyright 2017 Scoop Technologies
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE
+ * WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+ * OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#pragma once
+#ifndef _NODE_EVENT_EVENT_AGGREGATOR_H
+#define _NODE_EVENT_EVENT_AGGREGATOR_H
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "flat_string_map.hpp"
+
+namespace NodeEvent {
+/// EventAggregator folds numeric event values into one summary per event name per time window, so that counters and
+/// gauges cost one report per window rather than one per emit. A summary is a JSON object of the form
+/// {"count":3,"sum":6,"min":1,"max":3,"last":2}.
+///
+/// Windows are closed lazily: the summary for a window is produced by the first fold after the window has elapsed,
+/// by expire() (which closes a window whose event has gone quiet, and is meant to be called periodically), or by
+/// flush(). Configure the aggregated events with aggregate() before folding; fold, expire and flush are thread-safe.
+/// Windows are found by the event name and its StringHash, so folding only allocates to produce a summary.
+class EventAggregator {
+ public:
+    typedef std::chrono::steady_clock clock;
+    /// A summary, consisting of the event name and the JSON summary
+    typedef std::pair<std::string, std::string> Summary;
+
+    EventAggregator() : windows_() {}
+
+    /// Aggregate an event over windows of the given length
+    ///
+    /// @param[in] ev - event name
+    /// @param[in] window - length of each window
+    void aggregate(const std::string& ev, std::chrono::milliseconds window) {
+        auto w = std::make_shared<Window>(window);
+        auto added = windows_.emplace(ev, w);
+        if (!added.second) {
+            *added.first = w;
+        }
+    }
+
+    /// @returns true if no events are aggregated
+    bool empty() const { return windows_.empty(); }
+
+    /// @returns the length of the shortest window, or zero if no events are aggregated
+    std::chrono::milliseconds shortest() const {
+        std::chrono::milliseconds s = std::chrono::milliseconds::zero();
+        for (auto& it : windows_) {
+            auto length = std::chrono::duration_cast<std::chrono::milliseconds>(it.second->length);
+            if (s == std::chrono::milliseconds::zero() || length < s) {
+                s = length;
+            }
+        }
+        return s;
+    }
+
+    /// Fold a value into the current window for its event
+    ///
+    /// @param[in] ev - event name
+    /// @param[in] value - event value, which must be a number to be aggregated
+    /// @param[out] summaries - the summary of the previous window is appended, if it has elapsed
+    ///
+    /// @returns true if the value was aggregated, false if the event isn't aggregated or the value isn't a finite
+    ///          number
+    bool fold(const char* ev, const char* value, std::vector<Summary>& summaries) {
+        return fold(ev, StringHash::of(ev), value, summaries);
+    }
+
+    /// fold for an event whose name has already been hashed
+    ///
+    /// @param[in] ev - event name
+    /// @param[in] hash - StringHash::of(ev)
+    /// @param[in] value - event value
+    /// @param[out] summaries - as fold(ev, value, summaries)
+    ///
+    /// @returns as fold(ev, value, summaries)
+    bool fold(const char* ev, uint64_t hash, const char* value, std::vector<Summary>& summaries) {
+        auto window = windows_.find(ev, hash);
+        if (!window) {
+            return false;
+        }
+
+        char* end = nullptr;
+        errno = 0;
+        double v = std::strtod(value, &end);
+        if (end == value || *end != '\0' || errno == ERANGE || !std::isfinite(v)) {
+            return false;
+        }
+
+        auto now = clock::now();
+        Window& w = **window;
+        std::lock_guard<std::mutex> guard{w.lock};
+        if (w.count > 0 && now - w.start >= w.length) {
+            summaries.emplace_back(ev, w.summarize());
+        }
+        if (w.count == 0) {
+            w.start = now;
+        }
+        w.fold(v);
+        return true;
+    }
+
+    /// Close every window which has values in it and has elapsed, whether or not another value has arrived for it
+    ///
+    /// @param[out] summaries - the summaries are appended
+    void expire(std::vector<Summary>& summaries) {
+        auto now = clock::now();
+        for (auto& it : windows_) {
+            Window& w = *it.second;
+            std::lock_guard<std::mutex> guard{w.lock};
+            if (w.count > 0 && now - w.start >= w.length) {
+                summaries.emplace_back(it.first, w.summarize());
+            }
+        }
+    }
+
+    /// Close every window which has values in it
+    ///
+    /// @param[out] summaries - the summaries are appended
+    void flush(std::vector<Summary>& summaries) {
+        for (auto& it : windows_) {
+            Window& w = *it.second;
+            std::lock_guard<std::mutex> guard{w.lock};
+            if (w.count > 0) {
+                summaries.emplace_back(it.first, w.summarize());
+            }
+        }
+    }
+
+ private:
+    struct Window {
+        explicit Window(std::chrono::milliseconds l)
+            : lock(), length(l), start(), count(0), sum(0), min(0), max(0), last(0) {}
+
+        void fold(double v) {
+            if (count == 0) {
+                min = max = v;
+            } else {
+                min = std::min(min, v);
+                max = std::max(max, v);
+            }
+            ++count;
+            sum += v;
+            last = v;
+        }
+
+        /// @returns the JSON summary, and resets the window
+        std::string summarize() {
+            std::ostringstream ss;
+            ss.precision(std::numeric_limits<double>::digits10);
+            ss << "{\"count\":" << count << ",\"sum\":" << sum << ",\"min\":" << min << ",\"max\":" << max
+               << ",\"last\":" << last << "}";
+            count = 0;
+            sum = 0;
+            return ss.str();
+        }
+
+        std::mutex lock;
+        clock::duration length;
+        clock::time_point start;
+        uint64_t count;
+        double sum;
+        double min;
+        double max;
+        double last;
+    };
+
+    FlatStringMap<std::shared_ptr<Window>> windows_;
+};
+
+}  // namespace NodeEvent
+
+#endif
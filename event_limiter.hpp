@@ -0,0 +1,184 @@
+/*
+ * Copyright 2017 Scoop Technologies
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE
+ * WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+ * OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#pragma once
+#ifndef _NODE_EVENT_EVENT_LIMITER_H
+#define _NODE_EVENT_EVENT_LIMITER_H
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace NodeEvent {
+/// EventLimiter decides, per event name, whether an emitted event goes any further: an event may be rate limited by a
+/// token bucket (a steady rate, with bursts of up to a number of events), sampled 1-in-N, or both. Events which are
+/// suppressed are only counted, so verbose instrumentation can stay compiled in at the cost of a name lookup and an
+/// atomic operation or two per event.
+///
+/// Configure the events with rateLimit() and sample() before admitting; admit is thread-safe and doesn't allocate.
+/// Event names are compared one by one, which is fast for the handful of events it makes sense to limit.
+class EventLimiter {
+ public:
+    typedef std::chrono::steady_clock clock;
+
+    /// What has been suppressed for an event
+    struct Suppressed {
+        std::string event;
+        uint64_t admitted;
+        uint64_t rate_limited;
+        uint64_t sampled_out;
+    };
+
+    EventLimiter() : rules_() {}
+
+    /// Admit at most per_second events on average, in bursts of up to burst events
+    ///
+    /// @param[in] ev - event name
+    /// @param[in] per_second - the sustained rate; must be positive
+    /// @param[in] burst - the most events admitted back to back (at least 1)
+    ///
+    /// @throws std::invalid_argument if the rate isn't positive, or the rate and burst are too far out of range to
+    ///         time in nanoseconds
+    void rateLimit(const std::string& ev, double per_second, double burst = 1) {
+        if (!(per_second > 0)) {
+            throw std::invalid_argument("the rate limit of " + ev + " must be positive");
+        }
+        double interval = 1e9 / per_second;
+        double tolerance = std::max(burst - 1, 0.0) * interval;
+        if (!(interval + tolerance < max_ns)) {
+            throw std::invalid_argument("the rate limit of " + ev + " is out of range");
+        }
+        auto& rule = ruleFor(ev);
+        rule.interval = std::max<uint64_t>(static_cast<uint64_t>(interval), 1);
+        rule.tolerance = static_cast<uint64_t>(tolerance);
+    }
+
+    /// Admit only every nth event
+    ///
+    /// @param[in] ev - event name
+    /// @param[in] n - sampling period; 1 admits every event
+    void sample(const std::string& ev, uint32_t n) { ruleFor(ev).period = std::max<uint32_t>(n, 1); }
+
+    /// @returns true if no events are limited
+    bool empty() const { return rules_.empty(); }
+
+    /// Decide whether an event goes any further. Sampling applies first, so rate limits apply to the sampled events.
+    ///
+    /// @param[in] ev - event name
+    ///
+    /// @returns false if the event is suppressed
+    bool admit(const char* ev) {
+        // the clock is only read for an event which is rate limited, and not sampled out
+        Rule* rule = find(ev);
+        return !rule || rule->admit(&EventLimiter::now);
+    }
+
+    /// @see admit(const char*), at a given time (nanoseconds on clock)
+    bool admit(const char* ev, uint64_t now) {
+        Rule* rule = find(ev);
+        return !rule || rule->admit([now]() { return now; });
+    }
+
+    /// @returns the counts for every limited event
+    std::vector<Suppressed> suppressed() const {
+        std::vector<Suppressed> counts;
+        for (auto& rule : rules_) {
+            counts.push_back({rule->event, rule->admitted.load(std::memory_order_relaxed),
+                              rule->rate_limited.load(std::memory_order_relaxed),
+                              rule->sampled_out.load(std::memory_order_relaxed)});
+        }
+        return counts;
+    }
+
+ private:
+    /// A rule is a generic cell rate algorithm token bucket: rather than counting tokens, it keeps the time at which
+    /// the bucket would next be full (tat), which can be advanced with a single compare and swap.
+    struct Rule {
+        explicit Rule(const std::string& ev)
+            : event(ev), period(1), interval(0), tolerance(0), seen(0), tat(0), admitted(0), rate_limited(0),
+              sampled_out(0) {}
+
+        /// @param[in] clock_now - returns the time now (nanoseconds on clock); only called if the event is rate limited
+        template <class Now>
+        bool admit(Now clock_now) {
+            if (period > 1 && seen.fetch_add(1, std::memory_order_relaxed) % period != 0) {
+                sampled_out.fetch_add(1, std::memory_order_relaxed);
+                return false;
+            }
+            if (interval > 0) {
+                uint64_t now = clock_now();
+                uint64_t t = tat.load(std::memory_order_relaxed);
+                do {
+                    if (t > now + tolerance) {
+                        rate_limited.fetch_add(1, std::memory_order_relaxed);
+                        return false;
+                    }
+                } while (!tat.compare_exchange_weak(t, std::max(t, now) + interval, std::memory_order_relaxed));
+            }
+            admitted.fetch_add(1, std::memory_order_relaxed);
+            return true;
+        }
+
+        std::string event;
+        uint32_t period;
+        uint64_t interval;
+        uint64_t tolerance;
+        std::atomic<uint64_t> seen;
+        std::atomic<uint64_t> tat;
+        std::atomic<uint64_t> admitted;
+        std::atomic<uint64_t> rate_limited;
+        std::atomic<uint64_t> sampled_out;
+    };
+
+    /// Bound on a rate limit's interval plus its burst tolerance, so that the times they are added to can't overflow
+    static constexpr double max_ns = 4611686018427387904.0;  // 2^62, about 146 years
+
+    static uint64_t now() {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(clock::now().time_since_epoch()).count();
+    }
+
+    /// @returns the rule for an event, or nullptr if it isn't limited
+    Rule* find(const char* ev) const {
+        for (auto& rule : rules_) {
+            if (std::strcmp(rule->event.c_str(), ev) == 0) {
+                return rule.get();
+            }
+        }
+        return nullptr;
+    }
+
+    Rule& ruleFor(const std::string& ev) {
+        for (auto& rule : rules_) {
+            if (rule->event == ev) {
+                return *rule;
+            }
+        }
+        rules_.emplace_back(new Rule(ev));
+        return *rules_.back();
+    }
+
+    std::vector<std::unique_ptr<Rule>> rules_;
+};
+
+}  // namespace NodeEvent
+
+#endif
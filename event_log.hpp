@@ -0,0 +1,193 @@
+/*
+ * Copyright 2017 Scoop Technologies
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE
+ * WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+ * OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#pragma once
+#ifndef _NODE_EVENT_EVENT_LOG_H
+#define _NODE_EVENT_EVENT_LOG_H
+
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "event_report.hpp"
+#include "spill_codec.hpp"
+
+namespace NodeEvent {
+/// The format of an event log: the magic string, then one record per report sent, each
+///
+///   uint64 timestamp (ns, monotonic), uint64 thread id, uint32 number of events, uint32 bytes of events
+///
+/// followed by the events, encoded with SpillCodec<EventLog::Report>. Integers are in host byte order; a log is meant
+/// to be replayed on the kind of machine it was captured on.
+namespace EventLog {
+typedef EventReport Report;
+
+static const char magic[8] = {'N', 'E', 'V', 'L', 'O', 'G', '1', '\n'};
+
+/// One report, as captured
+struct Record {
+    uint64_t timestamp;
+    uint64_t thread;
+    std::vector<Report> reports;
+};
+
+struct RecordHeader {
+    uint64_t timestamp;
+    uint64_t thread;
+    uint32_t count;
+    uint32_t bytes;
+};
+
+/// Writer appends records to a log. Safe to use from any number of threads; records are written whole, in the order
+/// the threads get to them.
+class Writer {
+ public:
+    /// @param[in] path - the file to write, which is truncated
+    ///
+    /// @throws std::system_error if the file can't be opened
+    explicit Writer(const std::string& path) : lock_(), file_(std::fopen(path.c_str(), "wb")), buffer_() {
+        if (file_ == nullptr) {
+            throw std::system_error(errno, std::generic_category(), "opening event log " + path);
+        }
+        std::fwrite(magic, 1, sizeof(magic), file_);
+    }
+
+    Writer(const Writer& other) = delete;
+    Writer& operator=(const Writer& other) = delete;
+
+    ~Writer() { std::fclose(file_); }
+
+    /// @param[in] timestamp - when the report was sent
+    /// @param[in] reports - the events of the report
+    /// @param[in] count - number of events
+    void write(uint64_t timestamp, const Report* reports, size_t count) {
+        RecordHeader header{timestamp, threadId(), static_cast<uint32_t>(count), 0};
+        for (size_t i = 0; i < count; ++i) {
+            header.bytes += static_cast<uint32_t>(SpillCodec<Report>::size(reports[i]));
+        }
+
+        std::lock_guard<std::mutex> guard{lock_};
+        buffer_.resize(sizeof(header) + header.bytes);
+        std::memcpy(buffer_.data(), &header, sizeof(header));
+        char* out = buffer_.data() + sizeof(header);
+        for (size_t i = 0; i < count; ++i) {
+            SpillCodec<Report>::encode(reports[i], out);
+            out += SpillCodec<Report>::size(reports[i]);
+        }
+        std::fwrite(buffer_.data(), 1, buffer_.size(), file_);
+    }
+
+    /// Write out anything buffered
+    void flush() {
+        std::lock_guard<std::mutex> guard{lock_};
+        std::fflush(file_);
+    }
+
+ private:
+    static uint64_t threadId() { return std::hash<std::thread::id>()(std::this_thread::get_id()); }
+
+    std::mutex lock_;
+    FILE* file_;
+    std::vector<char> buffer_;
+};
+
+/// Reader reads the records of a log back, in order
+class Reader {
+ public:
+    /// @param[in] path - the log to read
+    ///
+    /// @throws std::system_error if the file can't be opened, std::runtime_error if it isn't an event log
+    explicit Reader(const std::string& path)
+        : path_(path), file_(std::fopen(path.c_str(), "rb")), size_(0), buffer_() {
+        if (file_ == nullptr) {
+            throw std::system_error(errno, std::generic_category(), "opening event log " + path);
+        }
+        char header[sizeof(magic)];
+        if (std::fseek(file_, 0, SEEK_END) != 0 || (size_ = std::ftell(file_)) < 0 ||
+            std::fseek(file_, 0, SEEK_SET) != 0 || std::fread(header, 1, sizeof(header), file_) != sizeof(header) ||
+            std::memcmp(header, magic, sizeof(magic)) != 0) {
+            std::fclose(file_);
+            throw std::runtime_error(path + " is not an event log");
+        }
+    }
+
+    Reader(const Reader& other) = delete;
+    Reader& operator=(const Reader& other) = delete;
+
+    ~Reader() { std::fclose(file_); }
+
+    /// @param[out] record - the next record
+    ///
+    /// @returns false at the end of the log
+    ///
+    /// @throws std::runtime_error if the log ends part way through a record, or the record is corrupt (its events
+    ///         don't fit in it); nothing is read beyond the record either way
+    bool next(Record& record) {
+        RecordHeader header;
+        size_t n = std::fread(&header, 1, sizeof(header), file_);
+        if (n == 0) {
+            return false;
+        }
+        // check the header before trusting its sizes
+        if (n != sizeof(header) || static_cast<long>(header.bytes) > size_ - std::ftell(file_)) {
+            throw std::runtime_error(path_ + " is truncated");
+        }
+        buffer_.resize(header.bytes);
+        if (std::fread(buffer_.data(), 1, buffer_.size(), file_) != buffer_.size()) {
+            throw std::runtime_error(path_ + " is truncated");
+        }
+
+        record.timestamp = header.timestamp;
+        record.thread = header.thread;
+        const char* in = buffer_.data();
+        const char* end = in + buffer_.size();
+        // grown as events are decoded, so a corrupt count is caught before it is allocated for
+        for (uint32_t i = 0; i < header.count; ++i) {
+            if (!SpillCodec<Report>::fits(in, end - in)) {
+                throw std::runtime_error(path_ + " is corrupt");
+            }
+            if (record.reports.size() <= i) {
+                record.reports.emplace_back();
+            }
+            in += SpillCodec<Report>::decode(in, record.reports[i]);
+        }
+        if (in != end) {
+            throw std::runtime_error(path_ + " is corrupt");
+        }
+        record.reports.resize(header.count);
+        return true;
+    }
+
+ private:
+    std::string path_;
+    FILE* file_;
+    long size_;
+    std::vector<char> buffer_;
+};
+
+}  // namespace EventLog
+}  // namespace NodeEvent
+
+#endif
@@ -0,0 +1,135 @@
+/*
+ * Copyright 2017 Scoop Technologies
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE
+ * WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+ * OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#pragma once
+#ifndef _NODE_EVENT_EVENT_PATTERN_H
+#define _NODE_EVENT_EVENT_PATTERN_H
+
+#include <cstring>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace NodeEvent {
+/// EventPattern is a compiled pattern over hierarchical, dot separated event names. A "*" segment matches exactly one
+/// segment, and a "**" segment matches any number of segments (including none); any other segment matches itself.
+/// So "solver.*" matches "solver.iter" but not "solver.iter.lp", while "solver.**" matches both, and "solver".
+class EventPattern {
+ public:
+    /// @param[in] pattern - the pattern to compile
+    explicit EventPattern(const std::string& pattern) : pattern_(pattern), segments_() {
+        for (size_t start = 0, end; start <= pattern.size(); start = end + 1) {
+            end = partEnd(pattern.c_str(), pattern.size(), start);
+            std::string text{pattern, start, end - start};
+            if (text == "**") {
+                // consecutive "**" are equivalent to one
+                if (segments_.empty() || segments_.back().kind != Kind::Any) {
+                    segments_.push_back({Kind::Any, ""});
+                }
+            } else if (text == "*") {
+                segments_.push_back({Kind::One, ""});
+            } else {
+                segments_.push_back({Kind::Literal, std::move(text)});
+            }
+        }
+    }
+
+    /// @param[in] name - an event name
+    ///
+    /// @returns true if the name contains a wildcard segment, and so should be compiled as a pattern
+    static bool isPattern(const std::string& name) {
+        for (size_t start = 0, end; start <= name.size(); start = end + 1) {
+            end = partEnd(name.c_str(), name.size(), start);
+            if (end > start && end - start <= 2 && name.compare(start, end - start, "**", end - start) == 0) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    /// Match an event name. This is done for every pattern as a name is resolved on the emitting thread, so the parts
+    /// of the name are walked in place rather than split out.
+    ///
+    /// @param[in] name - the event name to match
+    /// @param[in] len - length of name
+    ///
+    /// @returns true if the pattern matches the whole name
+    bool matches(const char* name, size_t len) const {
+        // p is the offset of the part being matched, which runs up to the next dot; past len, there are none left
+        size_t p = 0;
+        size_t s = 0;
+        // position to resume from if a match after the most recent "**" fails: that "**" then swallows one more part
+        size_t backtrack_s = npos;
+        size_t backtrack_p = 0;
+
+        while (p <= len) {
+            size_t end;
+            if (s < segments_.size() && segments_[s].kind == Kind::Any) {
+                backtrack_s = s++;
+                backtrack_p = p;
+            } else if (s < segments_.size() &&
+                       segmentMatches(segments_[s], name + p, (end = partEnd(name, len, p)) - p)) {
+                ++s;
+                p = end + 1;
+            } else if (backtrack_s != npos) {
+                s = backtrack_s + 1;
+                backtrack_p = partEnd(name, len, backtrack_p) + 1;
+                p = backtrack_p;
+            } else {
+                return false;
+            }
+        }
+        while (s < segments_.size() && segments_[s].kind == Kind::Any) {
+            ++s;
+        }
+        return s == segments_.size();
+    }
+
+    bool matches(const std::string& name) const { return matches(name.c_str(), name.size()); }
+
+    /// @returns the pattern this was compiled from
+    const std::string& str() const { return pattern_; }
+
+ private:
+    static constexpr size_t npos = static_cast<size_t>(-1);
+
+    enum class Kind { Literal, One, Any };
+
+    struct Segment {
+        Kind kind;
+        std::string text;
+    };
+
+    /// @returns the offset of the end of the dot separated part of name starting at start (the dot, or len)
+    static size_t partEnd(const char* name, size_t len, size_t start) {
+        auto dot = static_cast<const char*>(std::memchr(name + start, '.', len - start));
+        return dot ? dot - name : len;
+    }
+
+    static bool segmentMatches(const Segment& segment, const char* part, size_t len) {
+        if (segment.kind == Kind::One) {
+            return true;
+        }
+        return segment.text.size() == len && std::memcmp(segment.text.data(), part, len) == 0;
+    }
+
+    std::string pattern_;
+    std::vector<Segment> segments_;
+};
+
+}  // namespace NodeEvent
+
+#endif
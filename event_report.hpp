@@ -0,0 +1,89 @@
+/*
+ * Copyright 2017 Scoop Technologies
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE
+ * WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+ * OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#pragma once
+#ifndef _NODE_EVENT_EVENT_REPORT_H
+#define _NODE_EVENT_EVENT_REPORT_H
+
+#include <cstdint>
+#include <string>
+#include <utility>
+
+#include "flat_string_map.hpp"
+#include "spill_codec.hpp"
+
+namespace NodeEvent {
+/// EventReport is an event on its way from the thread that emitted it to the loop thread: the name (first), the value
+/// (second), and the StringHash of the name. The hash is worked out once, on the emitting thread, so the loop thread
+/// finds the listeners without hashing the name again. An event the emitter has pinned (see EventEmitter::pin) carries
+/// its pinned number instead, and is dispatched by that without its name being hashed at all.
+struct EventReport : std::pair<std::string, std::string> {
+    /// the pinned number of an event which isn't pinned
+    static constexpr size_t unpinned = static_cast<size_t>(-1);
+
+    EventReport() : std::pair<std::string, std::string>(), hash(0), pinned(unpinned) {}
+
+    /// @param[in] ev - event name
+    /// @param[in] value - event value
+    EventReport(std::string ev, std::string value)
+        : std::pair<std::string, std::string>(std::move(ev), std::move(value)),
+          hash(StringHash::of(first)),
+          pinned(unpinned) {}
+
+    /// @param[in] ev - event name
+    /// @param[in] value - event value
+    /// @param[in] name_hash - StringHash::of(ev), if the caller already has it
+    EventReport(std::string ev, std::string value, uint64_t name_hash)
+        : std::pair<std::string, std::string>(std::move(ev), std::move(value)), hash(name_hash), pinned(unpinned) {}
+
+    /// @param[in] ev - event name
+    /// @param[in] value - event value
+    /// @param[in] name_hash - StringHash::of(ev), or 0 if it wasn't worked out
+    /// @param[in] pinned_as - the number the emitter pinned ev as, or unpinned
+    EventReport(std::string ev, std::string value, uint64_t name_hash, size_t pinned_as)
+        : std::pair<std::string, std::string>(std::move(ev), std::move(value)), hash(name_hash), pinned(pinned_as) {}
+
+    /// @param[in] event - event name and value
+    EventReport(std::pair<std::string, std::string> event)
+        : std::pair<std::string, std::string>(std::move(event)), hash(StringHash::of(first)), pinned(unpinned) {}
+
+    uint64_t hash;
+    size_t pinned;
+};
+
+/// Codec for EventReport: as for the name and value alone, the hash being worked out again as it is decoded, so
+/// spilled and logged reports are unchanged. A decoded report isn't pinned, and is dispatched by name.
+template <>
+struct SpillCodec<EventReport> {
+    typedef SpillCodec<std::pair<std::string, std::string>> Event;
+
+    static size_t size(const EventReport& value) { return Event::size(value); }
+
+    static void encode(const EventReport& value, char* out) { Event::encode(value, out); }
+
+    static bool fits(const char* in, size_t available) { return Event::fits(in, available); }
+
+    static size_t decode(const char* in, EventReport& value) {
+        size_t n = Event::decode(in, value);
+        value.hash = StringHash::of(value.first);
+        value.pinned = EventReport::unpinned;
+        return n;
+    }
+};
+
+}  // namespace NodeEvent
+
+#endif
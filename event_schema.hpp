@@ -0,0 +1,136 @@
+/*
+ * Copyright 2017 Scoop Technologies
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE
+ * WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+ * OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#pragma once
+#ifndef _NODE_EVENT_EVENT_SCHEMA_H
+#define _NODE_EVENT_EVENT_SCHEMA_H
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+#include <string>
+#include <type_traits>
+
+namespace NodeEvent {
+/// Base of an event declaration: an empty tag type naming an event, and the type of its value. An addon declares each
+/// of its events once,
+///
+///     struct Progress : NodeEvent::TypedEvent<double> { static const char* name() { return "progress"; } };
+///     struct Done : NodeEvent::TypedEvent<void> { static const char* name() { return "done"; } };
+///     typedef NodeEvent::EventSchema<Progress, Done> Schema;
+///
+/// and then emits and listens by tag (see TypedEventEmitter and AsyncTypedEventEmittingWorker), so that a misspelled
+/// event is a compile error rather than an event nobody hears.
+template <class T>
+struct TypedEvent {
+    typedef T value_type;
+};
+
+/// EventValue<T> converts the values of an event to the strings listeners receive, and back. Provided for void (no
+/// value, sent as ""), bool ("true" or "false"), std::string and the arithmetic types; specialize it for others, with
+///
+///   static std::string encode(const T& value);
+///   static T decode(const char* value);
+template <class T, class Enable = void>
+struct EventValue;
+
+template <>
+struct EventValue<void> {
+    static std::string encode() { return std::string(); }
+};
+
+template <>
+struct EventValue<std::string> {
+    static std::string encode(const std::string& value) { return value; }
+    static std::string decode(const char* value) { return value; }
+};
+
+template <>
+struct EventValue<bool> {
+    static std::string encode(bool value) { return value ? "true" : "false"; }
+    static bool decode(const char* value) { return std::strcmp(value, "true") == 0; }
+};
+
+template <class T>
+struct EventValue<T, typename std::enable_if<std::is_integral<T>::value && !std::is_same<T, bool>::value>::type> {
+    static std::string encode(T value) { return std::to_string(value); }
+
+    /// @returns 0 for values that aren't integers
+    static T decode(const char* value) {
+        return static_cast<T>(std::is_signed<T>::value ? std::strtoll(value, nullptr, 10)
+                                                       : std::strtoull(value, nullptr, 10));
+    }
+};
+
+template <class T>
+struct EventValue<T, typename std::enable_if<std::is_floating_point<T>::value>::type> {
+    /// as many digits as it takes for decode() to give back the same value
+    static std::string encode(T value) {
+        char buf[32];
+        int n = std::snprintf(buf, sizeof(buf), "%.*g", std::numeric_limits<T>::max_digits10,
+                              static_cast<double>(value));
+        return std::string(buf, n);
+    }
+
+    /// @returns 0 for values that aren't numbers
+    static T decode(const char* value) { return static_cast<T>(std::strtod(value, nullptr)); }
+};
+
+/// EventSchema is the list of events an addon emits, each a TypedEvent tag type. Events are numbered in the order they
+/// are listed, which is the order TypedEventEmitter pins them in.
+template <class... Events>
+class EventSchema {
+    /// the index of E in Es, or sizeof...(Es) if it isn't there
+    template <class E, class... Es>
+    struct Find;
+
+    template <class E>
+    struct Find<E> : std::integral_constant<size_t, 0> {};
+
+    template <class E, class First, class... Rest>
+    struct Find<E, First, Rest...>
+        : std::integral_constant<size_t, std::is_same<E, First>::value ? 0 : 1 + Find<E, Rest...>::value> {};
+
+ public:
+    /// the number of events
+    static constexpr size_t size = sizeof...(Events);
+
+    /// @returns true if E is one of the events
+    template <class E>
+    static constexpr bool contains() {
+        return Find<E, Events...>::value < size;
+    }
+
+    /// @returns the number of the event E; an event outside the schema doesn't compile
+    template <class E>
+    static constexpr size_t index() {
+        static_assert(Find<E, Events...>::value < sizeof...(Events), "the event is not part of the schema");
+        return Find<E, Events...>::value;
+    }
+
+    /// @param[in] i - the number of an event, less than size
+    ///
+    /// @returns the name of the event
+    static const char* name(size_t i) {
+        static const char* const names[] = {Events::name()...};
+        return names[i];
+    }
+};
+
+}  // namespace NodeEvent
+
+#endif
@@ -0,0 +1,218 @@
+/*
+ * Copyright 2017 Scoop Technologies
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE
+ * WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+ * OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#pragma once
+#ifndef _NODE_EVENT_EVENT_STREAM_H
+#define _NODE_EVENT_EVENT_STREAM_H
+
+#include <algorithm>
+#include <atomic>
+#include <deque>
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <nan.h>
+#include <uv.h>
+
+#include "eventemitter_impl.hpp"
+#include "flow_credits.hpp"
+
+namespace NodeEvent {
+/// EventStream lets javascript pull an event in batches, at its own pace, instead of having a listener called for
+/// every one. It is an inline native listener which buffers the events as they are emitted, on the emitting thread.
+/// While it is open, its event name drops unheard events (see EventEmitter::dropUnheard), so an event which nothing
+/// on the loop thread listens to skips the workers' queues; the loop thread is only woken when the stream goes from
+/// empty to not empty while someone is waiting for it.
+///
+/// Producers are paced to the consumer by the stream's credits (see FlowCredits): every buffered event holds a credit
+/// until it is pulled, so a worker given them with FlowControl(stream->credits()) parks once the stream holds
+/// high_water_mark events, until the consumer catches up. An event which is also queued, for listeners on the loop
+/// thread, holds a second credit until it is dispatched. Events from producers which aren't paced by the credits are
+/// dropped (and counted) while the stream is full.
+///
+/// Create it with new, on the loop thread; it deletes itself once closed.
+class EventStream {
+ public:
+    /// Called on the loop thread once there are events to pull, or the stream has been closed
+    typedef std::function<void()> ReadyCallback;
+
+    /// @param[in] emitter - the emitter to listen to
+    /// @param[in] ev - the event name (or pattern) to stream
+    /// @param[in] high_water_mark - the most events the stream holds
+    EventStream(std::shared_ptr<EventEmitter> emitter, const std::string& ev, size_t high_water_mark = 1024)
+        : emitter_(emitter),
+          ev_(ev),
+          buffer_(std::make_shared<Buffer>(high_water_mark)),
+          async_(new uv_async_t()),
+          ready_(),
+          handle_() {
+        uv_async_init(uv_default_loop(), async_.get(), Notified);
+        async_->data = this;
+        buffer_->async = async_.get();
+        auto buffer = buffer_;
+        emitter_->dropUnheard(ev_, true);
+        handle_ = emitter_->onNative(ev, [buffer](const char* e, const char* value) { buffer->push(e, value); },
+                                     EventEmitter::NativeDispatch::Inline);
+    }
+
+    EventStream(const EventStream& other) = delete;
+    EventStream& operator=(const EventStream& other) = delete;
+
+    /// Take buffered events, oldest first, granting their credits back to the producers
+    ///
+    /// @param[out] reports - where to append the events
+    /// @param[in] max - the most events to take
+    ///
+    /// @returns the number of events taken
+    size_t pull(std::vector<EventEmitter::ProgressReport>& reports, size_t max) {
+        size_t n = 0;
+        {
+            std::lock_guard<std::mutex> guard{buffer_->lock};
+            auto& events = buffer_->events;
+            n = std::min(max, events.size());
+            std::move(events.begin(), events.begin() + n, std::back_inserter(reports));
+            events.erase(events.begin(), events.begin() + n);
+        }
+        if (n > 0) {
+            buffer_->credits->grant(static_cast<int64_t>(n));
+        }
+        return n;
+    }
+
+    /// Wait for events to pull: ready is called once there are some, unless there already are
+    ///
+    /// @param[in] ready - called on the loop thread once there are events to pull, or the stream is closed
+    ///
+    /// @returns true if ready will be called, false if there are events to pull now (or the stream is closed)
+    bool wait(ReadyCallback ready) {
+        std::lock_guard<std::mutex> guard{buffer_->lock};
+        if (!buffer_->events.empty() || buffer_->closed) {
+            return false;
+        }
+        ready_ = std::move(ready);
+        buffer_->waiting = true;
+        return true;
+    }
+
+    /// Stop listening, release producers parked on the credits, and delete this once the async handle has closed.
+    /// Events still buffered are discarded, and a pending ready callback is called.
+    void close() {
+        emitter_->dropUnheard(ev_, false);
+        emitter_->off(handle_);
+        {
+            std::lock_guard<std::mutex> guard{buffer_->lock};
+            buffer_->closed = true;
+            buffer_->waiting = false;
+            buffer_->events.clear();
+        }
+        buffer_->credits->close();
+        // NOTABUG: libuv handles are all uv_handle_t underneath
+        uv_close(reinterpret_cast<uv_handle_t*>(async_.get()), Closed);
+    }
+
+    /// @returns the credits which pace producers to this stream's consumer
+    std::shared_ptr<FlowCredits> credits() const { return buffer_->credits; }
+
+    /// @returns the number of events buffered
+    size_t size() const {
+        std::lock_guard<std::mutex> guard{buffer_->lock};
+        return buffer_->events.size();
+    }
+
+    /// @returns the number of events dropped because the stream was full
+    uint64_t dropped() const { return buffer_->dropped.load(std::memory_order_relaxed); }
+
+ private:
+    /// What the listener shares with the stream; the listener may still be running on another thread as the stream is
+    /// closed
+    struct Buffer {
+        explicit Buffer(size_t high_water_mark)
+            : high_water_mark(high_water_mark),
+              credits(std::make_shared<FlowCredits>(static_cast<int64_t>(high_water_mark))),
+              lock(),
+              events(),
+              waiting(false),
+              closed(false),
+              async(nullptr),
+              dropped(0) {}
+
+        void push(const char* ev, const char* value) {
+            std::lock_guard<std::mutex> guard{lock};
+            if (closed) {
+                return;
+            }
+            if (events.size() >= high_water_mark) {
+                dropped.fetch_add(1, std::memory_order_relaxed);
+                return;
+            }
+            events.emplace_back(ev, value);
+            // held until the event is pulled
+            credits->consume();
+            if (waiting) {
+                waiting = false;
+                // under the lock, so the handle can't be closed underneath
+                uv_async_send(async);
+            }
+        }
+
+        const size_t high_water_mark;
+        const std::shared_ptr<FlowCredits> credits;
+        mutable std::mutex lock;
+        std::deque<EventEmitter::ProgressReport> events;
+        bool waiting;
+        bool closed;
+        uv_async_t* async;
+        std::atomic<uint64_t> dropped;
+    };
+
+    ~EventStream() = default;
+
+    // Invoked on the loop thread once events arrive for a waiting consumer
+    static NAUV_WORK_CB(Notified) {
+        auto stream = static_cast<EventStream*>(async->data);
+        stream->callReady();
+    }
+
+    static void Closed(uv_handle_t* handle) {
+        auto stream = static_cast<EventStream*>(handle->data);
+        stream->callReady();
+        delete stream;
+    }
+
+    void callReady() {
+        ReadyCallback ready;
+        std::swap(ready, ready_);
+        if (ready) {
+            ready();
+        }
+    }
+
+    std::shared_ptr<EventEmitter> emitter_;
+    const std::string ev_;
+    std::shared_ptr<Buffer> buffer_;
+    std::unique_ptr<uv_async_t> async_;
+    // only touched on the loop thread
+    ReadyCallback ready_;
+    EventEmitter::ListenerHandle handle_;
+};
+
+}  // namespace NodeEvent
+
+#endif
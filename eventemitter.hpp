@@ -31,7 +31,12 @@
 
 #include "cemitter.h"
 #include "eventemitter_impl.hpp"
+#include "async_event_emitting_worker.hpp"
 #include "async_event_emitting_c_worker.hpp"
 #include "async_event_emitting_reentrant_c_worker.hpp"
+#include "async_event_emitting_coroutine_worker.hpp"
+#include "async_event_log_replay_worker.hpp"
+#include "async_typed_event_emitting_worker.hpp"
+#include "typed_event_emitter.hpp"
 
 #endif
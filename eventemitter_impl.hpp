@@ -18,18 +18,31 @@
 #ifndef _NODE_EVENT_EVENTEMITTER_IMPL_H
 #define _NODE_EVENT_EVENTEMITTER_IMPL_H
 
+#include <algorithm>
+#include <atomic>
+#include <deque>
 #include <functional>
 #include <memory>
+#include <mutex>
 #include <string>
-#include <unordered_map>
 #include <vector>
 
 #include <nan.h>
 #include <uv.h>
 
+#include "cemitter.h"
+#include "event_log.hpp"
+#include "event_pattern.hpp"
+#include "event_report.hpp"
+#include "flat_string_map.hpp"
+#include "latency_histogram.hpp"
+#include "listener_filter.hpp"
+#include "probes.hpp"
+#include "queue_stats.hpp"
 #include "uv_rwlock_adaptor.hpp"
 #include "shared_lock.hpp"
 #include "shared_ringbuffer.hpp"
+#include "slot_map.hpp"
 
 namespace NodeEvent {
 #ifndef UNUSED
@@ -37,9 +50,90 @@ namespace NodeEvent {
 #endif
 /// A type for implementing things that behave like EventEmitter in node
 class EventEmitter {
+    class ReceiverList;
+    class BasicReceiver;
+
+    /// A receiver added while its list was being dispatched, so inserted into it later (see ReceiverList::insert)
+    typedef std::shared_ptr<BasicReceiver> DeferredReceiver;
+
+    /// Which of the lists in a ReceiverList a receiver is kept in
+    enum class Lane : uint8_t { Javascript, NativeLoop, NativeInline };
+
  public:
-     /// A report type, consisting of a key and a value
-     typedef std::pair<std::string, std::string> ProgressReport;
+    /// A report type, consisting of a key and a value (and the hash of the key)
+    typedef EventReport ProgressReport;
+
+    /// An event kept for listeners added later (see retain): its name and value
+    typedef std::pair<std::string, std::string> RetainedEvent;
+
+    /// A listener implemented in C++. It never touches v8, so it may be invoked from any thread
+    typedef std::function<void(const char* ev, const char* value)> NativeListener;
+
+    /// Where a native listener is invoked
+    enum class NativeDispatch {
+        /// On the thread that emitted the event, before it is queued (must be thread-safe, and should be fast)
+        Inline,
+        /// On the thread running the default loop, alongside the javascript listeners
+        Loop
+    };
+
+    /// A handle to a single registered listener, which can be passed to off() to remove it. Handles are cheap to
+    /// copy, and become stale (rather than dangling) once the listener is removed by any means
+    class ListenerHandle {
+     public:
+        ListenerHandle() : list_(), key_(SlotMap<int>::null_key), lane_(Lane::Javascript) {}
+
+        /// @returns false for a default constructed handle
+        explicit operator bool() const { return key_ != SlotMap<int>::null_key; }
+
+     private:
+        friend class EventEmitter;
+        ListenerHandle(std::weak_ptr<ReceiverList> list, uint64_t key, Lane lane,
+                       std::weak_ptr<BasicReceiver> deferred = std::weak_ptr<BasicReceiver>())
+            : list_(std::move(list)), key_(key), lane_(lane), deferred_(std::move(deferred)) {}
+
+        std::weak_ptr<ReceiverList> list_;
+        uint64_t key_;
+        Lane lane_;
+        // the listener, if it was added while its list was being dispatched on the same thread (so it had no key yet)
+        std::weak_ptr<BasicReceiver> deferred_;
+    };
+
+    /// Counters for a single event name (or pattern)
+    struct EventStats {
+        std::string name;
+        /// events emitted by workers, counted on the emitting thread
+        uint64_t emitted;
+        /// events dispatched on the loop thread
+        uint64_t dispatched;
+        /// listener invocations, on any thread
+        uint64_t calls;
+        /// time from a worker queueing the event to its dispatch on the loop thread
+        LatencyHistogram::Summary queue_wait;
+        /// time spent in the loop thread listeners for the event
+        LatencyHistogram::Summary listener;
+    };
+
+    /// Counters for the emitter, and the queues of the workers emitting through it
+    struct Stats {
+        QueueStats::Snapshot queue;
+        std::vector<EventStats> events;
+    };
+
+    /// The time spent in one listener, while profiling is enabled (see profileListeners)
+    struct ListenerProfile {
+        /// the event name (or pattern) the listener is registered for
+        std::string event;
+        /// the name of the javascript function, or "[native]"
+        std::string name;
+        /// the script the function is defined in, and the (1 based) position in it; empty and 0 if unknown
+        std::string source;
+        int line;
+        int column;
+        uint64_t calls;
+        uint64_t total_ns;
+        uint64_t max_ns;
+    };
 
     /// An error indicating the event name is not known
     class InvalidEvent : std::runtime_error {
@@ -47,51 +141,358 @@ class EventEmitter {
         explicit InvalidEvent(const std::string& msg) : std::runtime_error(msg) {}
     };
 
-    EventEmitter() : receivers_lock_(), receivers_() {}
+    EventEmitter()
+        : receivers_lock_(),
+          receivers_(),
+          registered_(0),
+          patterns_(),
+          resolved_(),
+          pinned_(),
+          queue_stats_(std::make_shared<QueueStats>()),
+          profiling_(false),
+          capturing_(false),
+          capture_(),
+          cancellations_(0),
+          drop_unheard_(false) {}
     virtual ~EventEmitter() noexcept = default;
 
-    /// Set a callback for a given event name
+    /// Set a callback for a given event name. The name may be a pattern (see EventPattern), such as "solver.*" or
+    /// "solver.**", in which case the callback is invoked for every matching event, and receives the name of the event
+    /// as its second argument. All of the registration methods accept patterns.
     ///
     /// @param[in] ev - event name
     /// @param[in] cb - callback
-    virtual void on(const std::string& ev, Nan::Callback* cb) {
-        std::unique_lock<uv_rwlock> master_lock{receivers_lock_};
-        auto it = receivers_.find(ev);
+    virtual void on(const std::string& ev, Nan::Callback* cb) { addListener(ev, cb); }
 
-        if (it == receivers_.end()) {
-            receivers_.emplace(ev, std::make_shared<ReceiverList>());
-            it = receivers_.find(ev);
-        }
-        master_lock.unlock();
+    /// Set a callback for a given event name, as on(), but returning a handle for it
+    ///
+    /// @param[in] ev - event name
+    /// @param[in] cb - callback
+    /// @param[in] filter - the callback is only invoked for values the filter accepts
+    ///
+    /// @returns a handle for removing the callback with off()
+    virtual ListenerHandle addListener(const std::string& ev, Nan::Callback* cb,
+                                       const ListenerFilter& filter = ListenerFilter()) {
+        return addTo(ev, Lane::Javascript, [cb, &filter](ReceiverList& list, DeferredReceiver& deferred) {
+            return list.add(cb, false, filter, deferred);
+        });
+    }
 
-        it->second->emplace_back(cb);
+    /// Set a callback for a given event name, which is removed after it is invoked once
+    ///
+    /// @param[in] ev - event name
+    /// @param[in] cb - callback
+    /// @param[in] filter - the callback is invoked for the first value the filter accepts
+    ///
+    /// @returns a handle for removing the callback with off() before it has been invoked
+    virtual ListenerHandle once(const std::string& ev, Nan::Callback* cb,
+                                const ListenerFilter& filter = ListenerFilter()) {
+        return addTo(ev, Lane::Javascript, [cb, &filter](ReceiverList& list, DeferredReceiver& deferred) {
+            return list.add(cb, true, filter, deferred);
+        });
     }
 
-    /// Remove all listeners for a given event
+    /// Set a native listener for a given event name
     ///
     /// @param[in] ev - event name
+    /// @param[in] listener - the listener to invoke
+    /// @param[in] dispatch - whether to invoke the listener inline on the emitting thread, or on the loop thread
+    /// @param[in] filter - the listener is only invoked for values the filter accepts
+    ///
+    /// @returns a handle for removing the listener with off()
+    virtual ListenerHandle onNative(const std::string& ev, NativeListener listener,
+                                    NativeDispatch dispatch = NativeDispatch::Loop,
+                                    const ListenerFilter& filter = ListenerFilter()) {
+        auto lane = dispatch == NativeDispatch::Inline ? Lane::NativeInline : Lane::NativeLoop;
+        return addTo(ev, lane, [&listener, lane, &filter](ReceiverList& list, DeferredReceiver& deferred) {
+            return list.add(listener, lane, false, filter, deferred);
+        });
+    }
+
+    /// Set a native listener implemented in C for a given event name
+    ///
+    /// @param[in] ev - event name
+    /// @param[in] fn - the listener to invoke
+    /// @param[in] data - passed as the first argument of fn
+    /// @param[in] dispatch - whether to invoke the listener inline on the emitting thread, or on the loop thread
+    /// @param[in] filter - the listener is only invoked for values the filter accepts
+    ///
+    /// @returns a handle for removing the listener with off()
+    virtual ListenerHandle onNative(const std::string& ev, eventlistener_fn fn, void* data,
+                                    NativeDispatch dispatch = NativeDispatch::Loop,
+                                    const ListenerFilter& filter = ListenerFilter()) {
+        return onNative(ev, [fn, data](const char* e, const char* value) { fn(data, e, value); }, dispatch, filter);
+    }
+
+    /// Set a native listener for a given event name, which is removed after it is invoked once
+    ///
+    /// @param[in] ev - event name
+    /// @param[in] listener - the listener to invoke
+    /// @param[in] dispatch - whether to invoke the listener inline on the emitting thread, or on the loop thread
+    /// @param[in] filter - the listener is invoked for the first value the filter accepts
+    ///
+    /// @returns a handle for removing the listener with off() before it has been invoked
+    virtual ListenerHandle onceNative(const std::string& ev, NativeListener listener,
+                                      NativeDispatch dispatch = NativeDispatch::Loop,
+                                      const ListenerFilter& filter = ListenerFilter()) {
+        auto lane = dispatch == NativeDispatch::Inline ? Lane::NativeInline : Lane::NativeLoop;
+        return addTo(ev, lane, [&listener, lane, &filter](ReceiverList& list, DeferredReceiver& deferred) {
+            return list.add(listener, lane, true, filter, deferred);
+        });
+    }
+
+    /// Remove a single listener. It is safe to remove a listener from within a listener (for the same event, or for
+    /// an event emitted from one); it will not be invoked again. Once the last listener for an event name is removed,
+    /// the name is forgotten (unless events are retained for it, or it drops unheard events), as with
+    /// removeAllListenersForEvent.
+    ///
+    /// @param[in] handle - handle returned when the listener was added
+    ///
+    /// @returns true if the listener was removed, false if it had already been removed
+    virtual bool off(const ListenerHandle& handle) {
+        auto list = handle.list_.lock();
+        if (!list) {
+            return false;
+        }
+        bool erased;
+        if (handle.key_ == ReceiverList::deferred_key) {
+            auto receiver = handle.deferred_.lock();
+            erased = receiver && list->erase(*receiver, handle.lane_);
+        } else {
+            erased = list->erase(handle.key_, handle.lane_);
+        }
+        // a removal deferred until the list has been dispatched is pruned then
+        prune(*list);
+        return erased;
+    }
+
+    /// Remove all listeners for a given event
+    ///
+    /// @param[in] ev - event name (or pattern, which removes the listeners for that pattern, but not for the event
+    ///                 names it matches). The events retained for it (see retain) are kept.
     virtual void removeAllListenersForEvent(const std::string& ev) {
         std::unique_lock<uv_rwlock> master_lock{receivers_lock_};
-        auto it = receivers_.find(ev);
+        auto list = receivers_.find(ev);
 
-        if (it != receivers_.end()) {
-            receivers_.erase(it);
+        if (list && (*list)->persistent()) {
+            (*list)->clear();
+        } else if (list) {
+            forget(*list);
         }
     }
 
-    /// Remove all listeners for all events
+    /// Remove all listeners for all events. The events retained (see retain) are kept.
     virtual void removeAllListeners() {
         std::unique_lock<uv_rwlock> master_lock{receivers_lock_};
-        receivers_.clear();
+        std::vector<std::shared_ptr<ReceiverList>> unretained;
+        for (auto& it : receivers_) {
+            if (it.second->persistent()) {
+                it.second->clear();
+            } else {
+                unretained.push_back(it.second);
+            }
+        }
+        for (auto& list : unretained) {
+            forget(list);
+        }
     }
 
-    // Return a list of all eventNames
-    virtual std::vector<std::string> eventNames() {
+    /// Keep the last n events dispatched on the loop thread for an event name (or pattern), and replay them, oldest
+    /// first, to each listener added for that name (or pattern) afterwards, as it is added. Late subscribers, such as
+    /// a dashboard attaching to a running solve, then see the current state straight away, without the producer
+    /// emitting it again periodically. An event being retained is queued for the loop thread even while it has no
+    /// listeners there.
+    ///
+    /// The events are replayed on the thread adding the listener, and pass its filter (and satisfy a once listener)
+    /// as if they were being dispatched. A listener added on the loop thread receives the kept events and then the
+    /// ones dispatched after them, in order. Inline native listeners receive events before they are queued, so what is
+    /// replayed to them is older than the events they receive next.
+    ///
+    /// @param[in] ev - event name (or pattern, which keeps the last n events matching it, with their names)
+    /// @param[in] n - the number of events to keep; 0 to stop keeping them, and forget those kept
+    virtual void retain(const std::string& ev, size_t n = 1) {
         std::unique_lock<uv_rwlock> master_lock{receivers_lock_};
-        std::vector<std::string> keys;
+        auto list = unlocked_listFor(ev);
+        list->retain(n);
+        unlocked_prune(list);
+    }
 
-        for (auto it : receivers_) {
-            keys.emplace_back(it.first);
+    /// @param[in] ev - event name (or pattern)
+    ///
+    /// @returns the events retained for it (see retain), oldest first
+    virtual std::vector<RetainedEvent> retained(const std::string& ev) const {
+        std::shared_ptr<ReceiverList> list;
+        {
+            shared_lock<uv_rwlock> master_lock{receivers_lock_};
+            auto found = receivers_.find(ev);
+            if (!found) {
+                return {};
+            }
+            list = *found;
+        }
+        return list->retained();
+    }
+
+    /// @returns the counters the workers emitting through this emitter count their queues in
+    std::shared_ptr<QueueStats> queueStats() const { return queue_stats_; }
+
+    /// Cancel the work of every worker emitting through this emitter, which was created before now (see
+    /// AsyncQueuedProgressWorker::Cancel). Workers created afterwards aren't affected.
+    void cancel() { cancellations_.fetch_add(1, std::memory_order_relaxed); }
+
+    /// @returns how many times cancel() has been called; a worker remembers this when it is created, and is
+    ///          cancelled once it changes
+    uint64_t cancellations() const { return cancellations_.load(std::memory_order_relaxed); }
+
+    /// Have the workers emitting through this emitter drop an event as it is emitted if, at that moment, no listener
+    /// on the loop thread wants it (there are none, or their stateless filters reject the value), rather than queueing
+    /// it to be looked up once the loop thread dispatches it. That saves the queue hop for events nobody listens to,
+    /// but a listener added while such events are in flight never receives them. Off by default. Retained events (see
+    /// retain) are always queued.
+    ///
+    /// @param[in] enable - whether to drop unheard events as they are emitted
+    void dropUnheard(bool enable) { drop_unheard_.store(enable, std::memory_order_relaxed); }
+
+    /// @returns true if unheard events are dropped as they are emitted (see dropUnheard)
+    bool dropsUnheard() const { return drop_unheard_.load(std::memory_order_relaxed); }
+
+    /// dropUnheard for a single event name (or pattern): an event whose every list drops unheard events, and which no
+    /// listener on the loop thread wants, is dropped as it is emitted. Calls nest, so that several users of a name
+    /// (such as the EventStreams on it) can each turn it on and off: unheard events are dropped until each call
+    /// enabling it has been matched by one disabling it.
+    ///
+    /// @param[in] ev - event name (or pattern)
+    /// @param[in] enable - whether to drop unheard events as they are emitted
+    virtual void dropUnheard(const std::string& ev, bool enable) {
+        std::unique_lock<uv_rwlock> master_lock{receivers_lock_};
+        if (enable) {
+            unlocked_listFor(ev)->dropUnheard(true);
+            return;
+        }
+        auto list = receivers_.find(ev);
+        if (list) {
+            auto l = *list;
+            l->dropUnheard(false);
+            unlocked_prune(l);
+        }
+    }
+
+    /// @returns a snapshot of the counters, for the queues and for each event name
+    virtual Stats stats() const {
+        Stats s{queue_stats_->snapshot(), {}};
+        shared_lock<uv_rwlock> master_lock{receivers_lock_};
+        for (auto& it : receivers_) {
+            s.events.push_back(it.second->stats(it.first));
+        }
+        return s;
+    }
+
+    /// Time every call of the listeners on the loop thread (javascript and NativeDispatch::Loop), so that
+    /// topListeners() can point at the ones holding up the loop. Off by default, as it costs two clock reads per call.
+    ///
+    /// @param[in] enable - whether to time listeners
+    virtual void profileListeners(bool enable) { profiling_.store(enable, std::memory_order_relaxed); }
+
+    /// Must be called on the loop thread, as the names and positions of javascript listeners are looked up from v8.
+    ///
+    /// @param[in] n - the number of listeners to return
+    ///
+    /// @returns the n listeners which have taken the most time in total since profiling was enabled (or the stats
+    ///          were reset), slowest first
+    virtual std::vector<ListenerProfile> topListeners(size_t n) const {
+        std::vector<ReceiverList::Timed> timed;
+        {
+            shared_lock<uv_rwlock> master_lock{receivers_lock_};
+            for (auto& it : receivers_) {
+                it.second->timed(it.first, timed);
+            }
+        }
+
+        n = std::min(n, timed.size());
+        std::partial_sort(timed.begin(), timed.begin() + n, timed.end(),
+                          [](const ReceiverList::Timed& a, const ReceiverList::Timed& b) {
+                              return a.profile.total_ns > b.profile.total_ns;
+                          });
+
+        // only describe the listeners being returned, as looking up a function's name and position isn't free
+        std::vector<ListenerProfile> top;
+        for (size_t i = 0; i < n; ++i) {
+            if (timed[i].receiver) {
+                timed[i].receiver->describe(timed[i].profile);
+            }
+            top.push_back(timed[i].profile);
+        }
+        return top;
+    }
+
+    /// Zero all of the counters, including the listener timings
+    virtual void resetStats() {
+        queue_stats_->reset();
+        shared_lock<uv_rwlock> master_lock{receivers_lock_};
+        for (auto& it : receivers_) {
+            it.second->resetStats();
+        }
+    }
+
+    /// Write every event the workers emitting through this emitter accept to a log, until stopCapture() (see EventLog,
+    /// and AsyncEventLogReplayWorker to replay it). Events are written as they were emitted: including those which
+    /// had no listeners, were rate limited or sampled out, or were folded into an aggregate (whose summaries aren't
+    /// written), so that replaying the log reproduces what the producer emitted.
+    ///
+    /// @param[in] log - where to write the events
+    virtual void startCapture(std::shared_ptr<EventLog::Writer> log) {
+        std::atomic_store(&capture_, log);
+        capturing_.store(true, std::memory_order_release);
+    }
+
+    /// Stop capturing, and flush the log
+    virtual void stopCapture() {
+        capturing_.store(false, std::memory_order_release);
+        auto log = std::atomic_exchange(&capture_, std::shared_ptr<EventLog::Writer>());
+        if (log) {
+            log->flush();
+        }
+    }
+
+    /// @returns true if events are being captured
+    bool capturing() const { return capturing_.load(std::memory_order_acquire); }
+
+    /// Write events to the capture log, if capturing; called by the workers as events are accepted
+    ///
+    /// @param[in] timestamp - when the events were emitted
+    /// @param[in] reports - the events, emitted together
+    /// @param[in] count - the number of events
+    void capture(uint64_t timestamp, const ProgressReport* reports, size_t count) const {
+        // the flag keeps the (locking) atomic shared_ptr load off the path when not capturing
+        if (!capturing_.load(std::memory_order_acquire)) {
+            return;
+        }
+        auto log = std::atomic_load(&capture_);
+        if (log) {
+            log->write(timestamp, reports, count);
+        }
+    }
+
+    // Return a list of all eventNames (and patterns) which have listeners, the most recently registered first
+    virtual std::vector<std::string> eventNames() {
+        std::vector<std::pair<uint64_t, std::string>> registered;
+        {
+            std::unique_lock<uv_rwlock> master_lock{receivers_lock_};
+            for (auto& it : receivers_) {
+                if (!it.second->empty()) {
+                    registered.emplace_back(it.second->registered(), it.first);
+                }
+            }
+        }
+        // the map's own order depends on the hashes
+        std::sort(registered.begin(), registered.end(),
+                  [](const std::pair<uint64_t, std::string>& a, const std::pair<uint64_t, std::string>& b) {
+                      return a.first > b.first;
+                  });
+
+        std::vector<std::string> keys;
+        for (auto& it : registered) {
+            keys.push_back(std::move(it.second));
         }
         return keys;
     }
@@ -103,30 +504,209 @@ class EventEmitter {
     ///
     /// @returns true if the event has listeners, false otherwise
     virtual bool emit(const std::string& ev, const std::string& value) const {
-        shared_lock<uv_rwlock> master_lock{receivers_lock_};
-        auto it = receivers_.find(ev);
-        if (it == receivers_.end()) {
-            return false;
+        return emit(ev, StringHash::of(ev), value);
+    }
+
+    /// Emit a value to any registered callbacks for the event, whose name has already been hashed (as in a
+    /// ProgressReport)
+    ///
+    /// @param[in] ev - event name
+    /// @param[in] hash - StringHash::of(ev)
+    /// @param[in] value - a string to emit
+    /// @param[in] enqueued - the uv_hrtime() at which a worker queued the event, or 0 if it wasn't queued
+    ///
+    /// @returns true if the event has listeners, false otherwise
+    virtual bool emit(const std::string& ev, uint64_t hash, const std::string& value, uint64_t enqueued = 0) const {
+        bool profile = profiling_.load(std::memory_order_relaxed);
+        return forEachList(ev.c_str(), hash, [this, &ev, &value, enqueued, profile](ReceiverList& list) {
+            list.emit(ev, value, enqueued, profile);
+            prune(list);
+        });
+    }
+
+    /// Notify the inline native listeners for the event. Safe to call from any thread; this is called by the workers
+    /// before an event is queued for the loop thread.
+    ///
+    /// @param[in] ev - event name
+    /// @param[in] value - the value to emit
+    ///
+    /// @returns true if the event still needs to be queued for the loop thread: it has listeners there whose filters
+    ///          might accept the value, or is retained, or unheard events aren't dropped (see dropUnheard)
+    virtual bool emitInline(const char* ev, const char* value) const {
+        return emitInline(ev, StringHash::of(ev), value);
+    }
+
+    /// emitInline for an event whose name has already been hashed, such as by a worker about to queue it
+    ///
+    /// @param[in] ev - event name
+    /// @param[in] hash - StringHash::of(ev)
+    /// @param[in] value - the value to emit
+    ///
+    /// @returns as emitInline(ev, value)
+    virtual bool emitInline(const char* ev, uint64_t hash, const char* value) const {
+        bool needs_loop = false;
+        bool drops = true;
+        bool found = forEachList(ev, hash, [this, ev, value, &needs_loop, &drops](ReceiverList& list) {
+            needs_loop |= list.emitInline(ev, value);
+            drops &= list.dropsUnheard();
+            prune(list);
+        });
+        return needs_loop || !dropping(found && drops);
+    }
+
+    /// Emit a value for a pinned event (see pin()), without looking its name up
+    ///
+    /// @param[in] pinned - the number pin() returned for the event
+    /// @param[in] value - a string to emit
+    /// @param[in] enqueued - the uv_hrtime() at which a worker queued the event, or 0 if it wasn't queued
+    ///
+    /// @returns true if the event has listeners, false otherwise
+    virtual bool emit(size_t pinned, const std::string& value, uint64_t enqueued = 0) const {
+        bool profile = profiling_.load(std::memory_order_relaxed);
+        const std::string* ev;
+        auto lists = resolvePinned(pinned, ev);
+        for (auto& list : *lists) {
+            list->emit(*ev, value, enqueued, profile);
+            prune(*list);
+        }
+        return !lists->empty();
+    }
+
+    /// Notify the inline native listeners for a pinned event (see pin()), without looking its name up. Safe to call
+    /// from any thread.
+    ///
+    /// @param[in] pinned - the number pin() returned for the event
+    /// @param[in] value - the value to emit
+    ///
+    /// @returns true if the event still needs to be queued for the loop thread (as emitInline(ev, value))
+    virtual bool emitInline(size_t pinned, const char* value) const {
+        bool needs_loop = false;
+        bool drops = true;
+        const std::string* ev;
+        auto lists = resolvePinned(pinned, ev);
+        for (auto& list : *lists) {
+            needs_loop |= list->emitInline(ev->c_str(), value);
+            drops &= list->dropsUnheard();
+            prune(*list);
         }
-        master_lock.unlock();
+        return needs_loop || !dropping(!lists->empty() && drops);
+    }
 
-        it->second->emit(value);
-        return true;
+ protected:
+    /// Pin an event name: its lists are resolved once, and kept until a list is added or removed for the name itself
+    /// or for a pattern matching it, so that emitting it by number is an index rather than a hash lookup. Pins are
+    /// never released, so this is meant for the fixed set of events an emitter is built for (see TypedEventEmitter).
+    ///
+    /// @param[in] ev - event name (not a pattern)
+    ///
+    /// @returns the number to emit the event by
+    size_t pin(const std::string& ev) {
+        std::unique_lock<uv_rwlock> master_lock{receivers_lock_};
+        pinned_.push_back({ev, nullptr});
+        return pinned_.size() - 1;
     }
 
  private:
+    /// BasicReceiver holds the state common to all kinds of receiver
+    class BasicReceiver {
+     public:
+        BasicReceiver(bool once, const ListenerFilter& filter)
+            : once_(once), removed_(false), filter_(filter.instance()), timed_calls_(0), total_ns_(0), max_ns_(0) {}
+
+        /// @returns true if the receiver hasn't been removed and its filter accepts the value (so a removed receiver
+        ///          doesn't advance a sampling filter); must be called once per event, before claim()
+        bool accept(const char* value) const {
+            return !removed_.load(std::memory_order_acquire) && filter_.accept(value);
+        }
+
+        /// @returns false if the receiver definitely won't be notified of the value
+        bool mayAccept(const char* value) const {
+            return !removed_.load(std::memory_order_relaxed) && filter_.mayAccept(value);
+        }
+
+        /// @returns true if the receiver should be notified. A once receiver only returns true the first time, and
+        ///          a removed receiver never does
+        bool claim() { return !removed_.load(std::memory_order_acquire) && (!once_ || !removed_.exchange(true)); }
+
+        /// mark the receiver as removed, so it won't be notified even though it is still in the list
+        void remove() { removed_.store(true, std::memory_order_release); }
+
+        /// @returns true once the receiver has been removed (or a once receiver claimed)
+        bool removed() const { return removed_.load(std::memory_order_acquire); }
+
+        bool once() const { return once_; }
+
+        /// @param[in] ns - how long a call of the receiver took
+        void timed(uint64_t ns) {
+            timed_calls_.fetch_add(1, std::memory_order_relaxed);
+            total_ns_.fetch_add(ns, std::memory_order_relaxed);
+            // only the loop thread times receivers, so there's no race to raise the max
+            if (ns > max_ns_.load(std::memory_order_relaxed)) {
+                max_ns_.store(ns, std::memory_order_relaxed);
+            }
+        }
+
+        /// fill in the timing of a profile from the calls timed so far
+        void timing(ListenerProfile& profile) const {
+            profile.calls = timed_calls_.load(std::memory_order_relaxed);
+            profile.total_ns = total_ns_.load(std::memory_order_relaxed);
+            profile.max_ns = max_ns_.load(std::memory_order_relaxed);
+        }
+
+        void resetTiming() {
+            timed_calls_.store(0, std::memory_order_relaxed);
+            total_ns_.store(0, std::memory_order_relaxed);
+            max_ns_.store(0, std::memory_order_relaxed);
+        }
+
+     private:
+        bool once_;
+        std::atomic<bool> removed_;
+        ListenerFilter filter_;
+        std::atomic<uint64_t> timed_calls_;
+        std::atomic<uint64_t> total_ns_;
+        std::atomic<uint64_t> max_ns_;
+    };
+
     /// Receiver represents a callback that will receive events that are fired
-    class Receiver {
+    class Receiver : public BasicReceiver {
      public:
         /// @param[in] callback - the callback to fire, should take a single argument (which will be a string)
-        explicit Receiver(Nan::Callback* callback) : callback_(callback) {}
+        /// @param[in] once - whether the callback should only be fired once
+        /// @param[in] filter - the callback is only fired for values the filter accepts
+        Receiver(Nan::Callback* callback, bool once, const ListenerFilter& filter)
+            : BasicReceiver(once, filter), callback_(callback) {}
 
         /// notify the callback by building an AsyncWorker and scheduling it via Nan::AsyncQueueWorker()
         ///
+        /// @param[in] ev - the event name, which is sent as the second argument if with_event_name is set
         /// @param[in] value - the string value to send to the callback
-        void notify(const std::string& value) const {
-            v8::Local<v8::Value> info[] = {Nan::New<v8::String>(value).ToLocalChecked()};
-            callback_->Call(1, info);
+        /// @param[in] with_event_name - whether to send the event name
+        void notify(const std::string& ev, const std::string& value, bool with_event_name) const {
+            NODE_EVENT_PROBE3(notify, ev.c_str(), value.c_str(), static_cast<int>(Lane::Javascript));
+            if (with_event_name) {
+                v8::Local<v8::Value> info[] = {Nan::New<v8::String>(value).ToLocalChecked(),
+                                               Nan::New<v8::String>(ev).ToLocalChecked()};
+                callback_->Call(2, info);
+            } else {
+                v8::Local<v8::Value> info[] = {Nan::New<v8::String>(value).ToLocalChecked()};
+                callback_->Call(1, info);
+            }
+        }
+
+        /// fill in the name and source position of the callback; must be called on the loop thread
+        void describe(ListenerProfile& profile) const {
+            Nan::HandleScope scope;
+            v8::Local<v8::Function> fn = callback_->GetFunction();
+            v8::Local<v8::Value> name = fn->GetName();
+            if (!name->IsString() || v8::String::Utf8Value(name).length() == 0) {
+                name = fn->GetInferredName();
+            }
+            profile.name = *v8::String::Utf8Value(name);
+            profile.source = *v8::String::Utf8Value(fn->GetScriptOrigin().ResourceName());
+            // v8's positions are 0 based, and negative if unknown
+            profile.line = fn->GetScriptLineNumber() + 1;
+            profile.column = fn->GetScriptColumnNumber() + 1;
         }
 
         ~Receiver() {
@@ -138,36 +718,870 @@ class EventEmitter {
         Nan::Callback* callback_;
     };
 
-    /// ReceiverList is a list of receivers. Access to the list is proteced via shared mutex
+    /// NativeReceiver represents a native listener
+    class NativeReceiver : public BasicReceiver {
+     public:
+        /// @param[in] listener - the listener to invoke
+        /// @param[in] once - whether the listener should only be invoked once
+        /// @param[in] filter - the listener is only invoked for values the filter accepts
+        NativeReceiver(NativeListener listener, bool once, const ListenerFilter& filter)
+            : BasicReceiver(once, filter), listener_(std::move(listener)) {}
+
+        void notify(const char* ev, const char* value) const { listener_(ev, value); }
+
+     private:
+        NativeListener listener_;
+    };
+
+    /// ReceiverList is a list of receivers. Access to the list is proteced via shared mutex. Native listeners are kept
+    /// apart from the javascript receivers so that the inline ones can be notified without touching v8. Each list is
+    /// a SlotMap, so single receivers can be removed by key without giving up contiguous iteration in insertion order
     class ReceiverList {
      public:
-        ReceiverList() : receivers_list_(), receivers_list_lock_() {}
+        /// @param[in] name - the event name (or pattern) the list is for
+        /// @param[in] with_event_name - whether javascript receivers are sent the event name (for patterns)
+        /// @param[in] registered - orders the list among the others of its emitter, by when it was created
+        ReceiverList(const std::string& name, bool with_event_name, uint64_t registered)
+            : name_(name),
+              with_event_name_(with_event_name),
+              registered_(registered),
+              state_(0),
+              receivers_list_(),
+              native_loop_list_(),
+              native_inline_list_(),
+              receivers_list_lock_(),
+              spent_(),
+              added_(),
+              spent_lock_(),
+              emitted_(0),
+              dispatched_(0),
+              calls_(0),
+              queue_wait_(),
+              listener_(),
+              retain_(0),
+              retained_(),
+              retained_lock_(),
+              drop_unheard_(0) {}
+
+        /// The key of a receiver added while the list was being dispatched on the same thread, until it is inserted
+        static constexpr uint64_t deferred_key = ~uint64_t(0);
 
-        /// Adds a callback to the end of the receivers_list
+        /// Adds a callback to the receivers_list
         ///
         /// @param[in] cb - the callback to add to the list
-        void emplace_back(Nan::Callback* cb) {
+        /// @param[in] once - whether the callback is removed once it has been fired
+        /// @param[in] filter - filter for the values the callback is fired for
+        /// @param[out] deferred - the receiver, if it is only inserted once the list has been dispatched (see insert)
+        ///
+        /// @returns the key of the receiver, deferred_key, or null_key if the list has been pruned (and the callback
+        ///          is still the caller's)
+        uint64_t add(Nan::Callback* cb, bool once, const ListenerFilter& filter, DeferredReceiver& deferred) {
+            if (!reserve()) {
+                return SlotMap<int>::null_key;
+            }
+            return insert(receivers_list_, std::make_shared<Receiver>(cb, once, filter), Lane::Javascript, deferred);
+        }
+
+        /// Adds a native listener to the appropriate list
+        ///
+        /// @param[in] listener - the listener to add
+        /// @param[in] lane - NativeLoop or NativeInline
+        /// @param[in] once - whether the listener is removed once it has been invoked
+        /// @param[in] filter - filter for the values the listener is invoked for
+        /// @param[out] deferred - the receiver, if it is only inserted once the list has been dispatched (see insert)
+        ///
+        /// @returns the key of the receiver, deferred_key, or null_key if the list has been pruned
+        uint64_t add(NativeListener listener, Lane lane, bool once, const ListenerFilter& filter,
+                     DeferredReceiver& deferred) {
+            if (!reserve()) {
+                return SlotMap<int>::null_key;
+            }
+            return insert(natives(lane), std::make_shared<NativeReceiver>(std::move(listener), once, filter), lane,
+                          deferred);
+        }
+
+        /// Removes a receiver. If the list is being dispatched on this same thread (by a listener for it, or for an
+        /// event emitted from one), we already hold the lock shared, so the removal is deferred until the emit
+        /// completes
+        ///
+        /// @param[in] key - key of the receiver
+        /// @param[in] lane - the list the receiver is in
+        ///
+        /// @returns true if the receiver was present
+        bool erase(uint64_t key, Lane lane) {
+            if (Dispatching::active(this)) {
+                BasicReceiver* receiver = find(key, lane);
+                if (!receiver) {
+                    return false;
+                }
+                receiver->remove();
+                defer(key, lane);
+                return true;
+            }
+
+            std::lock_guard<uv_rwlock> guard{receivers_list_lock_};
+            return unlocked_erase(key, lane);
+        }
+
+        /// Removes a receiver added with deferred_key, which may or may not have been inserted since
+        ///
+        /// @param[in] receiver - the receiver
+        /// @param[in] lane - the list the receiver was added to
+        ///
+        /// @returns true if the receiver was present
+        bool erase(BasicReceiver& receiver, Lane lane) {
+            {
+                std::lock_guard<std::mutex> guard{spent_lock_};
+                for (auto& a : added_) {
+                    if (a.first.get() == &receiver) {
+                        // skipped once it would have been inserted
+                        bool present = !receiver.removed();
+                        receiver.remove();
+                        return present;
+                    }
+                }
+            }
+
+            uint64_t key;
+            if (Dispatching::active(this)) {
+                key = keyOf(&receiver, lane);
+            } else {
+                shared_lock<uv_rwlock> guard{receivers_list_lock_};
+                key = keyOf(&receiver, lane);
+            }
+            return erase(key, lane);
+        }
+
+        /// Removes every receiver. As with erase, the removal is deferred if the list is being dispatched on this
+        /// thread
+        void clear() {
+            {
+                std::lock_guard<std::mutex> guard{spent_lock_};
+                for (auto& a : added_) {
+                    a.first->remove();
+                }
+            }
+            if (Dispatching::active(this)) {
+                deferAll(receivers_list_, Lane::Javascript);
+                deferAll(native_loop_list_, Lane::NativeLoop);
+                deferAll(native_inline_list_, Lane::NativeInline);
+                return;
+            }
+
             std::lock_guard<uv_rwlock> guard{receivers_list_lock_};
-            receivers_list_.emplace_back(std::make_shared<Receiver>(cb));
+            state_.fetch_sub(receivers_list_.size() + native_loop_list_.size() + native_inline_list_.size(),
+                             std::memory_order_acq_rel);
+            receivers_list_.clear();
+            native_loop_list_.clear();
+            native_inline_list_.clear();
+        }
+
+        /// Keep the last n events dispatched through the list, to replay to each receiver added to it
+        ///
+        /// @param[in] n - the number of events to keep; 0 to stop keeping them
+        void retain(size_t n) {
+            std::lock_guard<std::mutex> guard{retained_lock_};
+            retain_.store(n, std::memory_order_relaxed);
+            while (retained_.size() > n) {
+                retained_.pop_front();
+            }
+        }
+
+        /// @returns the event name (or pattern) the list is for
+        const std::string& name() const { return name_; }
+
+        /// @returns when the list was created, relative to the others of its emitter
+        uint64_t registered() const { return registered_; }
+
+        /// @returns true if the list has no receivers, not even ones whose removal is deferred; lock free
+        bool unused() const { return (state_.load(std::memory_order_acquire) & ~pruned) == 0; }
+
+        /// Mark the list pruned if it has no receivers, so that adding to it fails from now on (and the receiver is
+        /// added to a new list for the name instead)
+        ///
+        /// @returns true if the list was pruned
+        bool prune() {
+            uint64_t expected = 0;
+            return state_.compare_exchange_strong(expected, pruned, std::memory_order_acq_rel) ||
+                   (expected & pruned) != 0;
+        }
+
+        /// Mark the list pruned, whether or not it has receivers; they are no longer reachable through the emitter
+        void forget() { state_.fetch_or(pruned, std::memory_order_acq_rel); }
+
+        /// @returns true if the list keeps the last events dispatched through it
+        bool retains() const { return retain_.load(std::memory_order_relaxed) > 0; }
+
+        /// Drop an event emitted with no receiver on the loop thread that wants it, rather than queueing it; nests (see
+        /// EventEmitter::dropUnheard(ev, enable))
+        ///
+        /// @param[in] enable - true to drop unheard events, false to undo an earlier call with true
+        void dropUnheard(bool enable) {
+            if (enable) {
+                drop_unheard_.fetch_add(1, std::memory_order_relaxed);
+                return;
+            }
+            size_t n = drop_unheard_.load(std::memory_order_relaxed);
+            while (n > 0 && !drop_unheard_.compare_exchange_weak(n, n - 1, std::memory_order_relaxed)) {
+            }
         }
 
-        /// notify all receivers
+        /// @returns true if the list drops unheard events
+        bool dropsUnheard() const { return drop_unheard_.load(std::memory_order_relaxed) > 0; }
+
+        /// @returns true if the list has settings (retained events, or dropping unheard events) which outlive its
+        ///          receivers, so it is kept while it has none
+        bool persistent() const { return retains() || dropsUnheard(); }
+
+        /// @returns the events kept, oldest first
+        std::vector<RetainedEvent> retained() const {
+            std::lock_guard<std::mutex> guard{retained_lock_};
+            return {retained_.begin(), retained_.end()};
+        }
+
+        /// @returns true if there are no receivers at all
+        bool empty() const {
+            shared_lock<uv_rwlock> guard{receivers_list_lock_};
+            return receivers_list_.empty() && native_loop_list_.empty() && native_inline_list_.empty();
+        }
+
+        /// notify all receivers on the loop thread
         ///
+        /// @param[in] ev - the event name
         /// @param[in] value - the string to send to all receivers
-        void emit(const std::string& value) const {
+        /// @param[in] enqueued - the uv_hrtime() at which the event was queued, or 0
+        /// @param[in] profile - whether to time each receiver
+        void emit(const std::string& ev, const std::string& value, uint64_t enqueued, bool profile) {
+            uint64_t calls = 0;
+            uint64_t start = uv_hrtime();
+            if (enqueued != 0 && enqueued <= start) {
+                queue_wait_.record(start - enqueued);
+            }
+            {
+                shared_lock<uv_rwlock> guard{receivers_list_lock_};
+                Dispatching scope{this};
+                // kept under the lock, so a receiver being added either has the event replayed or is notified of it
+                if (retains()) {
+                    record(ev, value);
+                }
+
+                for (size_t i = 0; i < native_loop_list_.size(); ++i) {
+                    auto& receiver = *(native_loop_list_.begin() + i);
+                    if (receiver->accept(value.c_str()) && receiver->claim()) {
+                        NODE_EVENT_PROBE3(notify, ev.c_str(), value.c_str(), static_cast<int>(Lane::NativeLoop));
+                        uint64_t called = profile ? uv_hrtime() : 0;
+                        receiver->notify(ev.c_str(), value.c_str());
+                        if (profile) {
+                            receiver->timed(uv_hrtime() - called);
+                        }
+                        ++calls;
+                        if (receiver->once()) {
+                            defer(native_loop_list_.key_at(i), Lane::NativeLoop);
+                        }
+                    }
+                }
+                for (size_t i = 0; i < receivers_list_.size(); ++i) {
+                    auto& receiver = *(receivers_list_.begin() + i);
+                    if (receiver->accept(value.c_str()) && receiver->claim()) {
+                        uint64_t called = profile ? uv_hrtime() : 0;
+                        receiver->notify(ev, value, with_event_name_);
+                        if (profile) {
+                            receiver->timed(uv_hrtime() - called);
+                        }
+                        ++calls;
+                        if (receiver->once()) {
+                            defer(receivers_list_.key_at(i), Lane::Javascript);
+                        }
+                    }
+                }
+            }
+            if (calls > 0) {
+                listener_.record(uv_hrtime() - start);
+            }
+            dispatched_.fetch_add(1, std::memory_order_relaxed);
+            calls_.fetch_add(calls, std::memory_order_relaxed);
+            reap();
+        }
+
+        /// notify the inline native listeners
+        ///
+        /// @param[in] ev - the event name
+        /// @param[in] value - the value to send
+        ///
+        /// @returns true if there are receivers on the loop thread that might accept the value, or the list retains
+        ///          events
+        bool emitInline(const char* ev, const char* value) {
+            bool has_loop_receivers;
+            uint64_t calls = 0;
+            {
+                shared_lock<uv_rwlock> guard{receivers_list_lock_};
+                Dispatching scope{this};
+
+                for (size_t i = 0; i < native_inline_list_.size(); ++i) {
+                    auto& receiver = *(native_inline_list_.begin() + i);
+                    if (receiver->accept(value) && receiver->claim()) {
+                        NODE_EVENT_PROBE3(notify, ev, value, static_cast<int>(Lane::NativeInline));
+                        receiver->notify(ev, value);
+                        ++calls;
+                        if (receiver->once()) {
+                            defer(native_inline_list_.key_at(i), Lane::NativeInline);
+                        }
+                    }
+                }
+                // an event being retained is queued even without receivers, as it is kept on the loop thread
+                has_loop_receivers =
+                    retains() || mayAccept(native_loop_list_, value) || mayAccept(receivers_list_, value);
+            }
+            emitted_.fetch_add(1, std::memory_order_relaxed);
+            if (calls > 0) {
+                calls_.fetch_add(calls, std::memory_order_relaxed);
+            }
+            reap();
+            return has_loop_receivers;
+        }
+
+        /// A timed receiver; javascript ones still need to be described
+        struct Timed {
+            ListenerProfile profile;
+            std::shared_ptr<Receiver> receiver;
+        };
+
+        /// @param[in] name - the event name (or pattern) this list is for
+        /// @param[out] timed - where to add the receivers which have been timed
+        void timed(const std::string& name, std::vector<Timed>& timed) const {
             shared_lock<uv_rwlock> guard{receivers_list_lock_};
+            for (auto& receiver : native_loop_list_) {
+                Timed t{{name, "[native]", "", 0, 0, 0, 0, 0}, nullptr};
+                receiver->timing(t.profile);
+                if (t.profile.calls > 0) {
+                    timed.push_back(t);
+                }
+            }
             for (auto& receiver : receivers_list_) {
-                receiver->notify(value);
+                Timed t{{name, "", "", 0, 0, 0, 0, 0}, receiver};
+                receiver->timing(t.profile);
+                if (t.profile.calls > 0) {
+                    timed.push_back(t);
+                }
+            }
+        }
+
+        /// @param[in] name - the event name (or pattern) this list is for
+        ///
+        /// @returns a snapshot of the counters for this list
+        EventStats stats(const std::string& name) const {
+            return {name,
+                    emitted_.load(std::memory_order_relaxed),
+                    dispatched_.load(std::memory_order_relaxed),
+                    calls_.load(std::memory_order_relaxed),
+                    queue_wait_.summary(),
+                    listener_.summary()};
+        }
+
+        void resetStats() {
+            emitted_.store(0, std::memory_order_relaxed);
+            dispatched_.store(0, std::memory_order_relaxed);
+            calls_.store(0, std::memory_order_relaxed);
+            queue_wait_.reset();
+            listener_.reset();
+
+            shared_lock<uv_rwlock> guard{receivers_list_lock_};
+            for (auto& receiver : native_loop_list_) {
+                receiver->resetTiming();
+            }
+            for (auto& receiver : receivers_list_) {
+                receiver->resetTiming();
             }
         }
 
      private:
-        std::vector<std::shared_ptr<Receiver>> receivers_list_;
+        /// Marks the list being dispatched on this thread for the lifetime of the scope. Dispatches nest (a listener
+        /// may emit another event), so each one links to the dispatch it is nested in.
+        class Dispatching {
+         public:
+            explicit Dispatching(const ReceiverList* list) : list_(list), outer_(innermost()) { innermost() = this; }
+            ~Dispatching() { innermost() = outer_; }
+
+            /// @returns true if the list is being dispatched on this thread, whether or not it is the innermost
+            static bool active(const ReceiverList* list) {
+                for (auto scope = innermost(); scope; scope = scope->outer_) {
+                    if (scope->list_ == list) {
+                        return true;
+                    }
+                }
+                return false;
+            }
+
+         private:
+            /// @returns the innermost dispatch on this thread, if any
+            static const Dispatching*& innermost() {
+                static thread_local const Dispatching* scope = nullptr;
+                return scope;
+            }
+
+            const ReceiverList* list_;
+            const Dispatching* outer_;
+        };
+
+        /// evaluate the (stateless parts of the) filters for a list, so that values no receiver on the loop thread
+        /// wants are never queued
+        template <class R>
+        static bool mayAccept(const SlotMap<std::shared_ptr<R>>& list, const char* value) {
+            for (auto& receiver : list) {
+                if (receiver->mayAccept(value)) {
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        /// the bit of state_ set once the list has been pruned; the rest is the number of receivers
+        static constexpr uint64_t pruned = uint64_t(1) << 63;
+
+        /// count a receiver about to be added
+        ///
+        /// @returns false if the list has been pruned
+        bool reserve() {
+            uint64_t state = state_.load(std::memory_order_acquire);
+            do {
+                if ((state & pruned) != 0) {
+                    return false;
+                }
+            } while (!state_.compare_exchange_weak(state, state + 1, std::memory_order_acq_rel));
+            return true;
+        }
+
+        /// Inserts a receiver added to the list, and replays the retained events to it. If the list is being dispatched
+        /// on this thread, the lock is already held shared, so the receiver is kept aside and inserted once the
+        /// dispatch has finished: it isn't notified of the events dispatched until then, but has the event being
+        /// dispatched replayed if it is retained.
+        ///
+        /// @param[in] list - the list to insert the receiver into
+        /// @param[in] receiver - the receiver
+        /// @param[in] lane - which list it is
+        /// @param[out] deferred - the receiver, if it is kept aside
+        ///
+        /// @returns the key of the receiver, or deferred_key if it is kept aside
+        template <class R>
+        uint64_t insert(SlotMap<std::shared_ptr<R>>& list, std::shared_ptr<R> receiver, Lane lane,
+                        DeferredReceiver& deferred) {
+            uint64_t key;
+            std::vector<RetainedEvent> kept;
+            if (Dispatching::active(this)) {
+                key = deferred_key;
+                deferred = receiver;
+                {
+                    std::lock_guard<std::mutex> guard{spent_lock_};
+                    added_.emplace_back(receiver, lane);
+                }
+                kept = retained();
+            } else {
+                std::lock_guard<uv_rwlock> guard{receivers_list_lock_};
+                key = list.insert(receiver);
+                kept = retained();
+            }
+            replay(*receiver, key, lane, kept);
+            return key;
+        }
+
+        /// @param[in] receiver - a receiver in the list
+        /// @param[in] lane - which list it is in
+        ///
+        /// @returns its key, or null_key if it isn't in the list; must be called with the lock held
+        uint64_t keyOf(const BasicReceiver* receiver, Lane lane) {
+            return lane == Lane::Javascript ? keyOf(receivers_list_, receiver) : keyOf(natives(lane), receiver);
+        }
+
+        template <class R>
+        static uint64_t keyOf(const SlotMap<std::shared_ptr<R>>& list, const BasicReceiver* receiver) {
+            for (size_t i = 0; i < list.size(); ++i) {
+                if ((list.begin() + i)->get() == receiver) {
+                    return list.key_at(i);
+                }
+            }
+            return SlotMap<int>::null_key;
+        }
+
+        /// remember a receiver to remove once the current emit has released the lock
+        void defer(uint64_t key, Lane lane) {
+            std::lock_guard<std::mutex> guard{spent_lock_};
+            spent_.emplace_back(key, lane);
+        }
+
+        /// mark every receiver of a list removed, and remember to remove them once the current emit has released the
+        /// lock
+        template <class R>
+        void deferAll(const SlotMap<std::shared_ptr<R>>& list, Lane lane) {
+            for (size_t i = 0; i < list.size(); ++i) {
+                (*(list.begin() + i))->remove();
+                defer(list.key_at(i), lane);
+            }
+        }
+
+        /// keep an event, dropping the oldest kept if there are already as many as are retained
+        void record(const std::string& ev, const std::string& value) {
+            std::lock_guard<std::mutex> guard{retained_lock_};
+            size_t n = retain_.load(std::memory_order_relaxed);
+            if (n == 0) {
+                return;
+            }
+            if (retained_.size() >= n) {
+                retained_.pop_front();
+            }
+            retained_.emplace_back(ev, value);
+        }
+
+        /// notify a receiver just added of the events kept when it was added, oldest first, as if they were being
+        /// dispatched. This happens outside the lock, so the receiver may add and remove listeners as usual; a
+        /// receiver on the loop thread, added on the loop thread, receives the kept events and then the events
+        /// dispatched after them, in order.
+        ///
+        /// @param[in] receiver - the receiver added
+        /// @param[in] key - its key
+        /// @param[in] lane - the list it was added to
+        /// @param[in] kept - the events kept when it was added
+        template <class R>
+        void replay(R& receiver, uint64_t key, Lane lane, const std::vector<RetainedEvent>& kept) {
+            for (auto& event : kept) {
+                if (receiver.accept(event.second.c_str()) && receiver.claim()) {
+                    notify(receiver, event.first, event.second);
+                    if (receiver.once()) {
+                        // a receiver kept aside is claimed, so it is never inserted
+                        if (key != deferred_key) {
+                            erase(key, lane);
+                        }
+                        break;
+                    }
+                }
+            }
+        }
+
+        void notify(const Receiver& receiver, const std::string& ev, const std::string& value) const {
+            receiver.notify(ev, value, with_event_name_);
+        }
+
+        void notify(const NativeReceiver& receiver, const std::string& ev, const std::string& value) const {
+            receiver.notify(ev.c_str(), value.c_str());
+        }
+
+        /// insert the receivers kept aside, and remove all the receivers that were deferred, once the list is no
+        /// longer being dispatched on this thread (an emit this one is nested in reaps once it has released the lock)
+        void reap() {
+            if (Dispatching::active(this)) {
+                return;
+            }
+            {
+                std::lock_guard<std::mutex> guard{spent_lock_};
+                if (added_.empty() && spent_.empty()) {
+                    return;
+                }
+            }
+
+            std::lock_guard<uv_rwlock> guard{receivers_list_lock_};
+            std::vector<std::pair<std::shared_ptr<BasicReceiver>, Lane>> added;
+            std::vector<std::pair<uint64_t, Lane>> spent;
+            {
+                // taken under the lock, so erasing a receiver finds it either aside or inserted
+                std::lock_guard<std::mutex> guard{spent_lock_};
+                added.swap(added_);
+                spent.swap(spent_);
+            }
+            for (auto& a : added) {
+                if (a.first->removed()) {
+                    state_.fetch_sub(1, std::memory_order_acq_rel);
+                } else if (a.second == Lane::Javascript) {
+                    receivers_list_.insert(std::static_pointer_cast<Receiver>(a.first));
+                } else {
+                    natives(a.second).insert(std::static_pointer_cast<NativeReceiver>(a.first));
+                }
+            }
+            for (auto& s : spent) {
+                unlocked_erase(s.first, s.second);
+            }
+        }
+
+        SlotMap<std::shared_ptr<NativeReceiver>>& natives(Lane lane) {
+            return lane == Lane::NativeInline ? native_inline_list_ : native_loop_list_;
+        }
+
+        BasicReceiver* find(uint64_t key, Lane lane) {
+            if (lane == Lane::Javascript) {
+                auto r = receivers_list_.find(key);
+                return r ? r->get() : nullptr;
+            }
+            auto r = natives(lane).find(key);
+            return r ? r->get() : nullptr;
+        }
+
+        bool unlocked_erase(uint64_t key, Lane lane) {
+            bool erased = lane == Lane::Javascript ? receivers_list_.erase(key) : natives(lane).erase(key);
+            if (erased) {
+                state_.fetch_sub(1, std::memory_order_acq_rel);
+            }
+            return erased;
+        }
+
+        const std::string name_;
+        bool with_event_name_;
+        uint64_t registered_;
+        // the number of receivers, and whether the list has been pruned (see prune)
+        std::atomic<uint64_t> state_;
+        SlotMap<std::shared_ptr<Receiver>> receivers_list_;
+        SlotMap<std::shared_ptr<NativeReceiver>> native_loop_list_;
+        SlotMap<std::shared_ptr<NativeReceiver>> native_inline_list_;
         mutable uv_rwlock receivers_list_lock_;
+        std::vector<std::pair<uint64_t, Lane>> spent_;
+        // receivers added while the list was being dispatched, to insert once it has been (see insert)
+        std::vector<std::pair<std::shared_ptr<BasicReceiver>, Lane>> added_;
+        std::mutex spent_lock_;
+        std::atomic<uint64_t> emitted_;
+        std::atomic<uint64_t> dispatched_;
+        std::atomic<uint64_t> calls_;
+        LatencyHistogram queue_wait_;
+        LatencyHistogram listener_;
+        std::atomic<size_t> retain_;
+        std::deque<RetainedEvent> retained_;
+        mutable std::mutex retained_lock_;
+        std::atomic<size_t> drop_unheard_;
+    };
+
+    /// The ReceiverLists an event is dispatched to
+    typedef std::vector<std::shared_ptr<ReceiverList>> ResolvedLists;
+
+    /// Upper bound on the number of event names whose resolution is cached
+    static constexpr size_t max_resolved = 4096;
+
+    /// @param[in] lists_drop - whether the event has lists, and every one of them drops unheard events
+    ///
+    /// @returns true if an event with no receivers on the loop thread is dropped as it is emitted
+    bool dropping(bool lists_drop) const { return lists_drop || drop_unheard_.load(std::memory_order_relaxed); }
+
+    /// Find the ReceiverList for an event (or pattern), creating it if it doesn't exist yet
+    ///
+    /// @param[in] ev - event name
+    std::shared_ptr<ReceiverList> listFor(const std::string& ev) {
+        std::unique_lock<uv_rwlock> master_lock{receivers_lock_};
+        return unlocked_listFor(ev);
+    }
+
+    /// listFor, with receivers_lock_ already held exclusively
+    std::shared_ptr<ReceiverList> unlocked_listFor(const std::string& ev) {
+        auto list = receivers_.find(ev);
+
+        if (!list) {
+            bool is_pattern = EventPattern::isPattern(ev);
+            list = receivers_.emplace(ev, std::make_shared<ReceiverList>(ev, is_pattern, ++registered_)).first;
+            if (is_pattern) {
+                patterns_.emplace_back(EventPattern{ev}, *list);
+            }
+            unresolve(ev);
+        }
+        return *list;
+    }
+
+    /// Add a receiver to the list for an event (or pattern). The receiver is added outside receivers_lock_, as
+    /// adding it replays the retained events to it, so the list may be pruned in the meantime; it is then added to
+    /// the new list for the name instead.
+    ///
+    /// @param[in] ev - event name
+    /// @param[in] lane - the list the receiver is added to
+    /// @param[in] add - adds the receiver to a ReceiverList, returning its key (or null_key if the list was pruned),
+    ///                  and setting its second argument to the receiver if its insertion was deferred
+    template <class Add>
+    ListenerHandle addTo(const std::string& ev, Lane lane, Add add) {
+        for (;;) {
+            auto list = listFor(ev);
+            DeferredReceiver deferred;
+            uint64_t key = add(*list, deferred);
+            if (key != SlotMap<int>::null_key) {
+                // a once receiver may already have been satisfied by the retained events
+                prune(*list);
+                return {list, key, lane, deferred};
+            }
+        }
+    }
+
+    /// Forget a list once its last receiver has been removed, unless its settings outlive its receivers. Must be
+    /// called without receivers_lock_ held (such as once a list has been dispatched); cheap unless the list is pruned.
+    ///
+    /// @param[in] list - the list
+    void prune(ReceiverList& list) const {
+        if (!list.unused() || list.persistent()) {
+            return;
+        }
+        std::unique_lock<uv_rwlock> master_lock{receivers_lock_};
+        auto found = receivers_.find(list.name());
+        if (found && found->get() == &list) {
+            unlocked_prune(*found);
+        }
+    }
+
+    /// prune, with receivers_lock_ already held exclusively
+    void unlocked_prune(const std::shared_ptr<ReceiverList>& list) const {
+        // settings only change under receivers_lock_, so they can't change before the list is pruned
+        if (!list->persistent() && list->prune()) {
+            forget(list);
+        }
+    }
+
+    /// Remove a list from the emitter; must be called with receivers_lock_ held exclusively
+    ///
+    /// @param[in] list - the list
+    void forget(std::shared_ptr<ReceiverList> list) const {
+        list->forget();
+        for (auto p = patterns_.begin(); p != patterns_.end(); ++p) {
+            if (p->second == list) {
+                patterns_.erase(p);
+                break;
+            }
+        }
+        receivers_.erase(list->name());
+        unresolve(list->name());
+    }
+
+    /// Invoke fn on each ReceiverList an event is dispatched to. Without any patterns, that's just the list for the
+    /// event name. Otherwise the lists of the matching patterns are resolved once per event name and cached, so that
+    /// dispatch is still a single lookup. The lookup is by the name's hash, which the caller has already worked out
+    ///
+    /// @param[in] ev - event name
+    /// @param[in] hash - StringHash::of(ev)
+    /// @param[in] fn - invoked with each ReceiverList
+    ///
+    /// @returns false if there were no lists for the event
+    template <class Fn>
+    bool forEachList(const char* ev, uint64_t hash, Fn fn) const {
+        shared_lock<uv_rwlock> master_lock{receivers_lock_};
+        if (patterns_.empty()) {
+            auto found = receivers_.find(ev, hash);
+            if (!found) {
+                return false;
+            }
+            auto list = *found;
+            master_lock.unlock();
+
+            fn(*list);
+            return true;
+        }
+
+        std::shared_ptr<const ResolvedLists> lists;
+        auto cached = resolved_.find(ev, hash);
+        if (cached) {
+            lists = *cached;
+            master_lock.unlock();
+        } else {
+            master_lock.unlock();
+            lists = resolve(ev, hash);
+        }
+
+        for (auto& list : *lists) {
+            fn(*list);
+        }
+        return !lists->empty();
+    }
+
+    /// Resolve (and cache) the ReceiverLists for an event name
+    ///
+    /// @param[in] ev - event name
+    /// @param[in] hash - StringHash::of(ev)
+    std::shared_ptr<const ResolvedLists> resolve(const char* ev, uint64_t hash) const {
+        std::unique_lock<uv_rwlock> master_lock{receivers_lock_};
+        auto cached = resolved_.find(ev, hash);
+        if (cached) {
+            return *cached;
+        }
+
+        std::string name{ev};
+        auto lists = lookup(name);
+        if (resolved_.size() >= max_resolved) {
+            resolved_.clear();
+        }
+        resolved_.emplace(name, hash, lists);
+        return lists;
+    }
+
+    /// Resolve the ReceiverLists for a pinned event, unless they still are
+    ///
+    /// @param[in] pinned - the number of the event
+    /// @param[out] ev - the name of the event, which lives as long as the emitter
+    std::shared_ptr<const ResolvedLists> resolvePinned(size_t pinned, const std::string*& ev) const {
+        {
+            shared_lock<uv_rwlock> master_lock{receivers_lock_};
+            auto& p = pinned_[pinned];
+            ev = &p.name;
+            if (p.lists) {
+                return p.lists;
+            }
+        }
+
+        std::unique_lock<uv_rwlock> master_lock{receivers_lock_};
+        auto& p = pinned_[pinned];
+        if (!p.lists) {
+            p.lists = lookup(p.name);
+        }
+        return p.lists;
+    }
+
+    /// Find the ReceiverLists an event is dispatched to; must be called with receivers_lock_ held
+    ///
+    /// @param[in] ev - event name
+    std::shared_ptr<const ResolvedLists> lookup(const std::string& ev) const {
+        auto lists = std::make_shared<ResolvedLists>();
+        auto list = receivers_.find(ev);
+        if (list && !EventPattern::isPattern(ev)) {
+            lists->push_back(*list);
+        }
+        for (auto& p : patterns_) {
+            if (p.first.matches(ev)) {
+                lists->push_back(p.second);
+            }
+        }
+        return lists;
+    }
+
+    /// Forget the resolutions which the list for a name (or pattern) being added or removed has changed: those of the
+    /// name itself, or of every name the pattern matches. Must be called with receivers_lock_ held exclusively.
+    ///
+    /// @param[in] ev - event name or pattern
+    void unresolve(const std::string& ev) const {
+        if (!EventPattern::isPattern(ev)) {
+            resolved_.erase(ev);
+            for (auto& p : pinned_) {
+                if (p.name == ev) {
+                    p.lists.reset();
+                }
+            }
+            return;
+        }
+        resolved_.clear();
+        EventPattern pattern{ev};
+        for (auto& p : pinned_) {
+            if (pattern.matches(p.name)) {
+                p.lists.reset();
+            }
+        }
+    }
+
+    /// A pinned event name, and its lists while they are resolved
+    struct Pinned {
+        std::string name;
+        std::shared_ptr<const ResolvedLists> lists;
     };
 
     mutable uv_rwlock receivers_lock_;
-    std::unordered_map<std::string, std::shared_ptr<ReceiverList>> receivers_;
+    // mutable, as a list is pruned once it has been dispatched and its last receiver has gone (see prune)
+    mutable FlatStringMap<std::shared_ptr<ReceiverList>> receivers_;
+    // counts the ReceiverLists created, to order them by
+    uint64_t registered_;
+    mutable std::vector<std::pair<EventPattern, std::shared_ptr<ReceiverList>>> patterns_;
+    mutable FlatStringMap<std::shared_ptr<const ResolvedLists>> resolved_;
+    // a deque, so that the names stay put as events are pinned
+    mutable std::deque<Pinned> pinned_;
+    std::shared_ptr<QueueStats> queue_stats_;
+    std::atomic<bool> profiling_;
+    std::atomic<bool> capturing_;
+    std::shared_ptr<EventLog::Writer> capture_;
+    std::atomic<uint64_t> cancellations_;
+    std::atomic<bool> drop_unheard_;
 };
 
 }  // namespace NodeEvent
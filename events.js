@@ -0,0 +1,72 @@
+'use strict'
+
+/**
+ * Consume an event with an async iterator, pulling batches out of a native EventStream (see event_stream.hpp), rather
+ * than having a listener called for every event:
+ *
+ *     for await (let value of events(thing, 'progress', { highWaterMark: 256 })) {
+ *         ...
+ *     }
+ *
+ * The binding must provide stream(name, highWaterMark), returning an object with pull(max, callback) and close().
+ * pull calls back with an array of values as soon as there is at least one, or with an empty array once the stream is
+ * closed. Breaking out of the loop (or calling return()) closes the stream.
+ *
+ * @param {Object} emitter - the binding to stream from
+ * @param {string} name - the event name (or pattern)
+ * @param {Object} [options] - options
+ * @param {number} [options.highWaterMark=1024] - the most events buffered before producers paced by the stream's
+ *     credits are held up; also the most pulled at once
+ * @returns {Object} an async iterator of the event's values
+ */
+function events(emitter, name, options) {
+    let highWaterMark = (options && options.highWaterMark) || 1024
+    let stream = emitter.stream(name, highWaterMark)
+    let batch = []
+    let next = 0
+    let closed = false
+    // next() may be called again before the last call has resolved; the calls are chained, to keep the values in order
+    let last = Promise.resolve()
+
+    function take() {
+        if (next < batch.length) {
+            return Promise.resolve({ value: batch[next++], done: false })
+        }
+        if (closed) {
+            return Promise.resolve({ value: undefined, done: true })
+        }
+        return new Promise(function(resolve) {
+            stream.pull(highWaterMark, resolve)
+        }).then(function(values) {
+            if (values.length === 0) {
+                closed = true
+            }
+            batch = values
+            next = 0
+            return take()
+        })
+    }
+
+    let iterator = {
+        next: function() {
+            last = last.then(take)
+            return last
+        },
+        return: function(value) {
+            if (!closed) {
+                closed = true
+                batch = []
+                stream.close()
+            }
+            return Promise.resolve({ value: value, done: true })
+        }
+    }
+    if (typeof Symbol.asyncIterator === 'symbol') {
+        iterator[Symbol.asyncIterator] = function() {
+            return iterator
+        }
+    }
+    return iterator
+}
+
+module.exports = events
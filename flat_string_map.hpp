@@ -0,0 +1,230 @@
+/*
+ * Copyright 2017 Scoop Technologies
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE
+ * WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+ * OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#pragma once
+#ifndef _NODE_EVENT_FLAT_STRING_MAP_H
+#define _NODE_EVENT_FLAT_STRING_MAP_H
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace NodeEvent {
+/// StringHash is the hash FlatStringMap keys are found by: FNV-1a, with a final mix so that the low bits (which pick
+/// the slot) depend on every bit of the string. It is never 0.
+struct StringHash {
+    /// @param[in] s - a NUL terminated string
+    static uint64_t of(const char* s) {
+        uint64_t h = 0xcbf29ce484222325ULL;
+        for (; *s; ++s) {
+            h = (h ^ static_cast<unsigned char>(*s)) * 0x100000001b3ULL;
+        }
+        h ^= h >> 33;
+        h *= 0xff51afd7ed558ccdULL;
+        h ^= h >> 33;
+        return h == 0 ? 1 : h;
+    }
+
+    static uint64_t of(const std::string& s) { return of(s.c_str()); }
+};
+
+/// FlatStringMap maps strings to values in a single array, with open addressing and linear probing, so that a lookup
+/// is one hashed index and (usually) one string comparison in the same cache line, rather than a walk through
+/// separately allocated nodes. Keys can be looked up as C strings with a hash worked out beforehand (see StringHash),
+/// so a caller holding one needn't build a std::string or hash it again.
+///
+/// Erasing shifts the following entries of the probe sequence back, rather than leaving tombstones, so lookups never
+/// slow down as entries come and go. Inserting and erasing invalidate pointers to values and iterators.
+template <class V>
+class FlatStringMap {
+    struct Slot {
+        Slot() : hash(0), entry() {}
+
+        /// 0 for an empty slot
+        uint64_t hash;
+        std::pair<std::string, V> entry;
+    };
+
+ public:
+    typedef std::pair<std::string, V> value_type;
+
+    /// Iterates over the entries, in no particular order
+    class const_iterator {
+     public:
+        const value_type& operator*() const { return slot_->entry; }
+        const value_type* operator->() const { return &slot_->entry; }
+        const_iterator& operator++() {
+            ++slot_;
+            skip();
+            return *this;
+        }
+        bool operator==(const const_iterator& other) const { return slot_ == other.slot_; }
+        bool operator!=(const const_iterator& other) const { return slot_ != other.slot_; }
+
+     private:
+        friend class FlatStringMap;
+        const_iterator(const Slot* slot, const Slot* end) : slot_(slot), end_(end) { skip(); }
+
+        void skip() {
+            while (slot_ != end_ && slot_->hash == 0) {
+                ++slot_;
+            }
+        }
+
+        const Slot* slot_;
+        const Slot* end_;
+    };
+
+    FlatStringMap() : slots_(), size_(0) {}
+
+    /// @param[in] key - NUL terminated key
+    /// @param[in] hash - StringHash::of(key)
+    ///
+    /// @returns the value for the key, or nullptr if there isn't one
+    V* find(const char* key, uint64_t hash) {
+        size_t i = locate(key, hash);
+        return i == npos ? nullptr : &slots_[i].entry.second;
+    }
+
+    const V* find(const char* key, uint64_t hash) const {
+        size_t i = locate(key, hash);
+        return i == npos ? nullptr : &slots_[i].entry.second;
+    }
+
+    V* find(const std::string& key) { return find(key.c_str(), StringHash::of(key)); }
+
+    const V* find(const std::string& key) const { return find(key.c_str(), StringHash::of(key)); }
+
+    /// Add a value for a key, unless the key already has one
+    ///
+    /// @param[in] key - the key
+    /// @param[in] hash - StringHash::of(key)
+    /// @param[in] value - the value to add
+    ///
+    /// @returns the value for the key, and whether it was added
+    std::pair<V*, bool> emplace(const std::string& key, uint64_t hash, V value) {
+        size_t i = locate(key.c_str(), hash);
+        if (i != npos) {
+            return {&slots_[i].entry.second, false};
+        }
+        if ((size_ + 1) * 4 > slots_.size() * 3) {
+            grow();
+        }
+        i = hash & (slots_.size() - 1);
+        while (slots_[i].hash != 0) {
+            i = (i + 1) & (slots_.size() - 1);
+        }
+        slots_[i].hash = hash;
+        slots_[i].entry = value_type(key, std::move(value));
+        ++size_;
+        return {&slots_[i].entry.second, true};
+    }
+
+    std::pair<V*, bool> emplace(const std::string& key, V value) {
+        return emplace(key, StringHash::of(key), std::move(value));
+    }
+
+    /// Remove the value for a key
+    ///
+    /// @param[in] key - the key
+    ///
+    /// @returns true if the key had a value
+    bool erase(const std::string& key) {
+        size_t i = locate(key.c_str(), StringHash::of(key));
+        if (i == npos) {
+            return false;
+        }
+
+        // shift back each following entry of the run which would still be found from the hole, so the run stays
+        // unbroken
+        size_t mask = slots_.size() - 1;
+        for (size_t j = (i + 1) & mask; slots_[j].hash != 0; j = (j + 1) & mask) {
+            size_t home = slots_[j].hash & mask;
+            bool movable = i < j ? (home <= i || home > j) : (home <= i && home > j);
+            if (movable) {
+                slots_[i] = std::move(slots_[j]);
+                i = j;
+            }
+        }
+        slots_[i].hash = 0;
+        slots_[i].entry = value_type();
+        --size_;
+        return true;
+    }
+
+    /// Remove every value, keeping the slots
+    void clear() {
+        for (auto& slot : slots_) {
+            if (slot.hash != 0) {
+                slot.hash = 0;
+                slot.entry = value_type();
+            }
+        }
+        size_ = 0;
+    }
+
+    size_t size() const { return size_; }
+
+    bool empty() const { return size_ == 0; }
+
+    const_iterator begin() const { return {slots_.data(), slots_.data() + slots_.size()}; }
+
+    const_iterator end() const { return {slots_.data() + slots_.size(), slots_.data() + slots_.size()}; }
+
+ private:
+    static constexpr size_t npos = static_cast<size_t>(-1);
+    static constexpr size_t min_slots = 16;
+
+    /// @returns the slot of a key, or npos
+    size_t locate(const char* key, uint64_t hash) const {
+        if (size_ == 0) {
+            return npos;
+        }
+        size_t mask = slots_.size() - 1;
+        for (size_t i = hash & mask; slots_[i].hash != 0; i = (i + 1) & mask) {
+            if (slots_[i].hash == hash && std::strcmp(slots_[i].entry.first.c_str(), key) == 0) {
+                return i;
+            }
+        }
+        return npos;
+    }
+
+    /// double the slots (keeping the load at most three quarters), and put each entry back in its new place
+    void grow() {
+        std::vector<Slot> old;
+        old.swap(slots_);
+        slots_.resize(old.empty() ? min_slots : old.size() * 2);
+        size_t mask = slots_.size() - 1;
+        for (auto& slot : old) {
+            if (slot.hash != 0) {
+                size_t i = slot.hash & mask;
+                while (slots_[i].hash != 0) {
+                    i = (i + 1) & mask;
+                }
+                slots_[i] = std::move(slot);
+            }
+        }
+    }
+
+    std::vector<Slot> slots_;
+    size_t size_;
+};
+
+}  // namespace NodeEvent
+
+#endif
@@ -0,0 +1,166 @@
+/*
+ * Copyright 2017 Scoop Technologies
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE
+ * WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+ * OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#pragma once
+#ifndef _NODE_EVENT_FLOW_CREDITS_H
+#define _NODE_EVENT_FLOW_CREDITS_H
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+
+namespace NodeEvent {
+/// FlowCredits paces producers to their consumer: a producer takes a credit for every report it queues, and the
+/// consumer grants credits back as it handles them (or as it is ready for more). Once the credits run out, producers
+/// either park until more are granted, or are told they are throttled, instead of overrunning the queue.
+///
+/// Taking and granting a credit is a single atomic operation while there are credits; the mutex is only touched to
+/// park, and to wake parked producers.
+class FlowCredits {
+ public:
+    /// @param[in] initial - the credits available to start with, i.e. how far producers may run ahead
+    /// @param[in] park - whether acquire() waits for credits, rather than failing, once they run out
+    explicit FlowCredits(int64_t initial, bool park = true)
+        : credits_(initial), park_(park), closed_(false), parked_(0), throttled_(0), lock_(), granted_() {}
+
+    FlowCredits(const FlowCredits& other) = delete;
+    FlowCredits& operator=(const FlowCredits& other) = delete;
+
+    /// Take a credit, parking until one is granted if there are none (and parking is enabled). Once closed, always
+    /// succeeds.
+    ///
+    /// @returns true if a credit was taken, false if there were none and parking is disabled
+    bool acquire() {
+        return acquire([]() { return false; });
+    }
+
+    /// Take a credit, parking until one is granted or stop returns true
+    ///
+    /// @param[in] stop - returns true to give up waiting; checked before parking, and whenever parked producers are
+    ///                   woken (see wake())
+    ///
+    /// @returns true if a credit was taken, false if there were none and parking is disabled, or it was stopped
+    template <class Stop>
+    bool acquire(Stop stop) {
+        return acquire(stop, std::chrono::nanoseconds::max());
+    }
+
+    /// Take a credit, parking until one is granted, stop returns true or the timeout passes
+    ///
+    /// @param[in] stop - returns true to give up waiting (see acquire(stop))
+    /// @param[in] timeout - the longest to park; std::chrono::nanoseconds::max() waits for as long as it takes
+    ///
+    /// @returns true if a credit was taken, false if there were none and parking is disabled, or it was stopped, or
+    ///          there were still none at the timeout
+    template <class Stop>
+    bool acquire(Stop stop, std::chrono::nanoseconds timeout) {
+        if (tryAcquire()) {
+            return true;
+        }
+        throttled_.fetch_add(1, std::memory_order_relaxed);
+        if (!park_) {
+            return false;
+        }
+
+        bool forever = timeout == std::chrono::nanoseconds::max();
+        auto deadline = std::chrono::steady_clock::now() + (forever ? std::chrono::nanoseconds::zero() : timeout);
+        std::unique_lock<std::mutex> guard{lock_};
+        parked_.fetch_add(1, std::memory_order_seq_cst);
+        // granting bumps the credits before checking for parked producers, so one of the two sees the other
+        bool acquired;
+        while (!(acquired = tryAcquire()) && !stop()) {
+            if (forever) {
+                granted_.wait(guard);
+            } else if (granted_.wait_until(guard, deadline) == std::cv_status::timeout) {
+                acquired = tryAcquire();
+                break;
+            }
+        }
+        parked_.fetch_sub(1, std::memory_order_relaxed);
+        return acquired;
+    }
+
+    /// Take a credit, if there is one (or the credits are closed)
+    ///
+    /// @returns true if a credit was taken
+    bool tryAcquire() {
+        // seq_cst, to pair with grant() when parking
+        int64_t credits = credits_.load(std::memory_order_seq_cst);
+        do {
+            if (credits <= 0) {
+                return closed_.load(std::memory_order_acquire);
+            }
+        } while (!credits_.compare_exchange_weak(credits, credits - 1, std::memory_order_acquire,
+                                                 std::memory_order_relaxed));
+        return true;
+    }
+
+    /// Take credits whether or not there are any, going into debt if need be; for reports which mustn't wait (e.g.
+    /// aggregate summaries) but which will still be granted back
+    ///
+    /// @param[in] n - credits to take
+    void consume(int64_t n = 1) { credits_.fetch_sub(n, std::memory_order_relaxed); }
+
+    /// Grant credits, waking producers parked for them. Safe to call from any thread.
+    ///
+    /// @param[in] n - credits to grant
+    void grant(int64_t n = 1) {
+        credits_.fetch_add(n, std::memory_order_seq_cst);
+        if (parked_.load(std::memory_order_seq_cst) > 0) {
+            std::lock_guard<std::mutex> guard{lock_};
+            if (n == 1) {
+                granted_.notify_one();
+            } else {
+                granted_.notify_all();
+            }
+        }
+    }
+
+    /// Stop regulating: every acquire succeeds from now on, and parked producers resume (e.g. as the consumer goes
+    /// away, so producers don't wait forever)
+    void close() {
+        closed_.store(true, std::memory_order_release);
+        std::lock_guard<std::mutex> guard{lock_};
+        granted_.notify_all();
+    }
+
+    /// Wake parked producers to check whether they should stop waiting, without granting anything
+    void wake() {
+        std::lock_guard<std::mutex> guard{lock_};
+        granted_.notify_all();
+    }
+
+    /// @returns the credits currently available (negative if in debt)
+    int64_t available() const { return credits_.load(std::memory_order_relaxed); }
+
+    /// @returns how many times a producer found no credits
+    uint64_t throttled() const { return throttled_.load(std::memory_order_relaxed); }
+
+ private:
+    std::atomic<int64_t> credits_;
+    bool park_;
+    std::atomic<bool> closed_;
+    std::atomic<uint32_t> parked_;
+    std::atomic<uint64_t> throttled_;
+    std::mutex lock_;
+    std::condition_variable granted_;
+};
+
+}  // namespace NodeEvent
+
+#endif
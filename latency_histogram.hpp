@@ -0,0 +1,162 @@
+/*
+ * Copyright 2017 Scoop Technologies
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE
+ * WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+ * OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#pragma once
+#ifndef _NODE_EVENT_LATENCY_HISTOGRAM_H
+#define _NODE_EVENT_LATENCY_HISTOGRAM_H
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+namespace NodeEvent {
+/// LatencyHistogram records durations (in nanoseconds) into log-linear buckets, in the style of HdrHistogram: every
+/// power of two is split into 2^sub_bucket_bits linear sub-buckets, so a recorded value is known to within 1/16th of
+/// itself from 1ns up to ~18 minutes, in a fixed 4.6KB of counters. Recording is a single relaxed atomic increment,
+/// so any number of threads may record and read concurrently; reads are only approximately consistent.
+class LatencyHistogram {
+ public:
+    /// The commonly wanted percentiles of a histogram, in nanoseconds
+    struct Summary {
+        uint64_t count;
+        uint64_t p50;
+        uint64_t p99;
+        uint64_t p999;
+        uint64_t max;
+    };
+
+    static constexpr unsigned sub_bucket_bits = 4;
+    static constexpr unsigned value_bits = 40;
+    /// larger values are recorded as max_value
+    static constexpr uint64_t max_value = (uint64_t(1) << value_bits) - 1;
+    static constexpr size_t num_buckets = size_t(value_bits - sub_bucket_bits + 1) << sub_bucket_bits;
+
+    LatencyHistogram() : buckets_(), count_(), max_() { reset(); }
+
+    LatencyHistogram(const LatencyHistogram& other) = delete;
+    LatencyHistogram& operator=(const LatencyHistogram& other) = delete;
+
+    /// @param[in] ns - the duration to record
+    void record(uint64_t ns) {
+        if (ns > max_value) {
+            ns = max_value;
+        }
+        buckets_[bucketFor(ns)].fetch_add(1, std::memory_order_relaxed);
+        count_.fetch_add(1, std::memory_order_relaxed);
+        uint64_t current = max_.load(std::memory_order_relaxed);
+        while (ns > current && !max_.compare_exchange_weak(current, ns, std::memory_order_relaxed)) {
+        }
+    }
+
+    /// @returns the number of recorded values
+    uint64_t count() const { return count_.load(std::memory_order_relaxed); }
+
+    /// @param[in] q - the quantile to find, in [0, 1]
+    ///
+    /// @returns the value at quantile q (the midpoint of its bucket), or 0 if nothing has been recorded
+    uint64_t percentile(double q) const {
+        std::array<uint64_t, num_buckets> counts;
+        uint64_t total = load(counts);
+        return percentile(counts, total, q);
+    }
+
+    /// @returns the p50, p99 and p999 of the recorded values, from one pass over the counters
+    Summary summary() const {
+        std::array<uint64_t, num_buckets> counts;
+        uint64_t total = load(counts);
+        return {total, percentile(counts, total, 0.5), percentile(counts, total, 0.99),
+                percentile(counts, total, 0.999), max_.load(std::memory_order_relaxed)};
+    }
+
+    /// Zero all of the counters
+    void reset() {
+        for (auto& bucket : buckets_) {
+            bucket.store(0, std::memory_order_relaxed);
+        }
+        count_.store(0, std::memory_order_relaxed);
+        max_.store(0, std::memory_order_relaxed);
+    }
+
+    /// @returns the index of the bucket holding value
+    static size_t bucketFor(uint64_t value) {
+        if (value < (uint64_t(1) << sub_bucket_bits)) {
+            return size_t(value);
+        }
+        unsigned shift = msb(value) - sub_bucket_bits;
+        return (size_t(shift + 1) << sub_bucket_bits) + size_t((value >> shift) - (uint64_t(1) << sub_bucket_bits));
+    }
+
+    /// @returns the smallest value held by bucket
+    static uint64_t lowestIn(size_t bucket) {
+        if (bucket < (size_t(1) << sub_bucket_bits)) {
+            return bucket;
+        }
+        unsigned shift = unsigned(bucket >> sub_bucket_bits) - 1;
+        uint64_t mantissa = (bucket & ((size_t(1) << sub_bucket_bits) - 1)) + (uint64_t(1) << sub_bucket_bits);
+        return mantissa << shift;
+    }
+
+    /// @returns the number of values held by bucket
+    static uint64_t widthOf(size_t bucket) {
+        return bucket < (size_t(1) << sub_bucket_bits) ? 1 : uint64_t(1) << ((bucket >> sub_bucket_bits) - 1);
+    }
+
+ private:
+    static unsigned msb(uint64_t value) {
+        unsigned n = 0;
+        while (value >>= 1) {
+            ++n;
+        }
+        return n;
+    }
+
+    uint64_t load(std::array<uint64_t, num_buckets>& counts) const {
+        uint64_t total = 0;
+        for (size_t i = 0; i < num_buckets; ++i) {
+            counts[i] = buckets_[i].load(std::memory_order_relaxed);
+            total += counts[i];
+        }
+        return total;
+    }
+
+    static uint64_t percentile(const std::array<uint64_t, num_buckets>& counts, uint64_t total, double q) {
+        if (total == 0) {
+            return 0;
+        }
+        // the rank of the value we're looking for, rounding up so that p100 is the last value
+        uint64_t rank = uint64_t(q * double(total));
+        if (double(rank) < q * double(total) || rank == 0) {
+            ++rank;
+        }
+        uint64_t seen = 0;
+        for (size_t i = 0; i < num_buckets; ++i) {
+            seen += counts[i];
+            if (seen >= rank) {
+                return lowestIn(i) + (widthOf(i) - 1) / 2;
+            }
+        }
+        return max_value;
+    }
+
+    std::array<std::atomic<uint64_t>, num_buckets> buckets_;
+    std::atomic<uint64_t> count_;
+    std::atomic<uint64_t> max_;
+};
+
+}  // namespace NodeEvent
+
+#endif
@@ -0,0 +1,150 @@
+/*
+ * Copyright 2017 Scoop Technologies
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE
+ * WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+ * OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#pragma once
+#ifndef _NODE_EVENT_LISTENER_FILTER_H
+#define _NODE_EVENT_LISTENER_FILTER_H
+
+#include <atomic>
+#include <cerrno>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <regex>
+#include <string>
+
+namespace NodeEvent {
+/// ListenerFilter is a predicate on event values which is evaluated natively, so that a listener which would discard
+/// most of its events never sees them (and no v8 values are created for them). A default constructed filter accepts
+/// everything. Copies of a filter share their sampling state; a listener given the filter samples with its own (see
+/// instance()).
+class ListenerFilter {
+ public:
+    ListenerFilter() : kind_(Kind::All), prefix_(), regex_(), min_(0), max_(0), every_(0), seen_() {}
+
+    /// Accept values which start with prefix
+    ///
+    /// @param[in] prefix - the prefix to match
+    static ListenerFilter prefix(std::string prefix) {
+        ListenerFilter f{Kind::Prefix};
+        f.prefix_ = std::move(prefix);
+        return f;
+    }
+
+    /// Accept values which contain a match for the ECMAScript regular expression pattern
+    ///
+    /// @param[in] pattern - the regular expression
+    ///
+    /// @throws std::regex_error if the pattern is invalid
+    static ListenerFilter regex(const std::string& pattern) {
+        ListenerFilter f{Kind::Regex};
+        f.regex_ = std::make_shared<const std::regex>(pattern, std::regex::ECMAScript | std::regex::optimize);
+        return f;
+    }
+
+    /// Accept values which are numbers in the closed interval [min, max]
+    ///
+    /// @param[in] min - the smallest number accepted
+    /// @param[in] max - the largest number accepted
+    static ListenerFilter range(double min, double max) {
+        ListenerFilter f{Kind::Range};
+        f.min_ = min;
+        f.max_ = max;
+        return f;
+    }
+
+    /// Accept one value out of every n (the first, then the n+1th, and so on)
+    ///
+    /// @param[in] n - sampling interval; 0 and 1 accept everything
+    static ListenerFilter sample(uint64_t n) {
+        ListenerFilter f{n > 1 ? Kind::Sample : Kind::All};
+        f.every_ = n;
+        f.seen_ = std::make_shared<std::atomic<uint64_t>>(0);
+        return f;
+    }
+
+    /// @returns a copy of the filter with sampling state of its own, so that each listener a filter is given to
+    ///          samples the values it sees independently of the others
+    ListenerFilter instance() const {
+        ListenerFilter f{*this};
+        if (seen_) {
+            f.seen_ = std::make_shared<std::atomic<uint64_t>>(0);
+        }
+        return f;
+    }
+
+    /// Decide whether to deliver a value. Sampling filters count every call, so this must only be called once for
+    /// each event delivered to the listener.
+    ///
+    /// @param[in] value - the event value
+    ///
+    /// @returns true if the listener should receive the value
+    bool accept(const char* value) const {
+        if (kind_ == Kind::Sample) {
+            return seen_->fetch_add(1, std::memory_order_relaxed) % every_ == 0;
+        }
+        return mayAccept(value);
+    }
+
+    /// The same as accept, except that it doesn't change the state of sampling filters (which always might accept)
+    ///
+    /// @param[in] value - the event value
+    ///
+    /// @returns false if accept would definitely reject the value
+    bool mayAccept(const char* value) const {
+        switch (kind_) {
+            case Kind::Prefix:
+                return std::strncmp(value, prefix_.c_str(), prefix_.size()) == 0;
+            case Kind::Regex:
+                return std::regex_search(value, *regex_);
+            case Kind::Range:
+                return inRange(value);
+            default:
+                return true;
+        }
+    }
+
+    /// @returns true if this filter accepts everything
+    bool acceptsAll() const { return kind_ == Kind::All; }
+
+ private:
+    enum class Kind { All, Prefix, Regex, Range, Sample };
+
+    explicit ListenerFilter(Kind kind) : ListenerFilter() { kind_ = kind; }
+
+    bool inRange(const char* value) const {
+        char* end = nullptr;
+        errno = 0;
+        double v = std::strtod(value, &end);
+        if (end == value || *end != '\0' || errno == ERANGE) {
+            return false;
+        }
+        return v >= min_ && v <= max_;
+    }
+
+    Kind kind_;
+    std::string prefix_;
+    std::shared_ptr<const std::regex> regex_;
+    double min_;
+    double max_;
+    uint64_t every_;
+    std::shared_ptr<std::atomic<uint64_t>> seen_;
+};
+
+}  // namespace NodeEvent
+
+#endif
@@ -0,0 +1,58 @@
+/*
+ * Copyright 2017 Scoop Technologies
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE
+ * WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+ * OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#pragma once
+#ifndef _NODE_EVENT_PROBES_H
+#define _NODE_EVENT_PROBES_H
+
+/// Static tracepoints (USDT) at the interesting points of an event's life, under the provider "node_event":
+///
+///   emit(ev, value)                 - a worker emitted an event (before inline listeners and queueing)
+///   suppress(ev)                    - the event was rate limited or sampled out (see EventLimiter)
+///   throttle(ev)                    - the event was refused for want of flow control credits (see FlowCredits)
+///   enqueue(count, depth)           - a report of count events was queued; depth is the queue depth after it
+///   drop(count, depth)              - a report of count events was dropped because the queue was full
+///   overflow(count, enqueued)       - a report didn't fit in the queue, and went to its overflow (see SpillFile)
+///   drain__start(worker)            - the loop thread started draining a worker's queue
+///   dequeue(count, wait_ns)         - a report was taken off the queue, having waited wait_ns
+///   drain__end(worker, drained)     - the drain finished, having handled drained reports
+///   notify(ev, value, lane)         - a listener is about to be called (lane 0: javascript, 1: native on the loop
+///                                     thread, 2: native inline)
+///
+/// The probes compile to nothing unless NODE_EVENT_ENABLE_USDT is defined, which needs <sys/sdt.h> (systemtap-sdt-dev
+/// on debian, systemtap-sdt-devel on redhat). When enabled, an unattached probe is a single nop, so they can be left
+/// in production builds and attached to with e.g.
+///
+///   bpftrace -e 'usdt:./build/Release/addon.node:node_event:emit { @[str(arg0)] = count(); }' -p $PID
+#if defined(NODE_EVENT_ENABLE_USDT)
+#include <sys/sdt.h>
+
+#define NODE_EVENT_PROBE1(name, a) DTRACE_PROBE1(node_event, name, a)
+#define NODE_EVENT_PROBE2(name, a, b) DTRACE_PROBE2(node_event, name, a, b)
+#define NODE_EVENT_PROBE3(name, a, b, c) DTRACE_PROBE3(node_event, name, a, b, c)
+#else
+#define NODE_EVENT_PROBE1(name, a) \
+    do {                           \
+    } while (0)
+#define NODE_EVENT_PROBE2(name, a, b) \
+    do {                              \
+    } while (0)
+#define NODE_EVENT_PROBE3(name, a, b, c) \
+    do {                                 \
+    } while (0)
+#endif
+
+#endif
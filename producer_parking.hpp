@@ -0,0 +1,109 @@
+/*
+ * Copyright 2017 Scoop Technologies
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE
+ * WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+ * OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#pragma once
+#ifndef _NODE_EVENT_PRODUCER_PARKING_H
+#define _NODE_EVENT_PRODUCER_PARKING_H
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+
+namespace NodeEvent {
+/// ProducerParking is where producers wait for room in a full queue, instead of spinning on it: a producer retries for
+/// a short while (the consumer is usually about to catch up), then parks until the consumer frees a slot, or until
+/// its timeout. The consumer wakes only as many parked producers as it freed slots, and while no producer is parked,
+/// freeing a slot costs it one atomic load.
+class ProducerParking {
+ public:
+    /// how many times a producer retries before parking
+    static constexpr unsigned spins = 64;
+
+    ProducerParking() : parked_(0), wakeups_(0), lock_(), freed_() {}
+
+    ProducerParking(const ProducerParking& other) = delete;
+    ProducerParking& operator=(const ProducerParking& other) = delete;
+
+    /// Wait for try_push to succeed
+    ///
+    /// @param[in] try_push - attempts the push; returns true if it succeeded
+    /// @param[in] timeout - the longest to wait; std::chrono::nanoseconds::max() waits for as long as it takes
+    ///
+    /// @returns true if try_push succeeded, false if it was still failing at the timeout
+    template <class TryPush>
+    bool wait(TryPush try_push, std::chrono::nanoseconds timeout) {
+        for (unsigned i = 0; i < spins; ++i) {
+            if (try_push()) {
+                return true;
+            }
+            if (i >= spins / 2) {
+                std::this_thread::yield();
+            }
+        }
+
+        bool forever = timeout == std::chrono::nanoseconds::max();
+        auto deadline = std::chrono::steady_clock::now() + (forever ? std::chrono::nanoseconds::zero() : timeout);
+        std::unique_lock<std::mutex> guard{lock_};
+        // announce first, then retry: a consumer which frees a slot after the retry sees the announcement
+        parked_.fetch_add(1, std::memory_order_seq_cst);
+        bool pushed;
+        while (!(pushed = try_push())) {
+            if (forever) {
+                freed_.wait(guard);
+            } else if (freed_.wait_until(guard, deadline) == std::cv_status::timeout) {
+                pushed = try_push();
+                break;
+            }
+        }
+        parked_.fetch_sub(1, std::memory_order_relaxed);
+        return pushed;
+    }
+
+    /// Wake as many parked producers as there are freed slots
+    ///
+    /// @param[in] freed - number of slots freed
+    void release(size_t freed = 1) {
+        uint32_t parked = parked_.load(std::memory_order_seq_cst);
+        if (parked == 0) {
+            return;
+        }
+        std::lock_guard<std::mutex> guard{lock_};
+        wakeups_.fetch_add(1, std::memory_order_relaxed);
+        if (freed >= parked) {
+            freed_.notify_all();
+            return;
+        }
+        for (size_t i = 0; i < freed; ++i) {
+            freed_.notify_one();
+        }
+    }
+
+    /// @returns how many times the consumer has woken parked producers
+    uint64_t wakeups() const { return wakeups_.load(std::memory_order_relaxed); }
+
+ private:
+    std::atomic<uint32_t> parked_;
+    std::atomic<uint64_t> wakeups_;
+    std::mutex lock_;
+    std::condition_variable freed_;
+};
+
+}  // namespace NodeEvent
+
+#endif
@@ -0,0 +1,321 @@
+/*
+ * Copyright 2017 Scoop Technologies
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE
+ * WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+ * OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#pragma once
+#ifndef _NODE_EVENT_PROGRESS_QUEUE_H
+#define _NODE_EVENT_PROGRESS_QUEUE_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <utility>
+
+#include "probes.hpp"
+#include "producer_parking.hpp"
+#include "queue_stats.hpp"
+#include "shared_ringbuffer.hpp"
+
+namespace NodeEvent {
+/// A progress report as queued
+template <class T>
+struct QueuedReport {
+    const T* data;
+    size_t size;
+    /// when the report was sent
+    uint64_t enqueued;
+};
+
+/// Where a ProgressQueue puts the reports which don't fit in its ring (see SpillFile). Implementations must be safe
+/// to push to from any thread while the loop thread pops.
+template <class T>
+class ProgressOverflow {
+ public:
+    virtual ~ProgressOverflow() = default;
+
+    /// Keep a copy of a report; the caller still owns (and frees) the report
+    ///
+    /// @returns true if the report was kept, false if it couldn't be
+    virtual bool push(const T* data, size_t size, uint64_t enqueued) = 0;
+
+    /// @param[out] report - the oldest report, allocated with new[]
+    ///
+    /// @returns true if there was a report, false otherwise
+    virtual bool pop(QueuedReport<T>& report) = 0;
+
+    /// @returns true if there are no reports kept
+    virtual bool empty() const = 0;
+};
+
+/// MemoryOverflow is a ProgressOverflow which keeps the reports in memory, without bound. Suits reports which are
+/// rare but must not be lost (see AsyncQueuedProgressWorker's priority lane); anything else should spill to disk.
+template <class T>
+class MemoryOverflow : public ProgressOverflow<T> {
+ public:
+    MemoryOverflow() : lock_(), reports_(), size_(0) {}
+
+    virtual ~MemoryOverflow() {
+        for (auto& report : reports_) {
+            delete[] report.data;
+        }
+    }
+
+    virtual bool push(const T* data, size_t size, uint64_t enqueued) override {
+        T* copy = size > 0 ? new T[size] : nullptr;
+        for (size_t i = 0; i < size; ++i) {
+            copy[i] = data[i];
+        }
+        std::lock_guard<std::mutex> guard{lock_};
+        reports_.push_back({copy, size, enqueued});
+        size_.fetch_add(1, std::memory_order_release);
+        return true;
+    }
+
+    virtual bool pop(QueuedReport<T>& report) override {
+        std::lock_guard<std::mutex> guard{lock_};
+        if (reports_.empty()) {
+            return false;
+        }
+        report = reports_.front();
+        reports_.pop_front();
+        size_.fetch_sub(1, std::memory_order_release);
+        return true;
+    }
+
+    virtual bool empty() const override { return size_.load(std::memory_order_acquire) == 0; }
+
+ private:
+    std::mutex lock_;
+    std::deque<QueuedReport<T>> reports_;
+    std::atomic<size_t> size_;
+};
+
+/// ProgressQueue is the queue between the threads sending progress reports and the loop thread handling them: a
+/// RingBuffer of reports stamped with the time they were sent, counted in a QueueStats. The time is supplied by the
+/// caller, so the queue depends on neither uv nor v8, and can be tested and benchmarked on its own.
+///
+/// Given an overflow, reports which don't fit in the ring go to the overflow instead of being dropped. Once anything
+/// has overflowed, every report goes to the overflow until the loop thread has caught up with it, so that reports are
+/// still handled in the order they were sent.
+template <class T, size_t SIZE>
+class ProgressQueue {
+ public:
+    typedef QueuedReport<T> Entry;
+
+    /// @param[in] stats - where to count what happens to the queue; may be shared between queues
+    explicit ProgressQueue(std::shared_ptr<QueueStats> stats)
+        : buffer_(), depth_(0), stats_(std::move(stats)), overflow_(), held_(), holding_(false), parking_() {}
+
+    ProgressQueue(const ProgressQueue& other) = delete;
+    ProgressQueue& operator=(const ProgressQueue& other) = delete;
+
+    /// Enqueue a report, without blocking
+    ///
+    /// @param[in] data - the report
+    /// @param[in] size - size of the report
+    /// @param[in] now - the time the report is sent at, in nanoseconds
+    ///
+    /// @returns true if the report was enqueued, false if the queue was full. A report which went to the overflow
+    ///          has already been freed.
+    bool push(const T* data, size_t size, uint64_t now) {
+        if (overflowing()) {
+            return overflow(data, size, now);
+        }
+        if (pushRing(data, size, now)) {
+            return true;
+        }
+        return full(data, size, now);
+    }
+
+    /// Enqueue a report, waiting for room if the queue is full (see ProducerParking). Reports which would overflow
+    /// don't wait.
+    ///
+    /// @param[in] data - the report
+    /// @param[in] size - size of the report
+    /// @param[in] now - the time the report is sent at, in nanoseconds
+    /// @param[in] timeout - the longest to wait for room; std::chrono::nanoseconds::max() to wait indefinitely
+    ///
+    /// @returns true if the report was enqueued, false if the queue was still full at the timeout
+    bool push_blocking(const T* data, size_t size, uint64_t now, std::chrono::nanoseconds timeout) {
+        return push_blocking(data, size, now, timeout, []() { return false; });
+    }
+
+    /// push_blocking, which can be given up
+    ///
+    /// @param[in] data - the report
+    /// @param[in] size - size of the report
+    /// @param[in] now - the time the report is sent at, in nanoseconds
+    /// @param[in] timeout - the longest to wait for room; std::chrono::nanoseconds::max() to wait indefinitely
+    /// @param[in] stop - returns true to give up waiting; checked whenever a slot is freed, or wake() is called
+    ///
+    /// @returns true if the report was enqueued, false if the queue was still full at the timeout (counted as a
+    ///          drop) or the wait was stopped (not counted)
+    template <class Stop>
+    bool push_blocking(const T* data, size_t size, uint64_t now, std::chrono::nanoseconds timeout, Stop stop) {
+        if (overflowing()) {
+            return overflow(data, size, now);
+        }
+        if (pushRing(data, size, now)) {
+            return true;
+        }
+        if (overflow_) {
+            return full(data, size, now);
+        }
+        bool pushed = false;
+        bool stopped = false;
+        auto done = [this, data, size, now, &pushed, &stopped, &stop]() {
+            return (pushed = pushRing(data, size, now)) || (stopped = stop());
+        };
+        if (parking_.wait(done, timeout) && pushed) {
+            return true;
+        }
+        return stopped ? false : full(data, size, now);
+    }
+
+    /// @returns true if a report pushed now would be enqueued rather than dropped. Only certain when there is a single
+    ///          producer, as others may take the room first.
+    bool writable() const { return overflow_ || depth_.load(std::memory_order_relaxed) < SIZE; }
+
+    /// Wait as a producer blocked in push_blocking does, for something other than room in the ring
+    ///
+    /// @param[in] ready - returns true once the wait is over; retried whenever a slot is freed, or wake() is called
+    /// @param[in] timeout - the longest to wait; std::chrono::nanoseconds::max() waits for as long as it takes
+    ///
+    /// @returns true if ready returned true, false if it was still false at the timeout
+    template <class Ready>
+    bool wait(Ready ready, std::chrono::nanoseconds timeout) {
+        return parking_.wait(ready, timeout);
+    }
+
+    /// Wake every producer waiting in wait() or push_blocking(), to check again
+    void wake() { parking_.release(std::numeric_limits<size_t>::max()); }
+
+    /// @param[out] entry - where to put the oldest report
+    ///
+    /// @returns true if there was a report to dequeue, false otherwise
+    bool pop(Entry& entry) {
+        if (popRing(entry)) {
+            return true;
+        }
+        if (!overflow_) {
+            return false;
+        }
+
+        if (!holding_.load(std::memory_order_relaxed)) {
+            // set first, so that producers keep overflowing while the report is taken out
+            holding_.store(true, std::memory_order_seq_cst);
+            if (!overflow_->pop(held_)) {
+                holding_.store(false, std::memory_order_release);
+                return false;
+            }
+            // a report which went into the ring before this one overflowed may have arrived since the ring was found
+            // empty; it has to come first, so hold on to this one
+            if (popRing(entry)) {
+                return true;
+            }
+        }
+        entry = held_;
+        holding_.store(false, std::memory_order_release);
+        return true;
+    }
+
+    /// @returns true if there are reports in the queue
+    bool read_available() { return buffer_.read_available() || overflowing(); }
+
+    /// A cheaper read_available(), for the loop thread to poll between reports: doesn't lock the ring, and may miss a
+    /// report which is being pushed as it is called
+    ///
+    /// @returns true if there are no reports in the queue
+    bool empty() const { return depth_.load(std::memory_order_relaxed) == 0 && !overflowing(); }
+
+    /// Send reports which don't fit in the ring to overflow, rather than dropping them. Must be called before
+    /// anything is pushed.
+    ///
+    /// @param[in] overflow - where to put the reports
+    void setOverflow(std::unique_ptr<ProgressOverflow<T>> overflow) { overflow_ = std::move(overflow); }
+
+    /// @returns true if there are reports in the overflow still to be handled
+    bool overflowing() const {
+        return overflow_ && (holding_.load(std::memory_order_seq_cst) || !overflow_->empty());
+    }
+
+    /// @returns the counters for this queue
+    QueueStats& stats() const { return *stats_; }
+
+ private:
+    bool pushRing(const T* data, size_t size, uint64_t now) {
+        // count before pushing, so that a racing pop can't take the depth below 0
+        size_t depth = depth_.fetch_add(1, std::memory_order_relaxed) + 1;
+        if (!buffer_.push({data, size, now})) {
+            depth_.fetch_sub(1, std::memory_order_relaxed);
+            return false;
+        }
+        NODE_EVENT_PROBE2(enqueue, size, depth);
+        stats_->sent(true, depth);
+        return true;
+    }
+
+    /// A report didn't fit in the ring: overflow it, or drop it
+    bool full(const T* data, size_t size, uint64_t now) {
+        if (overflow_) {
+            return overflow(data, size, now);
+        }
+        size_t depth = depth_.load(std::memory_order_relaxed);
+        NODE_EVENT_PROBE2(drop, size, depth);
+        stats_->sent(false, depth);
+        return false;
+    }
+
+    bool popRing(Entry& entry) {
+        if (!buffer_.pop(entry)) {
+            return false;
+        }
+        depth_.fetch_sub(1, std::memory_order_relaxed);
+        parking_.release();
+        return true;
+    }
+
+    bool overflow(const T* data, size_t size, uint64_t now) {
+        bool r = overflow_->push(data, size, now);
+        if (r) {
+            NODE_EVENT_PROBE2(overflow, size, now);
+            // the overflow has its own copy
+            if (size > 0) {
+                delete[] data;
+            }
+        } else {
+            NODE_EVENT_PROBE2(drop, size, 0);
+        }
+        stats_->overflowed(r);
+        return r;
+    }
+
+    RingBuffer<Entry, SIZE> buffer_;
+    std::atomic<size_t> depth_;
+    std::shared_ptr<QueueStats> stats_;
+    std::unique_ptr<ProgressOverflow<T>> overflow_;
+    // a report taken out of the overflow, waiting for the ring to empty (only touched by the loop thread)
+    Entry held_;
+    std::atomic<bool> holding_;
+    ProducerParking parking_;
+};
+
+}  // namespace NodeEvent
+
+#endif
@@ -0,0 +1,150 @@
+/*
+ * Copyright 2017 Scoop Technologies
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE
+ * WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+ * OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#pragma once
+#ifndef _NODE_EVENT_QUEUE_STATS_H
+#define _NODE_EVENT_QUEUE_STATS_H
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+#include "latency_histogram.hpp"
+
+namespace NodeEvent {
+/// QueueStats counts what happens to progress queues: how many reports are enqueued and dropped, how deep the queue
+/// gets, how much each drain on the loop thread processes and how long the loop takes to wake up for it. The producer
+/// side counters are sharded by thread, so that many producers don't contend on a single cache line; all counters are
+/// relaxed atomics, so a snapshot is only approximately consistent.
+class QueueStats {
+ public:
+    /// A point in time copy of the counters
+    struct Snapshot {
+        /// reports put in the ring
+        uint64_t enqueued;
+        /// reports which didn't fit in the ring, and were put in the overflow instead
+        uint64_t overflowed;
+        uint64_t dropped;
+        uint64_t high_water;
+        uint64_t drains;
+        uint64_t drained;
+        uint64_t max_drained;
+        /// time from the first report of a drain being queued to the drain starting
+        LatencyHistogram::Summary wakeup;
+    };
+
+    QueueStats() : shards_(), high_water_(), drains_(), drained_(), max_drained_(), wakeup_() { reset(); }
+
+    QueueStats(const QueueStats& other) = delete;
+    QueueStats& operator=(const QueueStats& other) = delete;
+
+    /// Record an attempt to enqueue a report
+    ///
+    /// @param[in] enqueued - whether the report was enqueued, or dropped
+    /// @param[in] depth - depth of the queue after enqueuing
+    void sent(bool enqueued, size_t depth) {
+        Shard& shard = shards_[shardIndex()];
+        if (enqueued) {
+            shard.enqueued.fetch_add(1, std::memory_order_relaxed);
+            raise(high_water_, depth);
+        } else {
+            shard.dropped.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+
+    /// Record an attempt to put a report in the queue's overflow
+    ///
+    /// @param[in] kept - whether the overflow kept the report, or it was dropped
+    void overflowed(bool kept) {
+        Shard& shard = shards_[shardIndex()];
+        (kept ? shard.overflowed : shard.dropped).fetch_add(1, std::memory_order_relaxed);
+    }
+
+    /// Record a drain of the queue
+    ///
+    /// @param[in] items - number of reports handled by the drain
+    /// @param[in] wakeup - nanoseconds between the first of the reports being queued and the drain starting
+    void drained(size_t items, uint64_t wakeup) {
+        wakeup_.record(wakeup);
+        drains_.fetch_add(1, std::memory_order_relaxed);
+        drained_.fetch_add(items, std::memory_order_relaxed);
+        raise(max_drained_, items);
+    }
+
+    Snapshot snapshot() const {
+        Snapshot s{0, 0, 0, 0, 0, 0, 0, wakeup_.summary()};
+        for (auto& shard : shards_) {
+            s.enqueued += shard.enqueued.load(std::memory_order_relaxed);
+            s.overflowed += shard.overflowed.load(std::memory_order_relaxed);
+            s.dropped += shard.dropped.load(std::memory_order_relaxed);
+        }
+        s.high_water = high_water_.load(std::memory_order_relaxed);
+        s.drains = drains_.load(std::memory_order_relaxed);
+        s.drained = drained_.load(std::memory_order_relaxed);
+        s.max_drained = max_drained_.load(std::memory_order_relaxed);
+        return s;
+    }
+
+    /// Zero all of the counters
+    void reset() {
+        for (auto& shard : shards_) {
+            shard.enqueued.store(0, std::memory_order_relaxed);
+            shard.overflowed.store(0, std::memory_order_relaxed);
+            shard.dropped.store(0, std::memory_order_relaxed);
+        }
+        high_water_.store(0, std::memory_order_relaxed);
+        drains_.store(0, std::memory_order_relaxed);
+        drained_.store(0, std::memory_order_relaxed);
+        max_drained_.store(0, std::memory_order_relaxed);
+        wakeup_.reset();
+    }
+
+ private:
+    static constexpr size_t num_shards = 16;
+    static constexpr size_t cache_line = 64;
+
+    struct Shard {
+        std::atomic<uint64_t> enqueued;
+        std::atomic<uint64_t> overflowed;
+        std::atomic<uint64_t> dropped;
+        char padding[cache_line - 3 * sizeof(std::atomic<uint64_t>)];
+    };
+
+    /// @returns the shard for the calling thread; threads are assigned shards round robin
+    static size_t shardIndex() {
+        static std::atomic<size_t> next{0};
+        static thread_local size_t index = next.fetch_add(1, std::memory_order_relaxed) % num_shards;
+        return index;
+    }
+
+    static void raise(std::atomic<uint64_t>& counter, uint64_t value) {
+        uint64_t current = counter.load(std::memory_order_relaxed);
+        while (value > current && !counter.compare_exchange_weak(current, value, std::memory_order_relaxed)) {
+        }
+    }
+
+    std::array<Shard, num_shards> shards_;
+    std::atomic<uint64_t> high_water_;
+    std::atomic<uint64_t> drains_;
+    std::atomic<uint64_t> drained_;
+    std::atomic<uint64_t> max_drained_;
+    LatencyHistogram wakeup_;
+};
+
+}  // namespace NodeEvent
+
+#endif
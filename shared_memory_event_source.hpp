@@ -0,0 +1,127 @@
+/*
+ * Copyright 2017 Scoop Technologies
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE
+ * WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+ * OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#pragma once
+#ifndef _NODE_EVENT_SHARED_MEMORY_EVENT_SOURCE_H
+#define _NODE_EVENT_SHARED_MEMORY_EVENT_SOURCE_H
+
+#include <memory>
+#include <string>
+
+#include <nan.h>
+#include <uv.h>
+
+#include "eventemitter_impl.hpp"
+#include "probes.hpp"
+#include "shared_memory_ring.hpp"
+
+namespace NodeEvent {
+/// SharedMemoryEventSource delivers the events C code in other processes emits through cemitter_shm.h to an emitter's
+/// listeners. It creates the ring (see SharedMemoryRing), and drains it on the loop thread whenever its eventfd is
+/// signalled, a ring's worth per turn of the loop so other work isn't starved. Inline native listeners are notified on
+/// the loop thread too, just before the loop thread listeners.
+///
+/// Create it with new; it deletes itself once closed.
+class SharedMemoryEventSource {
+ public:
+    /// @param[in] emitter - the emitter to deliver events through
+    /// @param[in] name - the shared memory object name producers open, starting with '/'; must not exist yet
+    /// @param[in] capacity - number of events the ring holds
+    /// @param[in] slot_size - the most bytes an event's name and value may take, plus 26
+    ///
+    /// @throws std::invalid_argument if the capacity is too large (see SharedMemoryRing)
+    /// @throws std::system_error if the ring can't be created
+    SharedMemoryEventSource(std::shared_ptr<EventEmitter> emitter, const std::string& name, size_t capacity = 1024,
+                            size_t slot_size = 256)
+        : emitter_(emitter), ring_(name, capacity, slot_size), poll_(new uv_poll_t()) {
+        uv_poll_init(uv_default_loop(), poll_.get(), ring_.fd());
+        poll_->data = this;
+        uv_poll_start(poll_.get(), UV_READABLE, Notified);
+        if (!ring_.sleep()) {
+            ring_.notify();
+        }
+    }
+
+    SharedMemoryEventSource(const SharedMemoryEventSource& other) = delete;
+    SharedMemoryEventSource& operator=(const SharedMemoryEventSource& other) = delete;
+
+    /// Stop draining, unlink the ring, and delete this once the poll handle has closed. Events still in the ring are
+    /// delivered first, up to a ring's worth, so a producer still emitting can't hold up the loop thread; the rest
+    /// are dropped with the ring.
+    void close() {
+        uv_poll_stop(poll_.get());
+        // NOTABUG: libuv handles are all uv_handle_t underneath
+        uv_close(reinterpret_cast<uv_handle_t*>(poll_.get()), Closed);
+    }
+
+    /// @returns the number of events producers found the ring full for
+    uint64_t dropped() const { return ring_.dropped(); }
+
+    /// @returns the shared memory object name producers open
+    const std::string& name() const { return ring_.name(); }
+
+    /// @returns the eventfd producers notify (see cemitter_shm_open)
+    int fd() const { return ring_.fd(); }
+
+ private:
+    ~SharedMemoryEventSource() = default;
+
+    /// @param[in] limit - the most events to deliver before yielding to the rest of the loop
+    ///
+    /// @returns the number of events delivered
+    size_t drain(size_t limit) {
+        Nan::HandleScope scope;
+        SharedMemoryRing::Report report;
+        uint64_t enqueued = 0;
+        size_t drained = 0;
+        NODE_EVENT_PROBE1(drain__start, this);
+        while (drained < limit && ring_.pop(report, enqueued)) {
+            ++drained;
+            uint64_t hash = StringHash::of(report.first);
+            if (emitter_->emitInline(report.first.c_str(), hash, report.second.c_str())) {
+                emitter_->emit(report.first, hash, report.second, enqueued);
+            }
+        }
+        NODE_EVENT_PROBE2(drain__end, this, drained);
+        return drained;
+    }
+
+    // Invoked on the loop thread when a producer, or drain, has signalled the eventfd
+    static void Notified(uv_poll_t* handle, int status, int events) {
+        UNUSED(status);
+        UNUSED(events);
+        auto source = static_cast<SharedMemoryEventSource*>(handle->data);
+        source->ring_.wake();
+        if (source->drain(source->ring_.capacity()) == source->ring_.capacity() || !source->ring_.sleep()) {
+            // more to do; carry on next time around
+            source->ring_.notify();
+        }
+    }
+
+    static void Closed(uv_handle_t* handle) {
+        auto source = static_cast<SharedMemoryEventSource*>(handle->data);
+        source->drain(source->ring_.capacity());
+        delete source;
+    }
+
+    std::shared_ptr<EventEmitter> emitter_;
+    SharedMemoryRing ring_;
+    std::unique_ptr<uv_poll_t> poll_;
+};
+
+}  // namespace NodeEvent
+
+#endif
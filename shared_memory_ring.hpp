@@ -0,0 +1,210 @@
+/*
+ * Copyright 2017 Scoop Technologies
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE
+ * WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+ * OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#pragma once
+#ifndef _NODE_EVENT_SHARED_MEMORY_RING_H
+#define _NODE_EVENT_SHARED_MEMORY_RING_H
+
+#include <fcntl.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <utility>
+
+#include "cemitter_shm.h"
+
+namespace NodeEvent {
+/// SharedMemoryRing is the consumer side of the ring in cemitter_shm.h: it creates the shared memory object other
+/// processes attach to with cemitter_shm_open(), and the eventfd they notify it through. It has RingBuffer's interface
+/// for (event, value) pairs, plus the wait protocol: a consumer which finds the ring empty calls sleep(), and if that
+/// returns true, waits for fd() to become readable (and then reads it) before popping again.
+///
+/// The shared memory object is unlinked when the ring is destroyed; processes still attached keep their mapping, but
+/// nothing drains it. Linux only (eventfd).
+class SharedMemoryRing {
+ public:
+    typedef std::pair<std::string, std::string> Report;
+
+    /// The most slots a ring can have: the largest power of two the header's 32 bit capacity holds
+    static constexpr size_t max_capacity = size_t(1) << 31;
+
+    /// @param[in] name - the shared memory object name, starting with '/' (see shm_open(3)); must not exist yet
+    /// @param[in] capacity - number of slots; rounded up to a power of two, so at most max_capacity
+    /// @param[in] slot_size - bytes per slot; an event's name and value, plus 26 bytes, must fit in one
+    ///
+    /// @throws std::invalid_argument if the capacity is more than max_capacity
+    /// @throws std::system_error if the shared memory or the eventfd can't be created
+    SharedMemoryRing(const std::string& name, size_t capacity, size_t slot_size)
+        : name_(name), shm_(), notify_fd_(-1) {
+        if (capacity > max_capacity) {
+            throw std::invalid_argument("shared memory ring capacity " + std::to_string(capacity) + " is too large");
+        }
+        uint32_t slots = 1;
+        while (slots < capacity) {
+            slots <<= 1;
+        }
+        // keep every slot's sequence number 8 byte aligned
+        auto bytes = static_cast<uint32_t>((slot_size + 7) & ~static_cast<size_t>(7));
+        shm_.size = cemitter_shm_size(slots, bytes);
+
+        int fd = shm_open(name_.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+        if (fd < 0) {
+            throw std::system_error(errno, std::generic_category(), "creating shared memory ring " + name_);
+        }
+        if (ftruncate(fd, static_cast<off_t>(shm_.size)) != 0) {
+            int error = errno;
+            close(fd);
+            shm_unlink(name_.c_str());
+            throw std::system_error(error, std::generic_category(), "sizing shared memory ring " + name_);
+        }
+        void* addr = mmap(nullptr, shm_.size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        int error = errno;
+        close(fd);
+        if (addr == MAP_FAILED) {
+            shm_unlink(name_.c_str());
+            throw std::system_error(error, std::generic_category(), "mapping shared memory ring " + name_);
+        }
+        notify_fd_ = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+        if (notify_fd_ < 0) {
+            error = errno;
+            munmap(addr, shm_.size);
+            shm_unlink(name_.c_str());
+            throw std::system_error(error, std::generic_category(), "creating eventfd");
+        }
+
+        // the memory is zeroed by ftruncate; slot i starts free for position i, and the magic goes in last
+        shm_.header = static_cast<cemitter_shm_header*>(addr);
+        shm_.header->capacity = slots;
+        shm_.header->slot_size = bytes;
+        shm_.notify_fd = notify_fd_;
+        for (uint64_t i = 0; i < slots; ++i) {
+            cemitter_shm_slot_at(shm_.header, i)->seq = i;
+        }
+        __atomic_store_n(&shm_.header->magic, CEMITTER_SHM_MAGIC, __ATOMIC_RELEASE);
+    }
+
+    SharedMemoryRing(const SharedMemoryRing& other) = delete;
+    SharedMemoryRing& operator=(const SharedMemoryRing& other) = delete;
+
+    ~SharedMemoryRing() {
+        munmap(shm_.header, shm_.size);
+        shm_unlink(name_.c_str());
+        close(notify_fd_);
+    }
+
+    /// Queue an event from this process (as cemitter_shm_push)
+    ///
+    /// @param[in] val - the event name and value
+    ///
+    /// @returns true if successful, false if the buffer was full or the event doesn't fit in a slot
+    bool push(Report&& val) { return cemitter_shm_push(&shm_, val.first.c_str(), val.second.c_str()) > 0; }
+
+    /// Dequeue an event. Only one thread may pop at a time.
+    ///
+    /// @param[out] val - place to put the event from the ring
+    /// @param[out] timestamp - the uv_hrtime() at which the event was emitted
+    ///
+    /// @returns true if there was something to dequeue, false otherwise
+    bool pop(Report& val, uint64_t& timestamp) {
+        auto header = shm_.header;
+        uint64_t pos = header->dequeue_pos;
+        auto slot = cemitter_shm_slot_at(header, pos);
+        if (__atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE) != pos + 1) {
+            return false;
+        }
+
+        // the lengths come from another process; don't trust them beyond the slot
+        const char* data = reinterpret_cast<const char*>(slot + 1);
+        size_t room = header->slot_size - sizeof(cemitter_shm_slot);
+        size_t ev_len = std::min<size_t>(slot->ev_len, room);
+        size_t value_len = std::min<size_t>(slot->value_len, room - std::min(room, ev_len + 1));
+        val.first.assign(data, ev_len);
+        val.second.assign(data + std::min(room, ev_len + 1), value_len);
+        timestamp = slot->timestamp;
+
+        __atomic_store_n(&slot->seq, pos + header->capacity, __ATOMIC_RELEASE);
+        __atomic_store_n(&header->dequeue_pos, pos + 1, __ATOMIC_RELAXED);
+        return true;
+    }
+
+    /// @see pop(Report&, uint64_t&)
+    bool pop(Report& val) {
+        uint64_t timestamp;
+        return pop(val, timestamp);
+    }
+
+    /// @returns true if an event is ready to be popped
+    bool read_available() const {
+        auto slot = cemitter_shm_slot_at(shm_.header, shm_.header->dequeue_pos);
+        return __atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE) == shm_.header->dequeue_pos + 1;
+    }
+
+    /// Ask producers to notify fd() when they next push
+    ///
+    /// @returns true if the consumer should wait for fd(), false if an event arrived meanwhile (pop it instead)
+    bool sleep() {
+        __atomic_store_n(&shm_.header->sleeping, 1, __ATOMIC_RELAXED);
+        // pairs with the fence in cemitter_shm_push between publishing a slot and checking sleeping
+        __atomic_thread_fence(__ATOMIC_SEQ_CST);
+        if (read_available()) {
+            __atomic_store_n(&shm_.header->sleeping, 0, __ATOMIC_RELAXED);
+            return false;
+        }
+        return true;
+    }
+
+    /// Reset fd() after it became readable
+    void wake() {
+        uint64_t count;
+        ssize_t ignored = read(notify_fd_, &count, sizeof(count));
+        (void)ignored;
+    }
+
+    /// Notify fd() from this process, e.g. so the consumer comes back for events it left in the ring
+    void notify() {
+        uint64_t one = 1;
+        ssize_t ignored = write(notify_fd_, &one, sizeof(one));
+        (void)ignored;
+    }
+
+    /// @returns the number of events producers found the ring full for
+    uint64_t dropped() const { return __atomic_load_n(&shm_.header->dropped, __ATOMIC_RELAXED); }
+
+    /// @returns the number of slots
+    size_t capacity() const { return shm_.header->capacity; }
+
+    /// @returns the shared memory object name producers open
+    const std::string& name() const { return name_; }
+
+    /// @returns the eventfd producers notify; pass it to them (e.g. in the stdio of a spawned child)
+    int fd() const { return notify_fd_; }
+
+ private:
+    std::string name_;
+    cemitter_shm shm_;
+    int notify_fd_;
+};
+
+}  // namespace NodeEvent
+
+#endif
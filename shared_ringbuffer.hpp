@@ -19,6 +19,7 @@
 #define _NODE_EVENT_RINGBUFFER_H
 
 #include <algorithm>
+#include <chrono>
 #include <condition_variable>
 #include <array>
 #include <memory>
@@ -48,7 +49,7 @@ class RingBuffer {
     static_assert(divides_evenly(SIZE), "SIZE does not divide $2^{sizeof(size_t)*8}$, so behavior on overrun would be erratic");
 
  public:
-    RingBuffer() : lock_(), notifier_(), read_idx_(0), write_idx_(0), buf_() {}
+    RingBuffer() : lock_(), not_empty_(), not_full_(), read_idx_(0), write_idx_(0), buf_() {}
 
     /// Move val into the ringbuffer. If this fails, the object is still moved
     /// (and so, effectively lost at this point). If this is a problem, make a
@@ -68,10 +69,28 @@ class RingBuffer {
     void push_blocking(T&& val) {
         std::unique_lock<std::mutex> guard{lock_};
         while (!unlocked_enqueue(std::move(val))) {
-            notifier_.wait(guard);
+            not_full_.wait(guard);
         }
     }
 
+    /// Move the value into the queue, waiting at most timeout for room
+    /// (no boost equiv)
+    /// @param[in] val - the value to enqueue
+    /// @param[in] timeout - how long to wait for room
+    ///
+    /// @returns true if successful, false if the buffer was still full after timeout
+    template <class Rep, class Period>
+    bool push_blocking(T&& val, const std::chrono::duration<Rep, Period>& timeout) {
+        std::unique_lock<std::mutex> guard{lock_};
+        auto deadline = std::chrono::steady_clock::now() + timeout;
+        while (!unlocked_enqueue(std::move(val))) {
+            if (not_full_.wait_until(guard, deadline) == std::cv_status::timeout) {
+                return unlocked_enqueue(std::move(val));
+            }
+        }
+        return true;
+    }
+
     /// Dequeue an element into val
     ///
     /// @param[out] val - place to put item from the queue
@@ -89,10 +108,10 @@ class RingBuffer {
     /// Blocking attempt to dequeue an item
     /// (no boost equiv)
     /// @returns the dequeued element
-    T&& pop_blocking() {
+    T pop_blocking() {
         std::unique_lock<std::mutex> guard{lock_};
         while (!unlocked_read_available()) {
-            notifier_.wait(guard);
+            not_empty_.wait(guard);
         }
         return unlocked_dequeue();
     }
@@ -116,21 +135,23 @@ class RingBuffer {
         ++write_idx_;
 
         // Notify under mutex to ensure consistent behavior; rely on wait-morphing for performance
-        notifier_.notify_one();
+        not_empty_.notify_one();
         return true;
     }
 
-    inline T&& unlocked_dequeue() {
-        auto&& v = std::move(buf_[read_idx_++ % buf_.size()]);
-        // notify all blocked writers
-        notifier_.notify_all();
-        return std::move(v);
+    inline T unlocked_dequeue() {
+        // move out while still holding the lock; the slot may be overwritten as soon as it is released
+        T v = std::move(buf_[read_idx_++ % buf_.size()]);
+        // one slot was freed, so one blocked writer can proceed
+        not_full_.notify_one();
+        return v;
     }
 
     inline bool unlocked_read_available() { return write_idx_ - read_idx_ != 0; }
 
     std::mutex lock_;
-    std::condition_variable notifier_;
+    std::condition_variable not_empty_;
+    std::condition_variable not_full_;
     size_t read_idx_;
     size_t write_idx_;
     std::array<T, SIZE> buf_;
@@ -0,0 +1,166 @@
+/*
+ * Copyright 2017 Scoop Technologies
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE
+ * WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+ * OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#pragma once
+#ifndef _NODE_EVENT_SLOT_MAP_H
+#define _NODE_EVENT_SLOT_MAP_H
+
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+namespace NodeEvent {
+/// SlotMap is a generational slot map. Values are kept contiguously (so iterating them has good locality of
+/// reference), and are addressed through keys which stay valid while other values come and go. Once a value is
+/// erased, its key is stale forever, even if the slot is reused.
+///
+/// insert and find are O(1). Iteration is always in insertion order: erase shifts the values after the one erased
+/// down, so it is O(n) in the number of values after it (which, for the short lists of listeners this is meant for,
+/// is a few moves).
+template <class T>
+class SlotMap {
+ public:
+    /// The upper 32 bits are the generation of the slot, the lower 32 bits are the index of the slot
+    typedef uint64_t key_type;
+    typedef typename std::vector<T>::iterator iterator;
+    typedef typename std::vector<T>::const_iterator const_iterator;
+
+    /// A key that never refers to a value
+    static constexpr key_type null_key = 0;
+
+    SlotMap() : values_(), value_slots_(), slots_(), free_head_(npos) {}
+
+    /// Add a value
+    ///
+    /// @param[in] value - the value to add
+    ///
+    /// @returns the key for the value
+    key_type insert(T value) {
+        uint32_t slot_idx;
+        if (free_head_ != npos) {
+            slot_idx = free_head_;
+            free_head_ = slots_[slot_idx].index;
+        } else {
+            slot_idx = static_cast<uint32_t>(slots_.size());
+            slots_.push_back({0, 1});
+        }
+
+        slots_[slot_idx].index = static_cast<uint32_t>(values_.size());
+        values_.push_back(std::move(value));
+        value_slots_.push_back(slot_idx);
+
+        return (static_cast<key_type>(slots_[slot_idx].generation) << 32) | slot_idx;
+    }
+
+    /// Remove the value for a key
+    ///
+    /// @param[in] key - key of the value to remove
+    ///
+    /// @returns true if the key referred to a value, false if it was stale
+    bool erase(key_type key) {
+        uint32_t slot_idx = static_cast<uint32_t>(key);
+        if (!live(key)) {
+            return false;
+        }
+
+        for (uint32_t idx = slots_[slot_idx].index; idx + 1 < values_.size(); ++idx) {
+            values_[idx] = std::move(values_[idx + 1]);
+            value_slots_[idx] = value_slots_[idx + 1];
+            slots_[value_slots_[idx]].index = idx;
+        }
+        values_.pop_back();
+        value_slots_.pop_back();
+
+        release(slot_idx);
+        return true;
+    }
+
+    /// @param[in] key - key of the value to find
+    ///
+    /// @returns a pointer to the value, or nullptr if the key is stale
+    T* find(key_type key) { return live(key) ? &values_[slots_[static_cast<uint32_t>(key)].index] : nullptr; }
+
+    /// @param[in] key - key of the value to find
+    ///
+    /// @returns a pointer to the value, or nullptr if the key is stale
+    const T* find(key_type key) const {
+        return live(key) ? &values_[slots_[static_cast<uint32_t>(key)].index] : nullptr;
+    }
+
+    /// @param[in] pos - position of a value, in iteration order
+    ///
+    /// @returns the key of the value at pos
+    key_type key_at(size_t pos) const {
+        uint32_t slot_idx = value_slots_[pos];
+        return (static_cast<key_type>(slots_[slot_idx].generation) << 32) | slot_idx;
+    }
+
+    /// Remove all values, making every key stale
+    void clear() {
+        for (auto slot_idx : value_slots_) {
+            release(slot_idx);
+        }
+        values_.clear();
+        value_slots_.clear();
+    }
+
+    size_t size() const { return values_.size(); }
+    bool empty() const { return values_.empty(); }
+
+    iterator begin() { return values_.begin(); }
+    iterator end() { return values_.end(); }
+    const_iterator begin() const { return values_.begin(); }
+    const_iterator end() const { return values_.end(); }
+
+ private:
+    static constexpr uint32_t npos = static_cast<uint32_t>(-1);
+
+    /// While a slot is in use, index is the position of its value; while it is free, index is the next free slot
+    struct Slot {
+        uint32_t index;
+        uint32_t generation;
+    };
+
+    inline bool live(key_type key) const {
+        uint32_t slot_idx = static_cast<uint32_t>(key);
+        // a free slot's generation is the one it will be handed out with next, so no key can match it yet
+        return slot_idx < slots_.size() && slots_[slot_idx].generation == static_cast<uint32_t>(key >> 32);
+    }
+
+    inline void release(uint32_t slot_idx) {
+        // skip 0 on wrap around, so null_key stays null
+        if (++slots_[slot_idx].generation == 0) {
+            slots_[slot_idx].generation = 1;
+        }
+        slots_[slot_idx].index = free_head_;
+        free_head_ = slot_idx;
+    }
+
+    std::vector<T> values_;
+    std::vector<uint32_t> value_slots_;
+    std::vector<Slot> slots_;
+    uint32_t free_head_;
+};
+
+template <class T>
+constexpr typename SlotMap<T>::key_type SlotMap<T>::null_key;
+
+template <class T>
+constexpr uint32_t SlotMap<T>::npos;
+
+}  // namespace NodeEvent
+
+#endif
@@ -0,0 +1,78 @@
+/*
+ * Copyright 2017 Scoop Technologies
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE
+ * WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+ * OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#pragma once
+#ifndef _NODE_EVENT_SPILL_CODEC_H
+#define _NODE_EVENT_SPILL_CODEC_H
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <utility>
+
+namespace NodeEvent {
+/// SpillCodec<T> turns reports of type T into bytes and back, for SpillFile and the event log. Specialize it for any
+/// report type which should be spillable; each specialization provides
+///
+///   static size_t size(const T& value);                // bytes encode() will write
+///   static void encode(const T& value, char* out);
+///   static size_t decode(const char* in, T& value);     // returns the bytes read
+///
+/// and, to be read back from an event log (which mightn't have been written by this code at all),
+///
+///   static bool fits(const char* in, size_t available); // whether the value at in lies within available bytes
+template <class T>
+struct SpillCodec;
+
+/// Codec for an event name and value: two 32 bit lengths, then the bytes of both strings
+template <>
+struct SpillCodec<std::pair<std::string, std::string>> {
+    typedef std::pair<std::string, std::string> value_type;
+
+    static size_t size(const value_type& value) {
+        return 2 * sizeof(uint32_t) + value.first.size() + value.second.size();
+    }
+
+    static void encode(const value_type& value, char* out) {
+        uint32_t lengths[] = {static_cast<uint32_t>(value.first.size()), static_cast<uint32_t>(value.second.size())};
+        std::memcpy(out, lengths, sizeof(lengths));
+        out += sizeof(lengths);
+        std::memcpy(out, value.first.data(), value.first.size());
+        std::memcpy(out + value.first.size(), value.second.data(), value.second.size());
+    }
+
+    static bool fits(const char* in, size_t available) {
+        uint32_t lengths[2];
+        if (available < sizeof(lengths)) {
+            return false;
+        }
+        std::memcpy(lengths, in, sizeof(lengths));
+        return static_cast<uint64_t>(lengths[0]) + lengths[1] <= available - sizeof(lengths);
+    }
+
+    static size_t decode(const char* in, value_type& value) {
+        uint32_t lengths[2];
+        std::memcpy(lengths, in, sizeof(lengths));
+        in += sizeof(lengths);
+        value.first.assign(in, lengths[0]);
+        value.second.assign(in + lengths[0], lengths[1]);
+        return sizeof(lengths) + lengths[0] + lengths[1];
+    }
+};
+
+}  // namespace NodeEvent
+
+#endif
@@ -0,0 +1,195 @@
+/*
+ * Copyright 2017 Scoop Technologies
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE
+ * WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+ * OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#pragma once
+#ifndef _NODE_EVENT_SPILL_FILE_H
+#define _NODE_EVENT_SPILL_FILE_H
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <system_error>
+#include <utility>
+#include <vector>
+
+#include "progress_queue.hpp"
+#include "spill_codec.hpp"
+
+namespace NodeEvent {
+/// SpillFile is a ProgressOverflow which appends reports to memory mapped segment files, and hands them back in the
+/// order they were appended. Segments are unlinked as soon as they are created, so nothing is left on disk once the
+/// process exits, and are unmapped as soon as they have been read. The page cache decides how much of a burst is
+/// actually in memory, so a small ring can absorb bursts far larger than the process could hold.
+///
+/// Appending and reading take a mutex; it is only touched once the ring has overflowed.
+template <class T>
+class SpillFile : public ProgressOverflow<T> {
+ public:
+    /// @param[in] directory - where to create the segment files
+    /// @param[in] segment_size - size of each segment file, in bytes (larger reports get a segment of their own)
+    ///
+    /// @throws std::system_error if a segment can't be created in the directory
+    SpillFile(const std::string& directory, size_t segment_size)
+        : directory_(directory), segment_size_(segment_size), lock_(), segments_(), pending_(0) {
+        // fail now, on the thread configuring the worker, rather than when the first burst arrives
+        segments_.push_back(map(segment_size_));
+    }
+
+    SpillFile(const SpillFile& other) = delete;
+    SpillFile& operator=(const SpillFile& other) = delete;
+
+    virtual ~SpillFile() {
+        for (auto& segment : segments_) {
+            unmap(segment);
+        }
+    }
+
+    /// Append a copy of a report. Safe to call from any thread.
+    ///
+    /// @returns false if a new segment was needed, and couldn't be created
+    virtual bool push(const T* data, size_t size, uint64_t enqueued) override {
+        size_t bytes = sizeof(Header);
+        for (size_t i = 0; i < size; ++i) {
+            bytes += SpillCodec<T>::size(data[i]);
+        }
+
+        std::lock_guard<std::mutex> guard{lock_};
+        if (segments_.back().capacity - segments_.back().write < bytes) {
+            try {
+                segments_.push_back(map(std::max(segment_size_, bytes)));
+            } catch (const std::system_error&) {
+                return false;
+            }
+        }
+
+        Segment& segment = segments_.back();
+        char* out = segment.base + segment.write;
+        Header header{enqueued, static_cast<uint64_t>(size)};
+        std::memcpy(out, &header, sizeof(header));
+        out += sizeof(header);
+        for (size_t i = 0; i < size; ++i) {
+            SpillCodec<T>::encode(data[i], out);
+            out += SpillCodec<T>::size(data[i]);
+        }
+        segment.write += bytes;
+        pending_.fetch_add(1, std::memory_order_release);
+        return true;
+    }
+
+    /// Read the oldest report back. Must only be called from one thread at a time (the loop thread).
+    virtual bool pop(QueuedReport<T>& report) override {
+        if (empty()) {
+            return false;
+        }
+
+        std::lock_guard<std::mutex> guard{lock_};
+        // a segment which has been read to the end is only left at the front while it is also the one being written
+        if (segments_.front().read == segments_.front().write) {
+            unmap(segments_.front());
+            segments_.pop_front();
+        }
+
+        Segment& segment = segments_.front();
+        const char* in = segment.base + segment.read;
+        Header header;
+        std::memcpy(&header, in, sizeof(header));
+        in += sizeof(header);
+
+        T* data = header.size > 0 ? new T[header.size] : nullptr;
+        for (size_t i = 0; i < header.size; ++i) {
+            in += SpillCodec<T>::decode(in, data[i]);
+        }
+        segment.read = static_cast<size_t>(in - segment.base);
+        report = {data, static_cast<size_t>(header.size), header.enqueued};
+
+        if (segment.read == segment.write) {
+            if (segments_.size() == 1) {
+                // caught up; start the segment over rather than growing the file
+                segment.read = segment.write = 0;
+            } else {
+                unmap(segment);
+                segments_.pop_front();
+            }
+        }
+        pending_.fetch_sub(1, std::memory_order_release);
+        return true;
+    }
+
+    virtual bool empty() const override { return pending_.load(std::memory_order_acquire) == 0; }
+
+    /// @returns the number of reports waiting to be read
+    size_t size() const { return pending_.load(std::memory_order_acquire); }
+
+ private:
+    struct Header {
+        uint64_t enqueued;
+        uint64_t size;
+    };
+
+    struct Segment {
+        char* base;
+        size_t capacity;
+        size_t write;
+        size_t read;
+    };
+
+    /// @throws std::system_error if the segment can't be created
+    Segment map(size_t capacity) {
+        std::vector<char> path(directory_.begin(), directory_.end());
+        const char name[] = "/node-event-spill-XXXXXX";
+        path.insert(path.end(), name, name + sizeof(name));
+
+        int fd = mkstemp(path.data());
+        if (fd < 0) {
+            throw std::system_error(errno, std::generic_category(), "creating spill segment in " + directory_);
+        }
+        unlink(path.data());
+        if (ftruncate(fd, static_cast<off_t>(capacity)) != 0) {
+            int error = errno;
+            close(fd);
+            throw std::system_error(error, std::generic_category(), "sizing spill segment");
+        }
+        void* base = mmap(nullptr, capacity, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        int error = errno;
+        // the mapping keeps the file alive
+        close(fd);
+        if (base == MAP_FAILED) {
+            throw std::system_error(error, std::generic_category(), "mapping spill segment");
+        }
+        return {static_cast<char*>(base), capacity, 0, 0};
+    }
+
+    static void unmap(Segment& segment) { munmap(segment.base, segment.capacity); }
+
+    std::string directory_;
+    size_t segment_size_;
+    std::mutex lock_;
+    std::deque<Segment> segments_;
+    std::atomic<size_t> pending_;
+};
+
+}  // namespace NodeEvent
+
+#endif
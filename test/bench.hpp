@@ -0,0 +1,114 @@
+#pragma once
+#ifndef _NODE_EVENT_BENCH_H
+#define _NODE_EVENT_BENCH_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../latency_histogram.hpp"
+
+/// Helpers shared by the bench_*.cpp microbenchmarks. Every measurement is printed as one line of JSON, so that runs
+/// can be saved and compared, e.g. `make bench > before.json`.
+namespace bench {
+
+#ifdef HAVE_BOOST
+static const char* const impl = "boost_spsc";
+#else
+static const char* const impl = "mutex";
+#endif
+
+/// @returns a monotonic time in nanoseconds
+inline uint64_t now() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+}
+
+/// @returns the number of items to push per measurement, from the first command line argument if given
+inline uint64_t items(int argc, char** argv, uint64_t fallback) {
+    return argc > 1 ? std::strtoull(argv[1], nullptr, 10) : fallback;
+}
+
+/// The outcome of a run
+struct Measurement {
+    uint64_t items;
+    uint64_t ns;
+    /// attempts to push that failed because the queue was full
+    uint64_t full;
+    NodeEvent::LatencyHistogram::Summary latency;
+};
+
+/// Push items from a number of producer threads, and pop them all on the calling thread (as the loop thread does)
+///
+/// @param[in] producers - number of producer threads
+/// @param[in] items - total number of items to push, split evenly between the producers
+/// @param[in] push - bool(uint64_t i): try to push the i-th item of a producer
+/// @param[in] pop - bool(LatencyHistogram&): try to pop an item, recording its latency
+template <class Push, class Pop>
+Measurement run(size_t producers, uint64_t items, Push push, Pop pop) {
+    NodeEvent::LatencyHistogram latency;
+    std::atomic<uint64_t> full{0};
+    std::vector<std::thread> threads;
+    uint64_t per_producer = items / producers;
+    uint64_t total = per_producer * producers;
+
+    uint64_t start = now();
+    for (size_t p = 0; p < producers; ++p) {
+        threads.emplace_back([&full, &push, per_producer]() {
+            uint64_t failed = 0;
+            for (uint64_t i = 0; i < per_producer; ++i) {
+                while (!push(i)) {
+                    ++failed;
+                    std::this_thread::yield();
+                }
+            }
+            full.fetch_add(failed);
+        });
+    }
+    for (uint64_t popped = 0; popped < total;) {
+        if (pop(latency)) {
+            ++popped;
+        } else {
+            std::this_thread::yield();
+        }
+    }
+    uint64_t ns = now() - start;
+    for (auto& t : threads) {
+        t.join();
+    }
+    return {total, ns, full.load(), latency.summary()};
+}
+
+/// Print a measurement as a line of JSON
+///
+/// @param[in] name - the benchmark
+/// @param[in] params - the parameters of the measurement, already formatted as JSON members ("\"size\":16,...")
+/// @param[in] m - the measurement
+inline void report(const char* name, const std::string& params, const Measurement& m) {
+    std::printf(
+        "{\"bench\":\"%s\",\"impl\":\"%s\",%s,\"items\":%llu,\"seconds\":%.6f,\"items_per_sec\":%.0f,\"full\":%llu,"
+        "\"latency_ns\":{\"p50\":%llu,\"p99\":%llu,\"p999\":%llu,\"max\":%llu}}\n",
+        name, impl, params.c_str(), static_cast<unsigned long long>(m.items), m.ns / 1e9,
+        m.ns > 0 ? m.items * 1e9 / m.ns : 0.0, static_cast<unsigned long long>(m.full),
+        static_cast<unsigned long long>(m.latency.p50), static_cast<unsigned long long>(m.latency.p99),
+        static_cast<unsigned long long>(m.latency.p999), static_cast<unsigned long long>(m.latency.max));
+    std::fflush(stdout);
+}
+
+/// @returns the producer counts to measure; boost's queue is single producer, so only 1 for it
+inline std::vector<size_t> producerCounts() {
+#ifdef HAVE_BOOST
+    return {1};
+#else
+    return {1, 2, 4, 8};
+#endif
+}
+
+}  // namespace bench
+
+#endif
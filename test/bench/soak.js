@@ -0,0 +1,146 @@
+'use strict'
+// Sustained load on an EventEmitter from many workers, reporting what reaches javascript and what it costs the
+// process. Prints one line of JSON per interval, and a summary line at the end.
+//
+//   node bench/soak.js --workers 8 --rate 20000 --payload 64 --events 4 --fanout 2 --duration 300
+//
+// --rate is events per second per worker (0 for as fast as possible), --duration is in seconds.
+
+const defaults = { workers: 4, rate: 10000, payload: 64, events: 4, fanout: 1, duration: 60, interval: 5 }
+const options = parseArgs(process.argv.slice(2), defaults)
+
+// the workers run on the libuv threadpool, which has to be sized before it's first used
+if (!process.env.UV_THREADPOOL_SIZE) {
+    process.env.UV_THREADPOOL_SIZE = String(Math.max(4, options.workers + 1))
+}
+
+const testRoot = require('path').resolve(__dirname, '..')
+const bindings = require('bindings')({ 'module_root': testRoot, bindings: 'bench' })
+
+function parseArgs(argv, values) {
+    let parsed = Object.assign({}, values)
+    for (let i = 0; i + 1 < argv.length; i += 2) {
+        let key = argv[i].replace(/^--/, '')
+        if (!(key in parsed)) {
+            throw new Error('Unknown option ' + argv[i])
+        }
+        parsed[key] = Number(argv[i + 1])
+    }
+    return parsed
+}
+
+function nowMs() {
+    let t = process.hrtime()
+    return t[0] * 1e3 + t[1] / 1e6
+}
+
+function percentile(sorted, q) {
+    return sorted.length ? sorted[Math.min(sorted.length - 1, Math.floor(q * sorted.length))] : 0
+}
+
+// event loop lag: how late a 10ms timer fires
+function lagMonitor() {
+    let samples = []
+    let expected = nowMs() + 10
+    let timer = setInterval(() => {
+        let now = nowMs()
+        samples.push(Math.max(0, now - expected))
+        expected = now + 10
+    }, 10)
+    return {
+        take() {
+            let sorted = samples.sort((a, b) => a - b)
+            samples = []
+            return { p50: percentile(sorted, 0.5), p99: percentile(sorted, 0.99), max: percentile(sorted, 1) }
+        },
+        stop() { clearInterval(timer) }
+    }
+}
+
+// time spent in garbage collection, when perf_hooks can tell us
+function gcMonitor() {
+    let total = 0
+    let observer = null
+    try {
+        const PerformanceObserver = require('perf_hooks').PerformanceObserver
+        observer = new PerformanceObserver((list) => {
+            list.getEntries().forEach((entry) => { total += entry.duration })
+        })
+        observer.observe({ entryTypes: ['gc'] })
+    } catch (e) {
+        return { total() { return null }, stop() {} }
+    }
+    return { total() { return total }, stop() { observer.disconnect() } }
+}
+
+function run() {
+    let thing = new bindings.BenchThing()
+    // events which reached javascript; with fanout, each of them is delivered to several listeners
+    let delivered = 0
+    for (let e = 0; e < options.events; ++e) {
+        thing.on('bench.' + e, () => { delivered++ })
+        for (let f = 1; f < options.fanout; ++f) {
+            thing.on('bench.' + e, () => {})
+        }
+    }
+
+    let lag = lagMonitor()
+    let gc = gcMonitor()
+    let start = nowMs()
+    let rssStart = process.memoryUsage().rss
+    let last = { at: start, delivered: 0, stats: thing.stats() }
+
+    function sample() {
+        let now = nowMs()
+        let stats = thing.stats()
+        let emitted = stats.emitted - last.stats.emitted
+        let dropped = stats.dropped - last.stats.dropped
+        let line = {
+            seconds: Math.round((now - start) / 1e3),
+            deliveredPerSec: Math.round((delivered - last.delivered) * 1e3 / (now - last.at)),
+            emittedPerSec: Math.round(emitted * 1e3 / (now - last.at)),
+            dropRate: emitted ? dropped / emitted : 0,
+            queueHighWater: stats.highWater,
+            wakeupP99Us: stats.wakeupP99,
+            lagMs: lag.take(),
+            rssMb: process.memoryUsage().rss / 1048576,
+            gcMs: gc.total()
+        }
+        last = { at: now, delivered: delivered, stats: stats }
+        return line
+    }
+
+    let reporter = setInterval(() => console.log(JSON.stringify(sample())), options.interval * 1e3)
+
+    let running = options.workers
+    for (let w = 0; w < options.workers; ++w) {
+        thing.run(options.rate, options.payload, options.events, options.duration * 1e3, () => {
+            if (--running > 0) {
+                return
+            }
+            // reports still queued are delivered when the workers' handles are closed
+            setTimeout(() => {
+                clearInterval(reporter)
+                let elapsed = nowMs() - start
+                let stats = thing.stats()
+                console.log(JSON.stringify({
+                    summary: true,
+                    options: options,
+                    seconds: elapsed / 1e3,
+                    emitted: stats.emitted,
+                    delivered: delivered,
+                    deliveredPerSec: Math.round(delivered * 1e3 / elapsed),
+                    dropRate: stats.emitted ? stats.dropped / stats.emitted : 0,
+                    queueHighWater: stats.highWater,
+                    maxDrained: stats.maxDrained,
+                    rssGrowthMb: (process.memoryUsage().rss - rssStart) / 1048576,
+                    gcMs: gc.total()
+                }))
+                lag.stop()
+                gc.stop()
+            }, 100)
+        })
+    }
+}
+
+run()
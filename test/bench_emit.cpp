@@ -0,0 +1,55 @@
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <utility>
+
+#include "../progress_queue.hpp"
+#include "bench.hpp"
+
+using NodeEvent::ProgressQueue;
+using NodeEvent::QueueStats;
+
+/// The report type the event emitting workers send (EventEmitter::ProgressReport, without pulling in nan)
+typedef std::pair<std::string, std::string> ProgressReport;
+
+/// The native half of emitting an event: building the report the way AsyncEventEmittingWorker does, and sending it
+/// through the ProgressQueue AsyncQueuedProgressWorker::SendProgress uses, minus the uv_async_send wakeup. The
+/// consumer drains and frees reports as HandleProgressQueue does.
+template <size_t SIZE>
+void measure(uint64_t items, size_t payload) {
+    const std::string value(payload, 'x');
+    for (size_t producers : bench::producerCounts()) {
+        ProgressQueue<ProgressReport, SIZE> queue{std::make_shared<QueueStats>()};
+        auto m = bench::run(producers, items,
+                            [&queue, &value](uint64_t) {
+                                auto reports = new ProgressReport[1];
+                                reports[0] = {"test", value};
+                                if (!queue.push(reports, 1, bench::now())) {
+                                    delete[] reports;
+                                    return false;
+                                }
+                                return true;
+                            },
+                            [&queue](NodeEvent::LatencyHistogram& latency) {
+                                typename ProgressQueue<ProgressReport, SIZE>::Entry entry;
+                                if (!queue.pop(entry)) {
+                                    return false;
+                                }
+                                latency.record(bench::now() - entry.enqueued);
+                                delete[] entry.data;
+                                return true;
+                            });
+        bench::report("emit", "\"size\":" + std::to_string(SIZE) + ",\"producers\":" + std::to_string(producers) +
+                                  ",\"payload\":" + std::to_string(payload),
+                      m);
+    }
+}
+
+int main(int argc, char** argv) {
+    uint64_t items = bench::items(argc, argv, 500000);
+    for (size_t payload : {8, 256}) {
+        measure<16>(items, payload);
+        measure<1024>(items, payload);
+    }
+    return 0;
+}
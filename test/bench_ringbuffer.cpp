@@ -0,0 +1,34 @@
+#include <cstdint>
+#include <string>
+
+#include "../shared_ringbuffer.hpp"
+#include "bench.hpp"
+
+/// Throughput and latency of the RingBuffer alone: producers push their send time, and the consumer records how long
+/// each item spent in the buffer
+template <size_t SIZE>
+void measure(uint64_t items) {
+    for (size_t producers : bench::producerCounts()) {
+        RingBuffer<uint64_t, SIZE> buf;
+        auto m = bench::run(producers, items,
+                            [&buf](uint64_t) { return buf.push(bench::now()); },
+                            [&buf](NodeEvent::LatencyHistogram& latency) {
+                                uint64_t sent;
+                                if (!buf.pop(sent)) {
+                                    return false;
+                                }
+                                latency.record(bench::now() - sent);
+                                return true;
+                            });
+        bench::report("ringbuffer",
+                      "\"size\":" + std::to_string(SIZE) + ",\"producers\":" + std::to_string(producers), m);
+    }
+}
+
+int main(int argc, char** argv) {
+    uint64_t items = bench::items(argc, argv, 1000000);
+    measure<16>(items);
+    measure<256>(items);
+    measure<4096>(items);
+    return 0;
+}
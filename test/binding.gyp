@@ -9,6 +9,7 @@
 				"cflags" : ["-std=c++11", "-ggdb", "-Wall", "-Wextra", "-Wno-unused-parameter", "-fexceptions"],
 				"cflags_cc" : ["-std=c++11", "-ggdb", "-Wall", "-Wextra", "-Wno-unused-parameter", "-fexceptions", "-fno-omit-frame-pointer"],
 				"ldflags": [ "-pthread" ],
+				"libraries": [ "-lrt" ],
 			}],
 			['OS=="mac"', {
 				"xcode_settings": {
@@ -25,5 +26,9 @@
 			"target_name" : "eventemitter",
 			"sources"     : [ "cpp/eventemitter.cpp" ]
 		},
+		{
+			"target_name" : "bench",
+			"sources"     : [ "cpp/bench.cpp" ]
+		},
 	]
 }
@@ -0,0 +1,161 @@
+#include <node.h>
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../../eventemitter.hpp"
+
+using namespace std;
+using namespace NodeEvent;
+using namespace Nan;
+using namespace v8;
+
+/// Emits events at a steady rate for a fixed time, never retrying dropped ones, so that drops show up in the stats
+class SoakWorker : public AsyncEventEmittingCWorker<1024> {
+ public:
+    /// @param[in] rate - events per second, or 0 to emit as fast as possible
+    /// @param[in] payload - size of each value, in bytes
+    /// @param[in] events - number of distinct event names to spread the events over ("bench.0", "bench.1", ...)
+    /// @param[in] duration - how long to emit for
+    SoakWorker(Nan::Callback* callback, std::shared_ptr<EventEmitter> emitter, double rate, size_t payload,
+               size_t events, std::chrono::milliseconds duration)
+        : AsyncEventEmittingCWorker(callback, emitter),
+          rate_(rate),
+          value_(payload, 'x'),
+          names_(),
+          duration_(duration) {
+        for (size_t i = 0; i < events; ++i) {
+            names_.push_back("bench." + std::to_string(i));
+        }
+    }
+
+    virtual void ExecuteWithEmitter(eventemitter_fn emitter) override {
+        auto start = std::chrono::steady_clock::now();
+        auto end = start + duration_;
+        for (uint64_t i = 0;; ++i) {
+            auto now = std::chrono::steady_clock::now();
+            if (now >= end) {
+                break;
+            }
+            if (rate_ > 0) {
+                auto due = start + std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                                       std::chrono::duration<double>(i / rate_));
+                if (due > now) {
+                    std::this_thread::sleep_until(due);
+                }
+            }
+            emitter(names_[i % names_.size()].c_str(), value_.c_str());
+        }
+    }
+
+ private:
+    double rate_;
+    std::string value_;
+    std::vector<std::string> names_;
+    std::chrono::milliseconds duration_;
+};
+
+class BenchThing : public Nan::ObjectWrap {
+ public:
+    static NAN_MODULE_INIT(Init) {
+        auto clsName = Nan::New("BenchThing").ToLocalChecked();
+        auto constructor = Nan::New<v8::FunctionTemplate>(New);
+        auto tpl = constructor->InstanceTemplate();
+        constructor->SetClassName(clsName);
+        tpl->SetInternalFieldCount(1);
+
+        Nan::SetPrototypeMethod(constructor, "on", On);
+        Nan::SetPrototypeMethod(constructor, "run", Run);
+        Nan::SetPrototypeMethod(constructor, "stats", Stats);
+
+        Nan::Set(target, clsName, Nan::GetFunction(constructor).ToLocalChecked());
+    };
+
+ private:
+    BenchThing() : emitter_(std::make_shared<EventEmitter>()) {}
+
+    static NAN_METHOD(On) {
+        if (info.Length() != 2) {
+            info.GetIsolate()->ThrowException(Nan::TypeError("Wrong number of arguments"));
+            return;
+        }
+        if (!info[0]->IsString()) {
+            info.GetIsolate()->ThrowException(Nan::TypeError("First argument must be string"));
+            return;
+        }
+        if (!info[1]->IsFunction()) {
+            info.GetIsolate()->ThrowException(Nan::TypeError("Second argument must be function"));
+            return;
+        }
+
+        auto s = std::string(*v8::String::Utf8Value(info[0]->ToString()));
+        auto thing = Nan::ObjectWrap::Unwrap<BenchThing>(info.Holder());
+        thing->emitter_->on(s, new Nan::Callback(info[1].As<Function>()));
+    }
+
+    /// run(rate, payload, events, durationMs, callback): start one worker
+    static NAN_METHOD(Run) {
+        if (info.Length() != 5) {
+            info.GetIsolate()->ThrowException(Nan::TypeError("Wrong number of arguments"));
+            return;
+        }
+        for (int i = 0; i < 4; ++i) {
+            if (!info[i]->IsNumber()) {
+                info.GetIsolate()->ThrowException(Nan::TypeError("First four arguments must be numbers"));
+                return;
+            }
+        }
+        if (!info[4]->IsFunction()) {
+            info.GetIsolate()->ThrowException(Nan::TypeError("Fifth argument must be function"));
+            return;
+        }
+
+        double rate = info[0]->NumberValue();
+        uint32_t payload = info[1]->Uint32Value();
+        uint32_t events = std::max(1u, info[2]->Uint32Value());
+        uint32_t duration = info[3]->Uint32Value();
+        auto thing = Nan::ObjectWrap::Unwrap<BenchThing>(info.Holder());
+
+        SoakWorker* worker = new SoakWorker(new Nan::Callback(info[4].As<Function>()), thing->emitter_, rate, payload,
+                                            events, std::chrono::milliseconds(duration));
+        Nan::AsyncQueueWorker(worker);
+    }
+
+    /// @returns the emitter's totals: events emitted by the workers, and what happened to them in the queues
+    static NAN_METHOD(Stats) {
+        auto thing = Nan::ObjectWrap::Unwrap<BenchThing>(info.Holder());
+        auto stats = thing->emitter_->stats();
+        uint64_t emitted = 0;
+        for (const auto& e : stats.events) {
+            emitted += e.emitted;
+        }
+
+        v8::Local<v8::Object> o = Nan::New<v8::Object>();
+        Nan::Set(o, Nan::New("emitted").ToLocalChecked(), Nan::New<v8::Number>(emitted));
+        Nan::Set(o, Nan::New("enqueued").ToLocalChecked(), Nan::New<v8::Number>(stats.queue.enqueued));
+        Nan::Set(o, Nan::New("dropped").ToLocalChecked(), Nan::New<v8::Number>(stats.queue.dropped));
+        Nan::Set(o, Nan::New("highWater").ToLocalChecked(), Nan::New<v8::Number>(stats.queue.high_water));
+        Nan::Set(o, Nan::New("drains").ToLocalChecked(), Nan::New<v8::Number>(stats.queue.drains));
+        Nan::Set(o, Nan::New("maxDrained").ToLocalChecked(), Nan::New<v8::Number>(stats.queue.max_drained));
+        Nan::Set(o, Nan::New("wakeupP99").ToLocalChecked(), Nan::New<v8::Number>(stats.queue.wakeup.p99 / 1e3));
+        info.GetReturnValue().Set(o);
+    }
+
+    static NAN_METHOD(New) {
+        if (!info.IsConstructCall()) {
+            info.GetIsolate()->ThrowException(Nan::TypeError("call to constructor without keyword new"));
+            return;
+        }
+
+        BenchThing* o = new BenchThing();
+        o->Wrap(info.This());
+        info.GetReturnValue().Set(info.This());
+    }
+
+    std::shared_ptr<NodeEvent::EventEmitter> emitter_;
+};
+
+NAN_MODULE_INIT(InitAll) { BenchThing::Init(target); }
+NODE_MODULE(NanObject, InitAll);
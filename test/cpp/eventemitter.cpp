@@ -1,9 +1,19 @@
 #include <node.h>
+#include <algorithm>
+#include <atomic>
+#include <cstring>
 #include <iostream>
 #include <sstream>
+#include <stdexcept>
+#include <system_error>
 #include <thread>
+#include <vector>
 
+#include "../../event_stream.hpp"
 #include "../../eventemitter.hpp"
+#ifdef __linux__
+#include "../../shared_memory_event_source.hpp"
+#endif
 
 using namespace std;
 using namespace NodeEvent;
@@ -35,6 +45,209 @@ class TestWorker : public AsyncEventEmittingCWorker<16> {
     int32_t n_;
 };
 
+/// Emits 'test' values in batches, each followed by a batch alternating 'test2' and 'test3'
+class TestBatchWorker : public AsyncEventEmittingCWorker<16> {
+ public:
+    TestBatchWorker(Nan::Callback* callback, std::shared_ptr<EventEmitter> emitter, size_t n, size_t batch)
+        : AsyncEventEmittingCWorker(callback, emitter), n_(n), batch_(batch) {}
+
+    virtual void ExecuteWithEmitter(eventemitter_fn emitter) override {
+        for (size_t i = 0; i < n_; i += batch_) {
+            std::vector<std::string> strings;
+            std::vector<const char*> values;
+            std::vector<const char*> evs;
+            for (size_t j = i; j < std::min(n_, i + batch_); ++j) {
+                strings.push_back("Test" + std::to_string(j));
+                evs.push_back(j % 2 == 0 ? "test2" : "test3");
+            }
+            for (auto& s : strings) {
+                values.push_back(s.c_str());
+            }
+            while (emit_values("test", values.data(), values.size()) != EVENTEMITTER_OK) {
+                std::this_thread::yield();
+            }
+            while (emit_batch(evs.data(), values.data(), values.size()) != EVENTEMITTER_OK) {
+                std::this_thread::yield();
+            }
+        }
+    }
+
+ private:
+    size_t n_;
+    size_t batch_;
+};
+
+/// Emits 'test' values through a small queue, waiting for room rather than retrying
+class TestBlockingWorker : public AsyncEventEmittingCWorker<4> {
+ public:
+    TestBlockingWorker(Nan::Callback* callback, std::shared_ptr<EventEmitter> emitter, size_t n)
+        : AsyncEventEmittingCWorker(callback, emitter), n_(n) {}
+
+    virtual void ExecuteWithEmitter(eventemitter_fn emitter) override {
+        for (size_t i = 0; i < n_; ++i) {
+            stringstream ss;
+            ss << "Test" << i;
+            if (emit_blocking("test", ss.str().c_str(), -1) != EVENTEMITTER_OK) {
+                SetErrorMessage("blocking emit failed");
+                return;
+            }
+        }
+    }
+
+ private:
+    size_t n_;
+};
+
+/// The events of TestTypedWorker
+struct Progress : TypedEvent<double> {
+    static const char* name() { return "progress"; }
+};
+struct Done : TypedEvent<void> {
+    static const char* name() { return "done"; }
+};
+typedef EventSchema<Progress, Done> TestSchema;
+
+/// Emits n halves as 'progress' by tag, without dropping any, then 'done'
+class TestTypedWorker : public AsyncTypedEventEmittingWorker<TestSchema, 16> {
+ public:
+    TestTypedWorker(Nan::Callback* callback, std::shared_ptr<TypedEventEmitter<TestSchema>> emitter, size_t n)
+        : AsyncTypedEventEmittingWorker(callback, emitter), n_(n) {}
+
+    virtual void ExecuteTyped(const ExecutionProgressSender& sender) override {
+        for (size_t i = 0; i < n_; ++i) {
+            emitEvent<Progress>(sender, i / 2.0, std::chrono::nanoseconds::max());
+        }
+        emitEvent<Done>(sender, std::chrono::nanoseconds::max());
+    }
+
+ private:
+    size_t n_;
+};
+
+/// Emits 'test' values until the work is cancelled, as a long running solve would
+class TestCancellableWorker : public AsyncEventEmittingCWorker<16> {
+ public:
+    TestCancellableWorker(Nan::Callback* callback, std::shared_ptr<EventEmitter> emitter)
+        : AsyncEventEmittingCWorker(callback, emitter) {}
+
+    virtual void ExecuteWithEmitter(eventemitter_fn emitter) override {
+        for (size_t i = 0; !is_cancelled(); ++i) {
+            stringstream ss;
+            ss << "Test" << i;
+            if (emit_blocking("test", ss.str().c_str(), -1) == EVENTEMITTER_CANCELLED) {
+                return;
+            }
+        }
+    }
+};
+
+/// Retries dropped and throttled 'test' events, telling them from cancellation by emit_status
+class TestRetryingWorker : public AsyncEventEmittingCWorker<16> {
+ public:
+    TestRetryingWorker(Nan::Callback* callback, std::shared_ptr<EventEmitter> emitter, size_t n)
+        : AsyncEventEmittingCWorker(callback, emitter), n_(n) {}
+
+    virtual void ExecuteWithEmitter(eventemitter_fn emitter) override {
+        for (size_t i = 0; i < n_; ++i) {
+            stringstream ss;
+            ss << "Test" << i;
+            int r;
+            while ((r = emit_status("test", ss.str().c_str())) != EVENTEMITTER_OK) {
+                if (r == EVENTEMITTER_CANCELLED) {
+                    return;
+                }
+                std::this_thread::yield();
+            }
+        }
+    }
+
+ private:
+    size_t n_;
+};
+
+/// Floods the queue with 'test' events without retrying, with an 'error' every tenth event
+class TestPriorityWorker : public AsyncEventEmittingCWorker<16, 4> {
+ public:
+    TestPriorityWorker(Nan::Callback* callback, std::shared_ptr<EventEmitter> emitter, size_t n)
+        : AsyncEventEmittingCWorker(callback, emitter), n_(n) {}
+
+    virtual void ExecuteWithEmitter(eventemitter_fn emitter) override {
+        for (size_t i = 0; i < n_; ++i) {
+            stringstream ss;
+            ss << "Test" << i;
+            emitter("test", ss.str().c_str());
+            if (i % 10 == 0 && !emitter("error", ss.str().c_str())) {
+                SetErrorMessage("error was dropped");
+            }
+        }
+    }
+
+ private:
+    size_t n_;
+};
+
+/// Emits batches of 'error' values, which are prioritized, while flow control has no credits
+class TestPriorityBatchWorker : public AsyncEventEmittingCWorker<16, 4> {
+ public:
+    TestPriorityBatchWorker(Nan::Callback* callback, std::shared_ptr<EventEmitter> emitter, size_t n)
+        : AsyncEventEmittingCWorker(callback, emitter), n_(n) {}
+
+    virtual void ExecuteWithEmitter(eventemitter_fn emitter) override {
+        for (size_t i = 0; i < n_; i += 2) {
+            std::string values[] = {"Test" + std::to_string(i), "Test" + std::to_string(i + 1)};
+            const char* v[] = {values[0].c_str(), values[1].c_str()};
+            if (emit_values("error", v, 2) != EVENTEMITTER_OK) {
+                SetErrorMessage("prioritized batch wasn't delivered");
+                return;
+            }
+        }
+    }
+
+ private:
+    size_t n_;
+};
+
+/// Makes one blocking emit with a finite timeout, for a worker whose parking credits never come
+class TestStarvedBlockingWorker : public AsyncEventEmittingCWorker<4> {
+ public:
+    TestStarvedBlockingWorker(Nan::Callback* callback, std::shared_ptr<EventEmitter> emitter, long timeout_ms)
+        : AsyncEventEmittingCWorker(callback, emitter), timeout_ms_(timeout_ms) {}
+
+    virtual void ExecuteWithEmitter(eventemitter_fn emitter) override {
+        if (emit_blocking("test", "Test0", timeout_ms_) != EVENTEMITTER_THROTTLED) {
+            SetErrorMessage("blocking emit wasn't throttled at its timeout");
+        }
+    }
+
+ private:
+    long timeout_ms_;
+};
+
+/// Passes how many of each limited event were delivered and suppressed to the callback
+class TestLimitedWorker : public TestWorker {
+ public:
+    TestLimitedWorker(Nan::Callback* callback, std::shared_ptr<EventEmitter> emitter, size_t n)
+        : TestWorker(callback, emitter, n) {}
+
+    virtual void HandleOKCallback() override {
+        Nan::HandleScope scope;
+        auto counts = Nan::New<v8::Object>();
+        for (auto& suppressed : Suppressed()) {
+            auto count = Nan::New<v8::Object>();
+            Nan::Set(count, Nan::New("admitted").ToLocalChecked(), Nan::New<v8::Number>(suppressed.admitted));
+            Nan::Set(count, Nan::New("rateLimited").ToLocalChecked(), Nan::New<v8::Number>(suppressed.rate_limited));
+            Nan::Set(count, Nan::New("sampledOut").ToLocalChecked(), Nan::New<v8::Number>(suppressed.sampled_out));
+            Nan::Set(counts, Nan::New(suppressed.event).ToLocalChecked(), count);
+        }
+        v8::Local<v8::Value> argv[] = {Nan::Null(), counts};
+#if defined(NODE_8_0_MODULE_VERSION) && (NODE_8_0_MODULE_VERSION > 51)
+        callback->Call(2, argv, async_resource);
+#else
+        callback->Call(2, argv);
+#endif
+    }
+};
+
 class TestReentrantWorker : public AsyncEventEmittingReentrantCWorker<16> {
  public:
     TestReentrantWorker(Nan::Callback* callback, std::shared_ptr<EventEmitter> emitter, size_t n)
@@ -60,6 +273,177 @@ class TestReentrantWorker : public AsyncEventEmittingReentrantCWorker<16> {
     int32_t n_;
 };
 
+class TestNumericWorker : public AsyncEventEmittingCWorker<16> {
+ public:
+    TestNumericWorker(Nan::Callback* callback, std::shared_ptr<EventEmitter> emitter, size_t n)
+        : AsyncEventEmittingCWorker(callback, emitter), n_(n) {}
+
+    virtual void ExecuteWithEmitter(eventemitter_fn emitter) override {
+        for (int32_t i = 0; i < n_; ++i) {
+            while (!emitter("value", std::to_string(i).c_str())) {
+                std::this_thread::yield();
+            }
+        }
+    }
+
+ private:
+    int32_t n_;
+};
+
+/// Emits n 'value's, then goes quiet until the work is cancelled, as a gauge on a long running solve would
+class TestIdleNumericWorker : public TestNumericWorker {
+ public:
+    TestIdleNumericWorker(Nan::Callback* callback, std::shared_ptr<EventEmitter> emitter, size_t n)
+        : TestNumericWorker(callback, emitter, n) {}
+
+    virtual void ExecuteWithEmitter(eventemitter_fn emitter) override {
+        TestNumericWorker::ExecuteWithEmitter(emitter);
+        while (!is_cancelled()) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+    }
+};
+
+#ifdef __linux__
+/// Emits through a shared memory ring, as a C library in another process would
+class TestSharedMemoryProducer : public Nan::AsyncWorker {
+ public:
+    TestSharedMemoryProducer(Nan::Callback* callback, const std::string& name, int fd, size_t n)
+        : AsyncWorker(callback), name_(name), fd_(fd), n_(n) {}
+
+    virtual void Execute() override {
+        cemitter_shm* shm = cemitter_shm_open(name_.c_str(), fd_);
+        if (!shm) {
+            SetErrorMessage(strerror(errno));
+            return;
+        }
+        for (size_t i = 0; i < n_; ++i) {
+            stringstream ss;
+            ss << "Test" << i;
+            while (!cemitter_shm_emit(shm, "test", ss.str().c_str())) {
+                std::this_thread::yield();
+            }
+            while (!cemitter_shm_emit(shm, "test2", ss.str().c_str())) {
+                std::this_thread::yield();
+            }
+        }
+        cemitter_shm_close(shm);
+    }
+
+ private:
+    std::string name_;
+    int fd_;
+    size_t n_;
+};
+#endif
+
+#ifdef __cpp_impl_coroutine
+/// Emits n 'test' values, "<task>:<i>", as one of many tasks sharing a worker thread
+EmitTask testTask(size_t task, size_t n) {
+    for (size_t i = 0; i < n; ++i) {
+        co_yield Event{"test", std::to_string(task) + ":" + std::to_string(i)};
+    }
+}
+#endif
+
+/// The binding events.js expects of a stream: pull(max, callback) and close()
+class StreamThing : public Nan::ObjectWrap {
+ public:
+    static void Init() {
+        auto constructor = Nan::New<v8::FunctionTemplate>(New);
+        constructor->SetClassName(Nan::New("StreamThing").ToLocalChecked());
+        constructor->InstanceTemplate()->SetInternalFieldCount(1);
+
+        Nan::SetPrototypeMethod(constructor, "pull", Pull);
+        Nan::SetPrototypeMethod(constructor, "close", Close);
+        Nan::SetPrototypeMethod(constructor, "size", Size);
+        Nan::SetPrototypeMethod(constructor, "dropped", Dropped);
+        Constructor().Reset(Nan::GetFunction(constructor).ToLocalChecked());
+    }
+
+    /// @returns a new StreamThing, which owns stream
+    static v8::Local<v8::Object> NewInstance(EventStream* stream) {
+        auto object = Nan::NewInstance(Nan::New(Constructor())).ToLocalChecked();
+        Nan::ObjectWrap::Unwrap<StreamThing>(object)->stream_ = stream;
+        return object;
+    }
+
+ private:
+    StreamThing() : stream_(nullptr) {}
+
+    ~StreamThing() {
+        if (stream_) {
+            stream_->close();
+        }
+    }
+
+    static Nan::Persistent<v8::Function>& Constructor() {
+        static Nan::Persistent<v8::Function> constructor;
+        return constructor;
+    }
+
+    static NAN_METHOD(New) {
+        auto o = new StreamThing();
+        o->Wrap(info.This());
+        info.GetReturnValue().Set(info.This());
+    }
+
+    /// pull(max, callback): calls back with up to max values once there are any, or with none once closed
+    static NAN_METHOD(Pull) {
+        if (info.Length() != 2 || !info[0]->IsNumber() || !info[1]->IsFunction()) {
+            info.GetIsolate()->ThrowException(Nan::TypeError("Arguments must be number and function"));
+            return;
+        }
+        auto self = Nan::ObjectWrap::Unwrap<StreamThing>(info.Holder());
+        auto callback = std::make_shared<Nan::Callback>(info[1].As<Function>());
+        size_t max = info[0]->Uint32Value();
+        if (self->stream_ && self->stream_->wait([self, callback, max]() {
+                self->deliver(*callback, max);
+                self->Unref();
+            })) {
+            // kept alive until the values arrive
+            self->Ref();
+            return;
+        }
+        self->deliver(*callback, max);
+    }
+
+    static NAN_METHOD(Close) {
+        auto self = Nan::ObjectWrap::Unwrap<StreamThing>(info.Holder());
+        if (self->stream_) {
+            auto stream = self->stream_;
+            self->stream_ = nullptr;
+            stream->close();
+        }
+    }
+
+    static NAN_METHOD(Size) {
+        auto self = Nan::ObjectWrap::Unwrap<StreamThing>(info.Holder());
+        info.GetReturnValue().Set(Nan::New<v8::Number>(self->stream_ ? self->stream_->size() : 0));
+    }
+
+    static NAN_METHOD(Dropped) {
+        auto self = Nan::ObjectWrap::Unwrap<StreamThing>(info.Holder());
+        info.GetReturnValue().Set(Nan::New<v8::Number>(self->stream_ ? self->stream_->dropped() : 0));
+    }
+
+    void deliver(Nan::Callback& callback, size_t max) {
+        Nan::HandleScope scope;
+        std::vector<EventEmitter::ProgressReport> reports;
+        if (stream_) {
+            stream_->pull(reports, max);
+        }
+        auto values = Nan::New<v8::Array>(reports.size());
+        for (size_t i = 0; i < reports.size(); ++i) {
+            Nan::Set(values, i, Nan::New(reports[i].second).ToLocalChecked());
+        }
+        v8::Local<v8::Value> argv[] = {values};
+        callback.Call(1, argv);
+    }
+
+    EventStream* stream_;
+};
+
 class EmittingThing : public Nan::ObjectWrap {
  public:
     static NAN_MODULE_INIT(Init) {
@@ -70,18 +454,76 @@ class EmittingThing : public Nan::ObjectWrap {
         tpl->SetInternalFieldCount(1);
 
         Nan::SetPrototypeMethod(constructor, "on", On);
+        Nan::SetPrototypeMethod(constructor, "once", Once);
+        Nan::SetPrototypeMethod(constructor, "off", Off);
+        Nan::SetPrototypeMethod(constructor, "emit", Emit);
+        Nan::SetPrototypeMethod(constructor, "filter", Filter);
         Nan::SetPrototypeMethod(constructor, "run", Run);
         Nan::SetPrototypeMethod(constructor, "runReentrant", RunReentrant);
+        Nan::SetPrototypeMethod(constructor, "runAggregated", RunAggregated);
+        Nan::SetPrototypeMethod(constructor, "runAggregatedIdle", RunAggregatedIdle);
+        Nan::SetPrototypeMethod(constructor, "runSpilled", RunSpilled);
+        Nan::SetPrototypeMethod(constructor, "runLimited", RunLimited);
+        Nan::SetPrototypeMethod(constructor, "runPrioritized", RunPrioritized);
+        Nan::SetPrototypeMethod(constructor, "runBatched", RunBatched);
+        Nan::SetPrototypeMethod(constructor, "runPriorityBatched", RunPriorityBatched);
+        Nan::SetPrototypeMethod(constructor, "runBlocking", RunBlocking);
+        Nan::SetPrototypeMethod(constructor, "runBlockingStarved", RunBlockingStarved);
+        Nan::SetPrototypeMethod(constructor, "runTyped", RunTyped);
+        Nan::SetPrototypeMethod(constructor, "runFlowControlled", RunFlowControlled);
+        Nan::SetPrototypeMethod(constructor, "runSampledThrottled", RunSampledThrottled);
+        Nan::SetPrototypeMethod(constructor, "grantCredits", GrantCredits);
+        Nan::SetPrototypeMethod(constructor, "stream", Stream);
+        Nan::SetPrototypeMethod(constructor, "runStreamed", RunStreamed);
+        Nan::SetPrototypeMethod(constructor, "runCancellable", RunCancellable);
+        Nan::SetPrototypeMethod(constructor, "runRetrying", RunRetrying);
+        Nan::SetPrototypeMethod(constructor, "cancel", Cancel);
+        Nan::SetPrototypeMethod(constructor, "startCapture", StartCapture);
+        Nan::SetPrototypeMethod(constructor, "stopCapture", StopCapture);
+        Nan::SetPrototypeMethod(constructor, "replay", Replay);
+#ifdef __cpp_impl_coroutine
+        Nan::SetPrototypeMethod(constructor, "runCoroutines", RunCoroutines);
+#endif
+#ifdef __linux__
+        Nan::SetPrototypeMethod(constructor, "listenShared", ListenShared);
+        Nan::SetPrototypeMethod(constructor, "closeShared", CloseShared);
+        Nan::SetPrototypeMethod(constructor, "runSharedProducer", RunSharedProducer);
+#endif
         Nan::SetPrototypeMethod(constructor, "removeAllListeners", RemoveAllListeners);
+        Nan::SetPrototypeMethod(constructor, "retain", Retain);
+        Nan::SetPrototypeMethod(constructor, "dropUnheard", DropUnheard);
         Nan::SetPrototypeMethod(constructor, "eventNames", EventNames);
+        Nan::SetPrototypeMethod(constructor, "onNativeCounter", OnNativeCounter);
+        Nan::SetPrototypeMethod(constructor, "nativeCount", NativeCount);
+        Nan::SetPrototypeMethod(constructor, "stats", Stats);
+        Nan::SetPrototypeMethod(constructor, "resetStats", ResetStats);
+        Nan::SetPrototypeMethod(constructor, "profileListeners", ProfileListeners);
+        Nan::SetPrototypeMethod(constructor, "topListeners", TopListeners);
 
         Nan::Set(target, clsName, Nan::GetFunction(constructor).ToLocalChecked());
     };
 
  private:
-    EmittingThing() : emitter_(std::make_shared<EventEmitter>()) {}
-    static NAN_METHOD(On) {
-        if (info.Length() != 2) {
+    EmittingThing()
+        : emitter_(std::make_shared<TypedEventEmitter<TestSchema>>()),
+          native_counters_(),
+          handles_(),
+          next_handle_(1),
+          filters_(),
+          shared_(nullptr),
+          credits_() {}
+
+    static void countEvent(void* data, const char* ev, const char* value) {
+        ++*static_cast<std::atomic<uint32_t>*>(data);
+    }
+
+    static std::string counterKey(const std::string& ev, bool inlined) { return (inlined ? "inline:" : "loop:") + ev; }
+    static NAN_METHOD(On) { AddListener(info, false); }
+
+    static NAN_METHOD(Once) { AddListener(info, true); }
+
+    static void AddListener(const Nan::FunctionCallbackInfo<v8::Value>& info, bool once) {
+        if (info.Length() < 2 || info.Length() > 3) {
             info.GetIsolate()->ThrowException(Nan::TypeError("Wrong number of arguments"));
             return;
         }
@@ -94,11 +536,96 @@ class EmittingThing : public Nan::ObjectWrap {
             return;
         }
 
+        auto thing = Nan::ObjectWrap::Unwrap<EmittingThing>(info.Holder());
+        ListenerFilter filter;
+        if (info.Length() == 3 && info[2]->IsNumber()) {
+            if (info[2]->Uint32Value() >= thing->filters_.size()) {
+                info.GetIsolate()->ThrowException(Nan::TypeError("Unknown filter"));
+                return;
+            }
+            filter = thing->filters_[info[2]->Uint32Value()];
+        } else if (info.Length() == 3 && !ParseFilter(info, info[2], filter)) {
+            return;
+        }
+
         auto s = std::string(*v8::String::Utf8Value(info[0]->ToString()));
         Nan::Callback* callback = new Nan::Callback(info[1].As<Function>());
 
+        uint32_t id = thing->next_handle_++;
+        thing->handles_[id] =
+            once ? thing->emitter_->once(s, callback, filter) : thing->emitter_->addListener(s, callback, filter);
+
+        info.GetReturnValue().Set(id);
+    }
+
+    /// filter(options) -> a number which on() and once() take in place of the options, to give several listeners the
+    /// same filter
+    static NAN_METHOD(Filter) {
+        if (info.Length() != 1) {
+            info.GetIsolate()->ThrowException(Nan::TypeError("Wrong number of arguments"));
+            return;
+        }
+        ListenerFilter filter;
+        if (!ParseFilter(info, info[0], filter)) {
+            return;
+        }
+        auto thing = Nan::ObjectWrap::Unwrap<EmittingThing>(info.Holder());
+        thing->filters_.push_back(filter);
+        info.GetReturnValue().Set(static_cast<uint32_t>(thing->filters_.size() - 1));
+    }
+
+    /// filter options are one of {prefix: string}, {regex: string}, {min: number, max: number} or {every: number}
+    static bool ParseFilter(const Nan::FunctionCallbackInfo<v8::Value>& info, v8::Local<v8::Value> arg,
+                            ListenerFilter& filter) {
+        if (!arg->IsObject()) {
+            info.GetIsolate()->ThrowException(Nan::TypeError("Third argument must be filter options"));
+            return false;
+        }
+        auto options = arg.As<v8::Object>();
+        auto option = [&options](const char* name) {
+            return Nan::Get(options, Nan::New(name).ToLocalChecked()).ToLocalChecked();
+        };
+
+        if (option("prefix")->IsString()) {
+            filter = ListenerFilter::prefix(*v8::String::Utf8Value(option("prefix")->ToString()));
+        } else if (option("regex")->IsString()) {
+            try {
+                filter = ListenerFilter::regex(*v8::String::Utf8Value(option("regex")->ToString()));
+            } catch (const std::regex_error& e) {
+                info.GetIsolate()->ThrowException(Nan::TypeError("Invalid regex"));
+                return false;
+            }
+        } else if (option("min")->IsNumber() && option("max")->IsNumber()) {
+            filter = ListenerFilter::range(option("min")->NumberValue(), option("max")->NumberValue());
+        } else if (option("every")->IsNumber()) {
+            filter = ListenerFilter::sample(option("every")->Uint32Value());
+        } else {
+            info.GetIsolate()->ThrowException(Nan::TypeError("Unknown filter options"));
+            return false;
+        }
+        return true;
+    }
+
+    static NAN_METHOD(Off) {
+        if (info.Length() != 1) {
+            info.GetIsolate()->ThrowException(Nan::TypeError("Wrong number of arguments"));
+            return;
+        }
+        if (!info[0]->IsNumber()) {
+            info.GetIsolate()->ThrowException(Nan::TypeError("First argument must be a handle returned by on"));
+            return;
+        }
+
         auto thing = Nan::ObjectWrap::Unwrap<EmittingThing>(info.Holder());
-        thing->emitter_->on(s, callback);
+        auto it = thing->handles_.find(info[0]->Uint32Value());
+        if (it == thing->handles_.end()) {
+            info.GetReturnValue().Set(false);
+            return;
+        }
+
+        bool removed = thing->emitter_->off(it->second);
+        thing->handles_.erase(it);
+        info.GetReturnValue().Set(removed);
     }
 
     static NAN_METHOD(Run) {
@@ -127,41 +654,629 @@ class EmittingThing : public Nan::ObjectWrap {
         Nan::AsyncQueueWorker(worker);
     }
 
-    static NAN_METHOD(RemoveAllListeners) {
-        if (info.Length() > 1) {
+    static NAN_METHOD(RunAggregated) {
+        if (info.Length() != 3) {
             info.GetIsolate()->ThrowException(Nan::TypeError("Wrong number of arguments"));
             return;
         }
+        if (!info[0]->IsNumber() || !info[1]->IsNumber()) {
+            info.GetIsolate()->ThrowException(Nan::TypeError("First and second arguments must be numbers"));
+            return;
+        }
+        if (!info[2]->IsFunction()) {
+            info.GetIsolate()->ThrowException(Nan::TypeError("Third argument must be function"));
+            return;
+        }
+
+        int32_t n = info[0]->Int32Value();
+        auto window = std::chrono::milliseconds(info[1]->Int32Value());
         auto thing = Nan::ObjectWrap::Unwrap<EmittingThing>(info.Holder());
 
-        if (info.Length() == 1) {
-            if (!info[0]->IsString()) {
-                info.GetIsolate()->ThrowException(Nan::TypeError("First argument must be string name of an event"));
-                return;
-            }
-            auto ev = std::string(*v8::String::Utf8Value(info[0]->ToString()));
-            thing->emitter_->removeAllListenersForEvent(ev);
-        } else {
-            thing->emitter_->removeAllListeners();
-        }
+        auto fn = new Nan::Callback(info[2].As<Function>());
+
+        TestNumericWorker* worker = new TestNumericWorker(fn, thing->emitter_, n);
+        worker->aggregate("value", window);
+        Nan::AsyncQueueWorker(worker);
     }
 
-    static NAN_METHOD(EventNames) {
-        if (info.Length() > 0) {
-            info.GetIsolate()->ThrowException(Nan::TypeError("Wrong number of arguments"));
+    /// runAggregatedIdle(n, window, callback): emits n 'value's, then runs until cancelled
+    static NAN_METHOD(RunAggregatedIdle) {
+        if (info.Length() != 3 || !info[0]->IsNumber() || !info[1]->IsNumber() || !info[2]->IsFunction()) {
+            info.GetIsolate()->ThrowException(Nan::TypeError("Arguments must be number, number and function"));
             return;
         }
         auto thing = Nan::ObjectWrap::Unwrap<EmittingThing>(info.Holder());
-        v8::Local<v8::Array> v = v8::Array::New(info.GetIsolate());
-
-        size_t i = 0; 
-        for (auto s : thing->emitter_->eventNames()) {
-            v->Set(i++, v8::String::NewFromUtf8(info.GetIsolate(), s.c_str()));
-        }
-
-        info.GetReturnValue().Set(v);
+        auto worker = new TestIdleNumericWorker(new Nan::Callback(info[2].As<Function>()), thing->emitter_,
+                                                info[0]->Int32Value());
+        worker->aggregate("value", std::chrono::milliseconds(info[1]->Int32Value()));
+        Nan::AsyncQueueWorker(worker);
     }
 
+    /// runLimited(n, sampleEvery, perSecond, burst, callback): 'test' is sampled, 'test2' is rate limited
+    static NAN_METHOD(RunLimited) {
+        if (info.Length() != 5) {
+            info.GetIsolate()->ThrowException(Nan::TypeError("Wrong number of arguments"));
+            return;
+        }
+        if (!info[0]->IsNumber() || !info[1]->IsNumber() || !info[2]->IsNumber() || !info[3]->IsNumber()) {
+            info.GetIsolate()->ThrowException(Nan::TypeError("First four arguments must be numbers"));
+            return;
+        }
+        if (!info[4]->IsFunction()) {
+            info.GetIsolate()->ThrowException(Nan::TypeError("Fifth argument must be function"));
+            return;
+        }
+
+        auto thing = Nan::ObjectWrap::Unwrap<EmittingThing>(info.Holder());
+        auto worker = new TestLimitedWorker(new Nan::Callback(info[4].As<Function>()), thing->emitter_,
+                                            info[0]->Int32Value());
+        worker->sample("test", info[1]->Uint32Value());
+        try {
+            worker->rateLimit("test2", info[2]->NumberValue(), info[3]->NumberValue());
+        } catch (const std::invalid_argument& e) {
+            // closes the worker's async handle, then deletes it
+            worker->Destroy();
+            info.GetIsolate()->ThrowException(Nan::RangeError(e.what()));
+            return;
+        }
+        Nan::AsyncQueueWorker(worker);
+    }
+
+    static NAN_METHOD(RunPrioritized) {
+        if (info.Length() != 2) {
+            info.GetIsolate()->ThrowException(Nan::TypeError("Wrong number of arguments"));
+            return;
+        }
+        if (!info[0]->IsNumber() || !info[1]->IsFunction()) {
+            info.GetIsolate()->ThrowException(Nan::TypeError("Arguments must be number and function"));
+            return;
+        }
+
+        auto thing = Nan::ObjectWrap::Unwrap<EmittingThing>(info.Holder());
+        auto worker = new TestPriorityWorker(new Nan::Callback(info[1].As<Function>()), thing->emitter_,
+                                             info[0]->Int32Value());
+        worker->prioritize("error");
+        Nan::AsyncQueueWorker(worker);
+    }
+
+    /// runPriorityBatched(n, callback): batches of prioritized 'error's, with no flow control credits to spare
+    static NAN_METHOD(RunPriorityBatched) {
+        if (info.Length() != 2 || !info[0]->IsNumber() || !info[1]->IsFunction()) {
+            info.GetIsolate()->ThrowException(Nan::TypeError("Arguments must be number and function"));
+            return;
+        }
+        auto thing = Nan::ObjectWrap::Unwrap<EmittingThing>(info.Holder());
+        auto worker = new TestPriorityBatchWorker(new Nan::Callback(info[1].As<Function>()), thing->emitter_,
+                                                  info[0]->Int32Value());
+        worker->prioritize("error");
+        worker->FlowControl(std::make_shared<FlowCredits>(0, false));
+        Nan::AsyncQueueWorker(worker);
+    }
+
+    /// runBatched(n, batch, callback)
+    static NAN_METHOD(RunBatched) {
+        if (info.Length() != 3) {
+            info.GetIsolate()->ThrowException(Nan::TypeError("Wrong number of arguments"));
+            return;
+        }
+        if (!info[0]->IsNumber() || !info[1]->IsNumber() || !info[2]->IsFunction()) {
+            info.GetIsolate()->ThrowException(Nan::TypeError("Arguments must be number, number and function"));
+            return;
+        }
+
+        auto thing = Nan::ObjectWrap::Unwrap<EmittingThing>(info.Holder());
+        Nan::AsyncQueueWorker(new TestBatchWorker(new Nan::Callback(info[2].As<Function>()), thing->emitter_,
+                                                  info[0]->Uint32Value(), info[1]->Uint32Value()));
+    }
+
+    /// runBlocking(n, callback)
+    static NAN_METHOD(RunBlocking) {
+        if (info.Length() != 2) {
+            info.GetIsolate()->ThrowException(Nan::TypeError("Wrong number of arguments"));
+            return;
+        }
+        if (!info[0]->IsNumber() || !info[1]->IsFunction()) {
+            info.GetIsolate()->ThrowException(Nan::TypeError("Arguments must be number and function"));
+            return;
+        }
+
+        auto thing = Nan::ObjectWrap::Unwrap<EmittingThing>(info.Holder());
+        Nan::AsyncQueueWorker(new TestBlockingWorker(new Nan::Callback(info[1].As<Function>()), thing->emitter_,
+                                                     info[0]->Uint32Value()));
+    }
+
+    /// runBlockingStarved(timeout_ms, callback)
+    static NAN_METHOD(RunBlockingStarved) {
+        if (info.Length() != 2) {
+            info.GetIsolate()->ThrowException(Nan::TypeError("Wrong number of arguments"));
+            return;
+        }
+        if (!info[0]->IsNumber() || !info[1]->IsFunction()) {
+            info.GetIsolate()->ThrowException(Nan::TypeError("Arguments must be number and function"));
+            return;
+        }
+
+        auto thing = Nan::ObjectWrap::Unwrap<EmittingThing>(info.Holder());
+        auto worker = new TestStarvedBlockingWorker(new Nan::Callback(info[1].As<Function>()), thing->emitter_,
+                                                    info[0]->Int32Value());
+        worker->FlowControl(std::make_shared<FlowCredits>(0));
+        Nan::AsyncQueueWorker(worker);
+    }
+
+    /// runTyped(n, callback); also counts the 'progress' values with a typed inline listener, under
+    /// nativeCount('progress', true)
+    static NAN_METHOD(RunTyped) {
+        if (info.Length() != 2) {
+            info.GetIsolate()->ThrowException(Nan::TypeError("Wrong number of arguments"));
+            return;
+        }
+        if (!info[0]->IsNumber() || !info[1]->IsFunction()) {
+            info.GetIsolate()->ThrowException(Nan::TypeError("Arguments must be number and function"));
+            return;
+        }
+
+        auto thing = Nan::ObjectWrap::Unwrap<EmittingThing>(info.Holder());
+        uint32_t n = info[0]->Uint32Value();
+        auto counter = std::make_shared<std::atomic<uint32_t>>(0);
+        thing->native_counters_[counterKey(Progress::name(), true)] = counter;
+        // counts only the values that come back as sent
+        auto next = std::make_shared<uint32_t>(0);
+        thing->emitter_->onNative<Progress>(
+            [counter, next](const double& value) {
+                if (value == *next / 2.0) {
+                    ++*counter;
+                }
+                ++*next;
+            },
+            EventEmitter::NativeDispatch::Inline);
+        Nan::AsyncQueueWorker(new TestTypedWorker(new Nan::Callback(info[1].As<Function>()), thing->emitter_, n));
+    }
+
+    /// runFlowControlled(n, credits, replenish, park, callback); without parking, the worker retries throttled events
+    static NAN_METHOD(RunFlowControlled) {
+        if (info.Length() != 5) {
+            info.GetIsolate()->ThrowException(Nan::TypeError("Wrong number of arguments"));
+            return;
+        }
+        if (!info[0]->IsNumber() || !info[1]->IsNumber() || !info[2]->IsBoolean() || !info[3]->IsBoolean() ||
+            !info[4]->IsFunction()) {
+            info.GetIsolate()->ThrowException(
+                Nan::TypeError("Arguments must be number, number, boolean, boolean and function"));
+            return;
+        }
+
+        auto thing = Nan::ObjectWrap::Unwrap<EmittingThing>(info.Holder());
+        thing->credits_ = std::make_shared<FlowCredits>(info[1]->IntegerValue(), info[3]->BooleanValue());
+        auto worker = new TestWorker(new Nan::Callback(info[4].As<Function>()), thing->emitter_, info[0]->Int32Value());
+        worker->FlowControl(thing->credits_, info[2]->BooleanValue());
+        Nan::AsyncQueueWorker(worker);
+    }
+
+    /// runSampledThrottled(n, credits, callback); 'test' is sampled 1-in-2, and the credits don't park
+    static NAN_METHOD(RunSampledThrottled) {
+        if (info.Length() != 3) {
+            info.GetIsolate()->ThrowException(Nan::TypeError("Wrong number of arguments"));
+            return;
+        }
+        if (!info[0]->IsNumber() || !info[1]->IsNumber() || !info[2]->IsFunction()) {
+            info.GetIsolate()->ThrowException(Nan::TypeError("Arguments must be number, number and function"));
+            return;
+        }
+
+        auto thing = Nan::ObjectWrap::Unwrap<EmittingThing>(info.Holder());
+        auto worker = new TestWorker(new Nan::Callback(info[2].As<Function>()), thing->emitter_, info[0]->Int32Value());
+        worker->sample("test", 2);
+        worker->FlowControl(std::make_shared<FlowCredits>(info[1]->IntegerValue(), false));
+        Nan::AsyncQueueWorker(worker);
+    }
+
+    /// stream(name, highWaterMark) -> a StreamThing; workers started by runStreamed are paced by the latest one
+    static NAN_METHOD(Stream) {
+        if (info.Length() != 2 || !info[0]->IsString() || !info[1]->IsNumber()) {
+            info.GetIsolate()->ThrowException(Nan::TypeError("Arguments must be string and number"));
+            return;
+        }
+        auto name = std::string(*v8::String::Utf8Value(info[0]->ToString()));
+        auto thing = Nan::ObjectWrap::Unwrap<EmittingThing>(info.Holder());
+        auto stream = new EventStream(thing->emitter_, name, info[1]->Uint32Value());
+        thing->credits_ = stream->credits();
+        info.GetReturnValue().Set(StreamThing::NewInstance(stream));
+    }
+
+    /// runStreamed(n, callback)
+    static NAN_METHOD(RunStreamed) {
+        if (info.Length() != 2 || !info[0]->IsNumber() || !info[1]->IsFunction()) {
+            info.GetIsolate()->ThrowException(Nan::TypeError("Arguments must be number and function"));
+            return;
+        }
+        auto thing = Nan::ObjectWrap::Unwrap<EmittingThing>(info.Holder());
+        auto worker = new TestWorker(new Nan::Callback(info[1].As<Function>()), thing->emitter_, info[0]->Int32Value());
+        if (thing->credits_) {
+            worker->FlowControl(thing->credits_);
+        }
+        Nan::AsyncQueueWorker(worker);
+    }
+
+    static NAN_METHOD(GrantCredits) {
+        if (info.Length() != 1 || !info[0]->IsNumber()) {
+            info.GetIsolate()->ThrowException(Nan::TypeError("First argument must be number"));
+            return;
+        }
+        auto thing = Nan::ObjectWrap::Unwrap<EmittingThing>(info.Holder());
+        if (thing->credits_) {
+            thing->credits_->grant(info[0]->IntegerValue());
+        }
+    }
+
+    /// runCancellable(callback)
+    static NAN_METHOD(RunCancellable) {
+        if (info.Length() != 1 || !info[0]->IsFunction()) {
+            info.GetIsolate()->ThrowException(Nan::TypeError("First argument must be function"));
+            return;
+        }
+        auto thing = Nan::ObjectWrap::Unwrap<EmittingThing>(info.Holder());
+        Nan::AsyncQueueWorker(new TestCancellableWorker(new Nan::Callback(info[0].As<Function>()), thing->emitter_));
+    }
+
+    /// runRetrying(n, callback)
+    static NAN_METHOD(RunRetrying) {
+        if (info.Length() != 2) {
+            info.GetIsolate()->ThrowException(Nan::TypeError("Wrong number of arguments"));
+            return;
+        }
+        if (!info[0]->IsNumber() || !info[1]->IsFunction()) {
+            info.GetIsolate()->ThrowException(Nan::TypeError("Arguments must be number and function"));
+            return;
+        }
+
+        auto thing = Nan::ObjectWrap::Unwrap<EmittingThing>(info.Holder());
+        Nan::AsyncQueueWorker(new TestRetryingWorker(new Nan::Callback(info[1].As<Function>()), thing->emitter_,
+                                                     info[0]->Uint32Value()));
+    }
+
+    static NAN_METHOD(Cancel) {
+        auto thing = Nan::ObjectWrap::Unwrap<EmittingThing>(info.Holder());
+        thing->emitter_->cancel();
+    }
+
+    static NAN_METHOD(RunSpilled) {
+        if (info.Length() != 3) {
+            info.GetIsolate()->ThrowException(Nan::TypeError("Wrong number of arguments"));
+            return;
+        }
+        if (!info[0]->IsNumber() || !info[1]->IsString() || !info[2]->IsFunction()) {
+            info.GetIsolate()->ThrowException(Nan::TypeError("Arguments must be number, string and function"));
+            return;
+        }
+
+        int32_t n = info[0]->Int32Value();
+        auto directory = std::string(*v8::String::Utf8Value(info[1]->ToString()));
+        auto thing = Nan::ObjectWrap::Unwrap<EmittingThing>(info.Holder());
+
+        TestWorker* worker = new TestWorker(new Nan::Callback(info[2].As<Function>()), thing->emitter_, n);
+        try {
+            // small segments, so that a test spans several
+            worker->SpillToDisk(directory, 4096);
+        } catch (const std::system_error& e) {
+            // closes the worker's async handle, then deletes it
+            worker->Destroy();
+            info.GetIsolate()->ThrowException(Nan::Error(e.what()));
+            return;
+        }
+        Nan::AsyncQueueWorker(worker);
+    }
+
+    static NAN_METHOD(StartCapture) {
+        if (info.Length() != 1 || !info[0]->IsString()) {
+            info.GetIsolate()->ThrowException(Nan::TypeError("First argument must be string"));
+            return;
+        }
+        auto path = std::string(*v8::String::Utf8Value(info[0]->ToString()));
+        auto thing = Nan::ObjectWrap::Unwrap<EmittingThing>(info.Holder());
+        try {
+            thing->emitter_->startCapture(std::make_shared<EventLog::Writer>(path));
+        } catch (const std::system_error& e) {
+            info.GetIsolate()->ThrowException(Nan::Error(e.what()));
+        }
+    }
+
+    static NAN_METHOD(StopCapture) {
+        auto thing = Nan::ObjectWrap::Unwrap<EmittingThing>(info.Holder());
+        thing->emitter_->stopCapture();
+    }
+
+    /// replay(path, speed, callback)
+    static NAN_METHOD(Replay) {
+        if (info.Length() != 3) {
+            info.GetIsolate()->ThrowException(Nan::TypeError("Wrong number of arguments"));
+            return;
+        }
+        if (!info[0]->IsString() || !info[1]->IsNumber() || !info[2]->IsFunction()) {
+            info.GetIsolate()->ThrowException(Nan::TypeError("Arguments must be string, number and function"));
+            return;
+        }
+
+        auto path = std::string(*v8::String::Utf8Value(info[0]->ToString()));
+        auto thing = Nan::ObjectWrap::Unwrap<EmittingThing>(info.Holder());
+        auto worker = new AsyncEventLogReplayWorker<16>(new Nan::Callback(info[2].As<Function>()), thing->emitter_,
+                                                        path, info[1]->NumberValue());
+        Nan::AsyncQueueWorker(worker);
+    }
+
+#ifdef __cpp_impl_coroutine
+    /// runCoroutines(tasks, n, callback)
+    static NAN_METHOD(RunCoroutines) {
+        if (info.Length() != 3) {
+            info.GetIsolate()->ThrowException(Nan::TypeError("Wrong number of arguments"));
+            return;
+        }
+        if (!info[0]->IsNumber() || !info[1]->IsNumber() || !info[2]->IsFunction()) {
+            info.GetIsolate()->ThrowException(Nan::TypeError("Arguments must be number, number and function"));
+            return;
+        }
+
+        auto thing = Nan::ObjectWrap::Unwrap<EmittingThing>(info.Holder());
+        auto worker = new AsyncEventEmittingCoroutineWorker<4>(new Nan::Callback(info[2].As<Function>()),
+                                                               thing->emitter_);
+        for (size_t task = 0; task < info[0]->Uint32Value(); ++task) {
+            worker->Spawn(testTask(task, info[1]->Uint32Value()));
+        }
+        Nan::AsyncQueueWorker(worker);
+    }
+#endif
+
+#ifdef __linux__
+    /// listenShared(name) -> the ring's eventfd
+    static NAN_METHOD(ListenShared) {
+        if (info.Length() != 1 || !info[0]->IsString()) {
+            info.GetIsolate()->ThrowException(Nan::TypeError("First argument must be string"));
+            return;
+        }
+        auto name = std::string(*v8::String::Utf8Value(info[0]->ToString()));
+        auto thing = Nan::ObjectWrap::Unwrap<EmittingThing>(info.Holder());
+        if (thing->shared_) {
+            info.GetIsolate()->ThrowException(Nan::Error("Already listening"));
+            return;
+        }
+        try {
+            thing->shared_ = new SharedMemoryEventSource(thing->emitter_, name);
+        } catch (const std::system_error& e) {
+            info.GetIsolate()->ThrowException(Nan::Error(e.what()));
+            return;
+        }
+        info.GetReturnValue().Set(Nan::New<v8::Number>(thing->shared_->fd()));
+    }
+
+    static NAN_METHOD(CloseShared) {
+        auto thing = Nan::ObjectWrap::Unwrap<EmittingThing>(info.Holder());
+        if (thing->shared_) {
+            thing->shared_->close();
+            thing->shared_ = nullptr;
+        }
+    }
+
+    /// runSharedProducer(name, fd, n, callback)
+    static NAN_METHOD(RunSharedProducer) {
+        if (info.Length() != 4) {
+            info.GetIsolate()->ThrowException(Nan::TypeError("Wrong number of arguments"));
+            return;
+        }
+        if (!info[0]->IsString() || !info[1]->IsNumber() || !info[2]->IsNumber() || !info[3]->IsFunction()) {
+            info.GetIsolate()->ThrowException(Nan::TypeError("Arguments must be string, number, number and function"));
+            return;
+        }
+        auto name = std::string(*v8::String::Utf8Value(info[0]->ToString()));
+        Nan::AsyncQueueWorker(new TestSharedMemoryProducer(new Nan::Callback(info[3].As<Function>()), name,
+                                                           info[1]->Int32Value(), info[2]->Uint32Value()));
+    }
+#endif
+
+    static NAN_METHOD(RemoveAllListeners) {
+        if (info.Length() > 1) {
+            info.GetIsolate()->ThrowException(Nan::TypeError("Wrong number of arguments"));
+            return;
+        }
+        auto thing = Nan::ObjectWrap::Unwrap<EmittingThing>(info.Holder());
+
+        if (info.Length() == 1) {
+            if (!info[0]->IsString()) {
+                info.GetIsolate()->ThrowException(Nan::TypeError("First argument must be string name of an event"));
+                return;
+            }
+            auto ev = std::string(*v8::String::Utf8Value(info[0]->ToString()));
+            thing->emitter_->removeAllListenersForEvent(ev);
+        } else {
+            thing->emitter_->removeAllListeners();
+        }
+    }
+
+    static NAN_METHOD(EventNames) {
+        if (info.Length() > 0) {
+            info.GetIsolate()->ThrowException(Nan::TypeError("Wrong number of arguments"));
+            return;
+        }
+        auto thing = Nan::ObjectWrap::Unwrap<EmittingThing>(info.Holder());
+        v8::Local<v8::Array> v = v8::Array::New(info.GetIsolate());
+
+        size_t i = 0; 
+        for (auto s : thing->emitter_->eventNames()) {
+            v->Set(i++, v8::String::NewFromUtf8(info.GetIsolate(), s.c_str()));
+        }
+
+        info.GetReturnValue().Set(v);
+    }
+
+
+    /// retain(name, n)
+    /// emit(ev, value) -> whether the event has listeners; dispatched straight away, as from the loop thread
+    static NAN_METHOD(Emit) {
+        if (info.Length() != 2) {
+            info.GetIsolate()->ThrowException(Nan::TypeError("Wrong number of arguments"));
+            return;
+        }
+        if (!info[0]->IsString() || !info[1]->IsString()) {
+            info.GetIsolate()->ThrowException(Nan::TypeError("Arguments must be strings"));
+            return;
+        }
+
+        auto thing = Nan::ObjectWrap::Unwrap<EmittingThing>(info.Holder());
+        info.GetReturnValue().Set(thing->emitter_->emit(*v8::String::Utf8Value(info[0]->ToString()),
+                                                        *v8::String::Utf8Value(info[1]->ToString())));
+    }
+
+    static NAN_METHOD(Retain) {
+        if (info.Length() != 2) {
+            info.GetIsolate()->ThrowException(Nan::TypeError("Wrong number of arguments"));
+            return;
+        }
+        if (!info[0]->IsString() || !info[1]->IsNumber()) {
+            info.GetIsolate()->ThrowException(Nan::TypeError("Arguments must be string and number"));
+            return;
+        }
+
+        auto thing = Nan::ObjectWrap::Unwrap<EmittingThing>(info.Holder());
+        thing->emitter_->retain(*v8::String::Utf8Value(info[0]->ToString()), info[1]->Uint32Value());
+    }
+
+    static NAN_METHOD(DropUnheard) {
+        if (info.Length() != 1 || !info[0]->IsBoolean()) {
+            info.GetIsolate()->ThrowException(Nan::TypeError("First argument must be boolean"));
+            return;
+        }
+        auto thing = Nan::ObjectWrap::Unwrap<EmittingThing>(info.Holder());
+        thing->emitter_->dropUnheard(info[0]->BooleanValue());
+    }
+
+    static NAN_METHOD(OnNativeCounter) {
+        if (info.Length() != 2) {
+            info.GetIsolate()->ThrowException(Nan::TypeError("Wrong number of arguments"));
+            return;
+        }
+        if (!info[0]->IsString()) {
+            info.GetIsolate()->ThrowException(Nan::TypeError("First argument must be string"));
+            return;
+        }
+        if (!info[1]->IsBoolean()) {
+            info.GetIsolate()->ThrowException(Nan::TypeError("Second argument must be boolean"));
+            return;
+        }
+
+        auto s = std::string(*v8::String::Utf8Value(info[0]->ToString()));
+        bool inlined = info[1]->BooleanValue();
+        auto thing = Nan::ObjectWrap::Unwrap<EmittingThing>(info.Holder());
+        auto counter = std::make_shared<std::atomic<uint32_t>>(0);
+        thing->native_counters_[counterKey(s, inlined)] = counter;
+
+        if (inlined) {
+            thing->emitter_->onNative(s, countEvent, counter.get(), EventEmitter::NativeDispatch::Inline);
+        } else {
+            thing->emitter_->onNative(s, [counter](const char* ev, const char* value) { ++*counter; });
+        }
+    }
+
+    static NAN_METHOD(NativeCount) {
+        if (info.Length() != 2) {
+            info.GetIsolate()->ThrowException(Nan::TypeError("Wrong number of arguments"));
+            return;
+        }
+        if (!info[0]->IsString()) {
+            info.GetIsolate()->ThrowException(Nan::TypeError("First argument must be string"));
+            return;
+        }
+
+        auto s = std::string(*v8::String::Utf8Value(info[0]->ToString()));
+        auto thing = Nan::ObjectWrap::Unwrap<EmittingThing>(info.Holder());
+        auto it = thing->native_counters_.find(counterKey(s, info[1]->BooleanValue()));
+        uint32_t n = it == thing->native_counters_.end() ? 0 : it->second->load();
+
+        info.GetReturnValue().Set(n);
+    }
+
+    static NAN_METHOD(Stats) {
+        if (info.Length() > 0) {
+            info.GetIsolate()->ThrowException(Nan::TypeError("Wrong number of arguments"));
+            return;
+        }
+        auto thing = Nan::ObjectWrap::Unwrap<EmittingThing>(info.Holder());
+        auto stats = thing->emitter_->stats();
+
+        v8::Local<v8::Object> queue = Nan::New<v8::Object>();
+        Nan::Set(queue, Nan::New("enqueued").ToLocalChecked(), Nan::New<v8::Number>(stats.queue.enqueued));
+        Nan::Set(queue, Nan::New("overflowed").ToLocalChecked(), Nan::New<v8::Number>(stats.queue.overflowed));
+        Nan::Set(queue, Nan::New("dropped").ToLocalChecked(), Nan::New<v8::Number>(stats.queue.dropped));
+        Nan::Set(queue, Nan::New("highWater").ToLocalChecked(), Nan::New<v8::Number>(stats.queue.high_water));
+        Nan::Set(queue, Nan::New("drains").ToLocalChecked(), Nan::New<v8::Number>(stats.queue.drains));
+        Nan::Set(queue, Nan::New("drained").ToLocalChecked(), Nan::New<v8::Number>(stats.queue.drained));
+        Nan::Set(queue, Nan::New("maxDrained").ToLocalChecked(), Nan::New<v8::Number>(stats.queue.max_drained));
+        Nan::Set(queue, Nan::New("wakeup").ToLocalChecked(), Latency(stats.queue.wakeup));
+
+        v8::Local<v8::Object> events = Nan::New<v8::Object>();
+        for (const auto& e : stats.events) {
+            v8::Local<v8::Object> o = Nan::New<v8::Object>();
+            Nan::Set(o, Nan::New("emitted").ToLocalChecked(), Nan::New<v8::Number>(e.emitted));
+            Nan::Set(o, Nan::New("dispatched").ToLocalChecked(), Nan::New<v8::Number>(e.dispatched));
+            Nan::Set(o, Nan::New("calls").ToLocalChecked(), Nan::New<v8::Number>(e.calls));
+            Nan::Set(o, Nan::New("queueWait").ToLocalChecked(), Latency(e.queue_wait));
+            Nan::Set(o, Nan::New("listener").ToLocalChecked(), Latency(e.listener));
+            Nan::Set(events, Nan::New(e.name).ToLocalChecked(), o);
+        }
+
+        v8::Local<v8::Object> result = Nan::New<v8::Object>();
+        Nan::Set(result, Nan::New("queue").ToLocalChecked(), queue);
+        Nan::Set(result, Nan::New("events").ToLocalChecked(), events);
+        info.GetReturnValue().Set(result);
+    }
+
+    /// @returns the summary of a latency histogram, in microseconds
+    static v8::Local<v8::Object> Latency(const LatencyHistogram::Summary& summary) {
+        v8::Local<v8::Object> o = Nan::New<v8::Object>();
+        Nan::Set(o, Nan::New("count").ToLocalChecked(), Nan::New<v8::Number>(summary.count));
+        Nan::Set(o, Nan::New("p50").ToLocalChecked(), Nan::New<v8::Number>(summary.p50 / 1e3));
+        Nan::Set(o, Nan::New("p99").ToLocalChecked(), Nan::New<v8::Number>(summary.p99 / 1e3));
+        Nan::Set(o, Nan::New("p999").ToLocalChecked(), Nan::New<v8::Number>(summary.p999 / 1e3));
+        Nan::Set(o, Nan::New("max").ToLocalChecked(), Nan::New<v8::Number>(summary.max / 1e3));
+        return o;
+    }
+
+    static NAN_METHOD(ResetStats) {
+        auto thing = Nan::ObjectWrap::Unwrap<EmittingThing>(info.Holder());
+        thing->emitter_->resetStats();
+    }
+
+    static NAN_METHOD(ProfileListeners) {
+        if (info.Length() != 1 || !info[0]->IsBoolean()) {
+            info.GetIsolate()->ThrowException(Nan::TypeError("First argument must be boolean"));
+            return;
+        }
+        auto thing = Nan::ObjectWrap::Unwrap<EmittingThing>(info.Holder());
+        thing->emitter_->profileListeners(info[0]->BooleanValue());
+    }
+
+    static NAN_METHOD(TopListeners) {
+        if (info.Length() != 1 || !info[0]->IsNumber()) {
+            info.GetIsolate()->ThrowException(Nan::TypeError("First argument must be number"));
+            return;
+        }
+        auto thing = Nan::ObjectWrap::Unwrap<EmittingThing>(info.Holder());
+        v8::Local<v8::Array> v = v8::Array::New(info.GetIsolate());
+
+        size_t i = 0;
+        for (auto& p : thing->emitter_->topListeners(info[0]->Uint32Value())) {
+            v8::Local<v8::Object> o = Nan::New<v8::Object>();
+            Nan::Set(o, Nan::New("event").ToLocalChecked(), Nan::New(p.event).ToLocalChecked());
+            Nan::Set(o, Nan::New("name").ToLocalChecked(), Nan::New(p.name).ToLocalChecked());
+            Nan::Set(o, Nan::New("source").ToLocalChecked(), Nan::New(p.source).ToLocalChecked());
+            Nan::Set(o, Nan::New("line").ToLocalChecked(), Nan::New<v8::Number>(p.line));
+            Nan::Set(o, Nan::New("column").ToLocalChecked(), Nan::New<v8::Number>(p.column));
+            Nan::Set(o, Nan::New("calls").ToLocalChecked(), Nan::New<v8::Number>(p.calls));
+            // in microseconds, like the latencies in stats()
+            Nan::Set(o, Nan::New("total").ToLocalChecked(), Nan::New<v8::Number>(p.total_ns / 1e3));
+            Nan::Set(o, Nan::New("max").ToLocalChecked(), Nan::New<v8::Number>(p.max_ns / 1e3));
+            v->Set(i++, o);
+        }
+
+        info.GetReturnValue().Set(v);
+    }
 
     static NAN_METHOD(RunReentrant) {
         Nan::Callback* fn(nullptr);
@@ -200,8 +1315,21 @@ class EmittingThing : public Nan::ObjectWrap {
         info.GetReturnValue().Set(info.This());
     }
 
-    std::shared_ptr<NodeEvent::EventEmitter> emitter_;
+    std::shared_ptr<NodeEvent::TypedEventEmitter<TestSchema>> emitter_;
+    std::unordered_map<std::string, std::shared_ptr<std::atomic<uint32_t>>> native_counters_;
+    std::unordered_map<uint32_t, EventEmitter::ListenerHandle> handles_;
+    uint32_t next_handle_;
+    std::vector<ListenerFilter> filters_;
+#ifdef __linux__
+    SharedMemoryEventSource* shared_;
+#else
+    void* shared_;
+#endif
+    std::shared_ptr<FlowCredits> credits_;
 };
 
-NAN_MODULE_INIT(InitAll) { EmittingThing::Init(target); }
+NAN_MODULE_INIT(InitAll) {
+    StreamThing::Init();
+    EmittingThing::Init(target);
+}
 NODE_MODULE(NanObject, InitAll);
@@ -3,6 +3,7 @@ const expect = require('code').expect
 const testRoot = require('path').resolve(__dirname, '..')
 const bindings = require('bindings')({ 'module_root': testRoot, bindings: 'eventemitter' })
 const iterate = require('leakage').iterate
+const events = require('../../events')
 const Promise = global.Promise
 
 describe('Verify EventEmitter', function() {
@@ -44,6 +45,938 @@ describe('Verify EventEmitter', function() {
         })
     })
 
+    describe('Verify single listener removal', function() {
+        it('should remove a listener by its handle', function(done) {
+            let thing = new bindings.EmitterThing()
+            let kept = 0
+            let h = thing.on('test', function(ev) { done(new Error('removed listener was invoked')) })
+            thing.on('test', function(ev) {
+                if (++kept === 10) {
+                    done()
+                }
+            })
+
+            expect(thing.off(h)).to.be.true()
+            expect(thing.off(h)).to.be.false()
+            thing.run(10)
+        })
+
+        it('should invoke the remaining listeners in the order they were added', function(done) {
+            let thing = new bindings.EmitterThing()
+            let order = []
+            let handles = ['a', 'b', 'c', 'd'].map(function(name) {
+                return thing.on('test', function(ev) { order.push(name) })
+            })
+
+            expect(thing.off(handles[0])).to.be.true()
+            thing.run(1, function() {
+                setTimeout(function() {
+                    expect(order).to.equal(['b', 'c', 'd'])
+                    done()
+                }, 0)
+            })
+        })
+
+        it('should drop the event name once its last listener is removed', function(done) {
+            let thing = new bindings.EmitterThing()
+            let h = thing.on('test1', function(ev) { })
+            thing.on('test2', function(ev) { })
+
+            thing.off(h)
+            expect(thing.eventNames()).to.be.equal(['test2'])
+            done()
+        })
+
+        it('should invoke a once listener a single time', function(done) {
+            let thing = new bindings.EmitterThing()
+            let n = 100
+            let calls = 0
+            thing.once('test', function(ev) {
+                expect(ev).to.equal('Test0')
+                ++calls
+            })
+            thing.on('test3', function(ev) {
+                if (ev === 'Test' + (n - 1)) {
+                    expect(calls).to.equal(1)
+                    // the name went with its last listener
+                    expect(thing.eventNames()).to.equal(['test3'])
+                    done()
+                }
+            })
+
+            thing.run(n)
+        })
+
+        it('should allow a listener to remove itself', function(done) {
+            let thing = new bindings.EmitterThing()
+            let n = 100
+            let calls = 0
+            let h = thing.on('test', function(ev) {
+                ++calls
+                expect(thing.off(h)).to.be.true()
+            })
+            thing.on('test3', function(ev) {
+                if (ev === 'Test' + (n - 1)) {
+                    expect(calls).to.equal(1)
+                    done()
+                }
+            })
+
+            thing.run(n)
+        })
+
+        it('should allow a listener to add a listener for the same event, from the next event on', function(done) {
+            let thing = new bindings.EmitterThing()
+            let n = 100
+            let added = []
+            let h = thing.on('test', function(value) {
+                expect(thing.off(h)).to.be.true()
+                thing.on('test', function(v) {
+                    added.push(v)
+                })
+            })
+            thing.on('test3', function(value) {
+                if (value === 'Test' + (n - 1)) {
+                    expect(added.length).to.equal(n - 1)
+                    expect(added[0]).to.equal('Test1')
+                    done()
+                }
+            })
+
+            thing.run(n)
+        })
+
+        it('should allow a listener for an event emitted from a listener to remove an outer listener', function() {
+            let thing = new bindings.EmitterThing()
+            let later = 0
+            thing.on('outer', function() {
+                thing.emit('inner', 'x')
+            })
+            let h = thing.on('outer', function() {
+                ++later
+            })
+            thing.on('inner', function() {
+                thing.off(h)
+            })
+
+            expect(thing.emit('outer', 'x')).to.be.true()
+            expect(thing.emit('outer', 'x')).to.be.true()
+            expect(later).to.equal(0)
+        })
+    })
+
+    describe('Verify native listener filters', function() {
+        it('should only invoke the callback for values with the prefix', function(done) {
+            let thing = new bindings.EmitterThing()
+            let n = 20
+            let seen = []
+            thing.on('test', function(ev) { seen.push(ev) }, { prefix: 'Test1' })
+            thing.on('test3', function(ev) {
+                if (ev === 'Test' + (n - 1)) {
+                    expect(seen).to.equal(['Test1', 'Test10', 'Test11', 'Test12', 'Test13', 'Test14', 'Test15',
+                        'Test16', 'Test17', 'Test18', 'Test19'])
+                    done()
+                }
+            })
+
+            thing.run(n)
+        })
+
+        it('should invoke a sampled callback for one in every n values', function(done) {
+            let thing = new bindings.EmitterThing()
+            let n = 100
+            let seen = []
+            thing.on('test', function(ev) { seen.push(ev) }, { every: 10 })
+            thing.on('test3', function(ev) {
+                if (ev === 'Test' + (n - 1)) {
+                    expect(seen.length).to.equal(10)
+                    expect(seen[1]).to.equal('Test10')
+                    done()
+                }
+            })
+
+            thing.runReentrant(n)
+        })
+
+        it('should sample separately for each listener given the same filter', function(done) {
+            let thing = new bindings.EmitterThing()
+            let n = 10
+            let filter = thing.filter({ every: 2 })
+            let seen = [[], []]
+            for (let i = 0; i < seen.length; i++) {
+                thing.on('test', function(ev) { seen[i].push(ev) }, filter)
+            }
+            thing.on('test3', function(ev) {
+                if (ev === 'Test' + (n - 1)) {
+                    let expected = ['Test0', 'Test2', 'Test4', 'Test6', 'Test8']
+                    expect(seen[0]).to.equal(expected)
+                    expect(seen[1]).to.equal(expected)
+                    done()
+                }
+            })
+
+            thing.run(n)
+        })
+
+        it('should reject invalid filters', function(done) {
+            let thing = new bindings.EmitterThing()
+            expect(() => thing.on('test', function(ev) { }, { regex: '(' })).to.throw(TypeError)
+            expect(() => thing.on('test', function(ev) { }, { bogus: true })).to.throw(TypeError)
+            done()
+        })
+    })
+
+    describe('Verify wildcard subscriptions', function() {
+        it('should invoke a pattern callback for every matching event, with the event name', function(done) {
+            let thing = new bindings.EmitterThing()
+            let n = 100
+            let seen = { test: 0, test2: 0, test3: 0 }
+            thing.on('*', function(value, ev) {
+                expect(ev).to.be.a.string()
+                expect(value).to.equal('Test' + seen[ev]++)
+                if (ev === 'test3' && seen.test3 === n) {
+                    expect(seen).to.equal({ test: n, test2: n, test3: n })
+                    done()
+                }
+            })
+
+            thing.run(n)
+        })
+
+        it('should invoke both exact and pattern callbacks', function(done) {
+            let thing = new bindings.EmitterThing()
+            let n = 100
+            let exact = 0
+            let pattern = 0
+            thing.on('test', function(value) { ++exact })
+            thing.on('**', function(value, ev) {
+                if (ev === 'test') {
+                    ++pattern
+                }
+                if (ev === 'test3' && value === 'Test' + (n - 1)) {
+                    expect(exact).to.equal(n)
+                    expect(pattern).to.equal(n)
+                    done()
+                }
+            })
+
+            thing.runReentrant(n)
+        })
+
+        it('should list and remove patterns like event names', function(done) {
+            let thing = new bindings.EmitterThing()
+            thing.on('solver.*', function(value, ev) { })
+            thing.on('solver.iter', function(value) { })
+
+            thing.removeAllListeners('solver.*')
+            expect(thing.eventNames()).to.be.equal(['solver.iter'])
+            done()
+        })
+    })
+
+    describe('Verify windowed aggregation', function() {
+        it('should deliver summaries which account for every value', function(done) {
+            let thing = new bindings.EmitterThing()
+            let n = 1000
+            let count = 0
+            let sum = 0
+            thing.on('value', function(summary) {
+                let s = JSON.parse(summary)
+                expect(s.count).to.be.above(0)
+                expect(s.min).to.be.most(s.max)
+                count += s.count
+                sum += s.sum
+            })
+
+            thing.runAggregated(n, 100, function() {
+                // the worker completes before its queue is drained (when its handle is closed), so check on the
+                // next turn of the loop
+                setTimeout(function() {
+                    expect(count).to.equal(n)
+                    expect(sum).to.equal(n * (n - 1) / 2)
+                    done()
+                }, 0)
+            })
+        })
+
+        it('should deliver the last window of an event which has gone quiet, while the work runs', function(done) {
+            let thing = new bindings.EmitterThing()
+            let n = 10
+            let count = 0
+            thing.on('value', function(summary) {
+                count += JSON.parse(summary).count
+                if (count === n) {
+                    thing.cancel()
+                }
+            })
+
+            thing.runAggregatedIdle(n, 10, function(err) {
+                // only the timer could have closed the window, as the worker runs until it is cancelled
+                expect(err).to.be.an.error('cancelled')
+                expect(count).to.equal(n)
+                done()
+            })
+        })
+    })
+
+    describe('Verify spilling to disk', function() {
+        it('should deliver every event in order when the queue overflows', function(done) {
+            let thing = new bindings.EmitterThing()
+            let n = 5000
+            let k = 0
+            thing.on('test', function(ev) {
+                expect(ev).to.equal('Test' + k++)
+            })
+
+            thing.runSpilled(n, require('os').tmpdir(), function() {
+                // the worker finishes long before the spilled events have been replayed, and the replay finishes
+                // before the worker's handle is closed
+                let check = setInterval(function() {
+                    if (k < n) {
+                        return
+                    }
+                    clearInterval(check)
+                    let stats = thing.stats()
+                    expect(stats.queue.dropped).to.equal(0)
+                    expect(stats.queue.enqueued + stats.queue.overflowed).to.equal(n)
+                    done()
+                }, 10)
+            })
+        })
+
+        it('should reject a directory it cannot write to', function() {
+            let thing = new bindings.EmitterThing()
+            expect(() => thing.runSpilled(1, '/nonexistent/directory', function() {})).to.throw(Error)
+        })
+    })
+
+    describe('Verify capture and replay', function() {
+        const log = require('path').join(require('os').tmpdir(), 'eventemitter-capture-' + process.pid + '.log')
+
+        after(function() {
+            require('fs').unlinkSync(log)
+        })
+
+        it('should replay a captured stream of events through another emitter', function(done) {
+            let thing = new bindings.EmitterThing()
+            let n = 100
+            thing.on('test', function(ev) {})
+            thing.startCapture(log)
+
+            thing.run(n, function() {
+                thing.stopCapture()
+
+                let replayed = new bindings.EmitterThing()
+                let k = [0, 0]
+                replayed.on('test', function(ev) {
+                    expect(ev).to.equal('Test' + k[0]++)
+                })
+                replayed.on('test3', function(ev) {
+                    expect(ev).to.equal('Test' + k[1]++)
+                })
+                replayed.replay(log, 0, function(err) {
+                    expect(err).to.not.exist()
+                    setTimeout(function() {
+                        // events are captured as emitted, whether or not they had listeners
+                        expect(k).to.equal([n, n])
+                        done()
+                    }, 0)
+                })
+            })
+        })
+
+        it('should capture the values of aggregated events rather than their summaries', function(done) {
+            let thing = new bindings.EmitterThing()
+            let n = 100
+            thing.on('value', function(ev) {})
+            thing.startCapture(log)
+
+            thing.runAggregated(n, 10000, function() {
+                thing.stopCapture()
+
+                let replayed = new bindings.EmitterThing()
+                let values = []
+                replayed.on('value', function(ev) { values.push(ev) })
+                replayed.replay(log, 0, function(err) {
+                    expect(err).to.not.exist()
+                    setTimeout(function() {
+                        expect(values.length).to.equal(n)
+                        for (let i = 0; i < n; i++) {
+                            expect(values[i]).to.equal(String(i))
+                        }
+                        done()
+                    }, 0)
+                })
+            })
+        })
+
+        it('should report a log which cannot be read', function(done) {
+            let thing = new bindings.EmitterThing()
+            thing.replay('/nonexistent/log', 0, function(err) {
+                expect(err).to.be.an.error()
+                done()
+            })
+        })
+    })
+
+    describe('Verify pull-based streams', function() {
+        it('should deliver events in order through an async iterator, pacing the producer', function(done) {
+            let thing = new bindings.EmitterThing()
+            let n = 1000
+            let highWaterMark = 16
+            let stream = events(thing, 'test', { highWaterMark: highWaterMark })
+            let k = 0
+
+            thing.runStreamed(n, function(err) {
+                expect(err).to.not.exist()
+            })
+
+            function step() {
+                return stream.next().then(function(result) {
+                    expect(result.done).to.be.false()
+                    expect(result.value).to.equal('Test' + k++)
+                    if (k < n) {
+                        return step()
+                    }
+                    // only the stream listens to them, so none were queued for the loop thread
+                    expect(thing.stats().events.test.dispatched).to.equal(0)
+                    return stream.return().then(function(result) {
+                        expect(result.done).to.be.true()
+                        return stream.next()
+                    }).then(function(result) {
+                        expect(result.done).to.be.true()
+                    })
+                })
+            }
+            step().then(done, done)
+        })
+
+        it('should end a pending next() once the iterator is returned', function(done) {
+            let thing = new bindings.EmitterThing()
+            let stream = events(thing, 'nothing')
+            stream.next().then(function(result) {
+                expect(result.done).to.be.true()
+                done()
+            }).catch(done)
+            stream.return()
+        })
+    })
+
+    describe('Verify cancellation', function() {
+        it('should stop a running worker and report that it was cancelled', function(done) {
+            let thing = new bindings.EmitterThing()
+            let k = 0
+            thing.on('test', function(value) {
+                expect(value).to.equal('Test' + k++)
+                if (k === 10) {
+                    thing.cancel()
+                }
+            })
+
+            thing.runCancellable(function(err) {
+                expect(err).to.be.an.error('cancelled')
+                expect(k).to.be.least(10)
+                // workers started after the cancellation aren't affected
+                thing.removeAllListeners('test')
+                thing.run(1, function(err) {
+                    expect(err).to.not.exist()
+                    done()
+                })
+            })
+        })
+
+        it('should end a worker retrying with while (!emitter(...)) once cancelled', function(done) {
+            let thing = new bindings.EmitterThing()
+            let n = 100000
+            let k = 0
+            thing.on('test', function() {
+                if (++k === 10) {
+                    thing.cancel()
+                }
+            })
+
+            // the emitter returns EVENTEMITTER_CANCELLED, which isn't 0, so the loop stops retrying
+            thing.run(n, function(err) {
+                expect(err).to.be.an.error('cancelled')
+                expect(k).to.be.below(n)
+                done()
+            })
+        })
+
+        it('should stop a worker retrying through emit_status', function(done) {
+            let thing = new bindings.EmitterThing()
+            let n = 100000
+            let k = 0
+            thing.on('test', function() {
+                if (++k === 10) {
+                    thing.cancel()
+                }
+            })
+
+            thing.runRetrying(n, function(err) {
+                expect(err).to.be.an.error('cancelled')
+                // only what was queued before the cancellation
+                expect(k).to.be.below(n)
+                done()
+            })
+        })
+    })
+
+    describe('Verify coroutine worker', function() {
+        // only built when the addon is compiled as C++20
+        if (!bindings.EmitterThing.prototype.runCoroutines) {
+            return
+        }
+
+        it('should run many tasks on one thread without dropping events', function(done) {
+            let thing = new bindings.EmitterThing()
+            let tasks = 50
+            let n = 100
+            let next = new Array(tasks).fill(0)
+            let k = 0
+            thing.on('test', function(value) {
+                let [task, i] = value.split(':').map(Number)
+                expect(i).to.equal(next[task]++)
+                k++
+            })
+
+            thing.runCoroutines(tasks, n, function(err) {
+                expect(err).to.not.exist()
+                setTimeout(function() {
+                    expect(k).to.equal(tasks * n)
+                    expect(thing.stats().queue.dropped).to.equal(0)
+                    done()
+                }, 0)
+            })
+        })
+    })
+
+    describe('Verify shared memory transport', function() {
+        if (process.platform !== 'linux') {
+            return
+        }
+
+        it('should deliver events from a shared memory producer', function(done) {
+            let thing = new bindings.EmitterThing()
+            let name = '/eventemitter-test-' + process.pid
+            let fd = thing.listenShared(name)
+            let n = 1000
+            let k = 0
+            thing.on('test', function(ev) {
+                expect(ev).to.equal('Test' + k++)
+                if (k === n) {
+                    thing.closeShared()
+                    done()
+                }
+            })
+
+            thing.runSharedProducer(name, fd, n, function(err) {
+                expect(err).to.not.exist()
+            })
+        })
+
+        it('should report a ring which cannot be opened', function(done) {
+            let thing = new bindings.EmitterThing()
+            thing.runSharedProducer('/eventemitter-test-missing', -1, 1, function(err) {
+                expect(err).to.be.an.error()
+                done()
+            })
+        })
+    })
+
+    describe('Verify rate limiting and sampling', function() {
+        it('should deliver only the sampled and rate limited events, and count the rest', function(done) {
+            let thing = new bindings.EmitterThing()
+            let n = 1000
+            let sampled = []
+            let limited = 0
+            let unlimited = 0
+            thing.on('test', function(ev) {
+                sampled.push(ev)
+            })
+            thing.on('test2', function(ev) {
+                limited++
+            })
+            thing.on('test3', function(ev) {
+                unlimited++
+            })
+
+            // 'test' is sampled 1 in 10, 'test2' limited to bursts of 5 at a rate which never refills
+            thing.runLimited(n, 10, 0.001, 5, function(err, counts) {
+                expect(err).to.not.exist()
+                expect(counts.test).to.equal({ admitted: 100, rateLimited: 0, sampledOut: 900 })
+                expect(counts.test2).to.equal({ admitted: 5, rateLimited: 995, sampledOut: 0 })
+                setTimeout(function() {
+                    expect(sampled.length).to.equal(100)
+                    expect(sampled[1]).to.equal('Test10')
+                    expect(limited).to.equal(5)
+                    expect(unlimited).to.equal(n)
+                    done()
+                }, 0)
+            })
+        })
+
+        it('should reject rate limits which are not positive', function(done) {
+            let thing = new bindings.EmitterThing()
+            expect(() => thing.runLimited(10, 1, 0, 1, function() {})).to.throw(RangeError)
+            expect(() => thing.runLimited(10, 1, -5, 1, function() {})).to.throw(RangeError)
+            done()
+        })
+    })
+
+    describe('Verify priority lane', function() {
+        it('should never drop prioritized events, even when the queue is overrun', function(done) {
+            let thing = new bindings.EmitterThing()
+            let n = 10000
+            let errors = []
+            let progress = 0
+            thing.on('test', function(ev) {
+                progress++
+            })
+            thing.on('error', function(ev) {
+                errors.push(ev)
+            })
+
+            thing.runPrioritized(n, function(err) {
+                expect(err).to.not.exist()
+                setTimeout(function() {
+                    expect(errors.length).to.equal(n / 10)
+                    for (let i = 0; i < errors.length; i++) {
+                        expect(errors[i]).to.equal('Test' + i * 10)
+                    }
+                    expect(progress).to.be.at.most(n)
+                    done()
+                }, 0)
+            })
+        })
+    })
+
+    describe('Verify flow control', function() {
+        it('should pace the worker to the loop thread, without dropping', function(done) {
+            let thing = new bindings.EmitterThing()
+            let n = 10000
+            let k = 0
+            thing.on('test', function(ev) {
+                expect(ev).to.equal('Test' + k++)
+            })
+
+            // the queue holds 16, so a window of 8 can never overrun it
+            thing.runFlowControlled(n, 8, true, true, function(err) {
+                expect(err).to.not.exist()
+                setTimeout(function() {
+                    expect(k).to.equal(n)
+                    expect(thing.stats().queue.dropped).to.equal(0)
+                    done()
+                }, 0)
+            })
+        })
+
+        it('should not lose throttled events emitted through the C emitter', function(done) {
+            let thing = new bindings.EmitterThing()
+            let n = 1000
+            let k = 0
+            thing.on('test', function(ev) {
+                expect(ev).to.equal('Test' + k++)
+            })
+
+            // credits which don't park: the C emitter returns 0 for a throttled event, and the code emits it again
+            thing.runFlowControlled(n, 2, true, false, function(err) {
+                expect(err).to.not.exist()
+                setTimeout(function() {
+                    expect(k).to.equal(n)
+                    expect(thing.stats().queue.dropped).to.equal(0)
+                    done()
+                }, 0)
+            })
+        })
+
+        it('should sample a throttled event only once it is emitted again and queued', function(done) {
+            let thing = new bindings.EmitterThing()
+            let n = 1000
+            let k = 0
+            thing.on('test', function(ev) {
+                // a throttled event mustn't move the sampling on, so exactly the even events are delivered
+                expect(ev).to.equal('Test' + 2 * k++)
+            })
+
+            thing.runSampledThrottled(n, 2, function(err) {
+                expect(err).to.not.exist()
+                setTimeout(function() {
+                    expect(k).to.equal(n / 2)
+                    expect(thing.stats().queue.dropped).to.equal(0)
+                    done()
+                }, 0)
+            })
+        })
+
+        it('should park the worker until javascript grants credits', function(done) {
+            let thing = new bindings.EmitterThing()
+            let n = 1000
+            let k = 0
+            thing.on('test', function(ev) {
+                expect(ev).to.equal('Test' + k++)
+                thing.grantCredits(1)
+            })
+
+            // events without listeners aren't queued, and so take no credits
+            thing.runFlowControlled(n, 4, false, true, function(err) {
+                expect(err).to.not.exist()
+                setTimeout(function() {
+                    expect(k).to.equal(n)
+                    expect(thing.stats().queue.dropped).to.equal(0)
+                    done()
+                }, 0)
+            })
+        })
+    })
+
+    describe('Verify batch emit', function() {
+        it('should deliver batches of events in order, a report per batch', function(done) {
+            let thing = new bindings.EmitterThing()
+            let n = 1000
+            let received = { test: [], test2: [], test3: [] }
+            for (let ev of Object.keys(received)) {
+                thing.on(ev, function(value) {
+                    received[ev].push(value)
+                })
+            }
+
+            thing.runBatched(n, 100, function(err) {
+                expect(err).to.not.exist()
+                setTimeout(function() {
+                    expect(received.test.length).to.equal(n)
+                    expect(received.test2.length).to.equal(n / 2)
+                    expect(received.test3.length).to.equal(n / 2)
+                    for (let i = 0; i < n; i++) {
+                        expect(received.test[i]).to.equal('Test' + i)
+                        expect(received[i % 2 === 0 ? 'test2' : 'test3'][Math.floor(i / 2)]).to.equal('Test' + i)
+                    }
+                    // two reports per batch, however many times a full queue made the worker retry
+                    expect(thing.stats().queue.enqueued).to.equal(2 * n / 100)
+                    done()
+                }, 0)
+            })
+        })
+
+        it('should deliver batches of prioritized events without flow control credits', function(done) {
+            let thing = new bindings.EmitterThing()
+            let n = 10
+            let errors = []
+            thing.on('error', function(ev) {
+                errors.push(ev)
+            })
+
+            thing.runPriorityBatched(n, function(err) {
+                expect(err).to.not.exist()
+                setTimeout(function() {
+                    expect(errors.length).to.equal(n)
+                    done()
+                }, 0)
+            })
+        })
+    })
+
+    describe('Verify blocking emit', function() {
+        it('should wait for room in a full queue instead of dropping events', function(done) {
+            let thing = new bindings.EmitterThing()
+            let n = 1000
+            let received = []
+            thing.on('test', function(value) {
+                received.push(value)
+            })
+
+            thing.runBlocking(n, function(err) {
+                expect(err).to.not.exist()
+                setTimeout(function() {
+                    expect(received.length).to.equal(n)
+                    for (let i = 0; i < n; i++) {
+                        expect(received[i]).to.equal('Test' + i)
+                    }
+                    expect(thing.stats().queue.dropped).to.equal(0)
+                    done()
+                }, 0)
+            })
+        })
+
+        it('should give up waiting for a flow control credit at the timeout', function(done) {
+            let thing = new bindings.EmitterThing()
+            thing.on('test', function(value) {
+                done(new Error('throttled event was delivered'))
+            })
+
+            thing.runBlockingStarved(10, function(err) {
+                expect(err).to.not.exist()
+                expect(thing.stats().queue.enqueued).to.equal(0)
+                done()
+            })
+        })
+    })
+
+    describe('Verify retained events', function() {
+        it('should replay the last events to listeners added after they were emitted', function(done) {
+            let thing = new bindings.EmitterThing()
+            let n = 10
+            thing.retain('test', 3)
+
+            thing.run(n, function() {
+                setTimeout(function() {
+                    let received = []
+                    thing.on('test', function(value) {
+                        received.push(value)
+                    })
+                    expect(received).to.equal(['Test7', 'Test8', 'Test9'])
+
+                    let first = []
+                    thing.once('test', function(value) {
+                        first.push(value)
+                    })
+                    expect(first).to.equal(['Test7'])
+
+                    // events that weren't retained aren't replayed
+                    let other = []
+                    thing.on('test2', function(value) {
+                        other.push(value)
+                    })
+                    expect(other).to.equal([])
+                    done()
+                }, 0)
+            })
+        })
+
+        it('should keep the retained events when the listeners are removed', function(done) {
+            let thing = new bindings.EmitterThing()
+            thing.retain('test', 1)
+            thing.on('test', function() {})
+
+            thing.run(5, function() {
+                setTimeout(function() {
+                    thing.removeAllListeners()
+                    let received = []
+                    thing.on('test', function(value) {
+                        received.push(value)
+                    })
+                    expect(received).to.equal(['Test4'])
+                    done()
+                }, 0)
+            })
+        })
+    })
+
+    describe('Verify typed events', function() {
+        it('should deliver events emitted by tag to listeners by name', function(done) {
+            let thing = new bindings.EmitterThing()
+            let n = 1000
+            let received = []
+            thing.on('progress', function(value) {
+                received.push(Number(value))
+            })
+            thing.on('done', function(value) {
+                expect(value).to.equal('')
+                expect(received.length).to.equal(n)
+                for (let i = 0; i < n; i++) {
+                    expect(received[i]).to.equal(i / 2)
+                }
+                expect(thing.nativeCount('progress', true)).to.equal(n)
+                done()
+            })
+
+            thing.runTyped(n, function(err) {
+                expect(err).to.not.exist()
+            })
+        })
+
+        it('should deliver events emitted by tag to listeners added for other names and patterns', function(done) {
+            let thing = new bindings.EmitterThing()
+            let n = 100
+            let progress = 0
+            let matched = []
+            thing.on('progress', function(value) {
+                progress++
+            })
+            thing.on('unrelated', function(value) {
+                throw new Error('unexpected event')
+            })
+            thing.on('*', function(value, ev) {
+                matched.push(ev)
+            })
+            thing.on('done', function(value) {
+                // the listeners for the name itself are called before those for patterns
+                expect(progress).to.equal(n)
+                expect(matched.length).to.equal(n)
+                expect(matched.every(ev => ev === 'progress')).to.be.true()
+                done()
+            })
+
+            thing.runTyped(n, function(err) {
+                expect(err).to.not.exist()
+            })
+        })
+    })
+
+    describe('Verify statistics', function() {
+        it('should count queued reports and dispatched events, and reset them', function(done) {
+            let thing = new bindings.EmitterThing()
+            let n = 100
+            let k = 0
+            thing.on('test', function(ev) { k++ })
+
+            thing.run(n, function() {
+                setTimeout(function() {
+                    let stats = thing.stats()
+                    expect(k).to.equal(n)
+                    expect(stats.queue.enqueued + stats.queue.dropped).to.be.least(n)
+                    expect(stats.queue.drained).to.equal(stats.queue.enqueued)
+                    expect(stats.queue.maxDrained).to.be.least(1)
+                    expect(stats.events.test.emitted).to.be.least(n)
+                    expect(stats.events.test.dispatched).to.equal(stats.queue.drained)
+                    expect(stats.events.test.calls).to.equal(n)
+                    expect(stats.events.test.queueWait.count).to.equal(stats.events.test.dispatched)
+                    expect(stats.events.test.listener.count).to.equal(stats.events.test.dispatched)
+                    expect(stats.events.test.queueWait.p50).to.be.most(stats.events.test.queueWait.p999)
+                    expect(stats.queue.wakeup.count).to.equal(stats.queue.drains)
+
+                    thing.resetStats()
+                    stats = thing.stats()
+                    expect(stats.queue.enqueued).to.equal(0)
+                    expect(stats.events.test.calls).to.equal(0)
+                    done()
+                }, 0)
+            })
+        })
+    })
+
+    describe('Verify listener profiling', function() {
+        it('should rank listeners by the time spent in them', function(done) {
+            let thing = new bindings.EmitterThing()
+            let n = 20
+            thing.profileListeners(true)
+            thing.on('test', function fast(ev) {})
+            thing.on('test2', function slow(ev) {
+                let until = Date.now() + 1
+                while (Date.now() < until) { /* spin */ }
+            })
+
+            thing.run(n, function() {
+                setTimeout(function() {
+                    let top = thing.topListeners(5)
+                    expect(top.length).to.equal(2)
+                    expect(top[0].name).to.equal('slow')
+                    expect(top[0].event).to.equal('test2')
+                    expect(top[0].source).to.endWith('eventemitter.js')
+                    expect(top[0].line).to.be.above(0)
+                    expect(top[0].calls).to.equal(n)
+                    expect(top[0].total).to.be.least(top[0].max)
+                    expect(top[1].name).to.equal('fast')
+                    expect(thing.topListeners(1).length).to.equal(1)
+
+                    thing.resetStats()
+                    expect(thing.topListeners(5).length).to.equal(0)
+                    done()
+                }, 0)
+            })
+        })
+    })
+
     describe('Verify EventEmitter Multi', function() {
         it('should invoke the callbacks for test, test2, and test3', function(done) {
             let thing = new bindings.EmitterThing()
@@ -117,6 +1050,83 @@ describe('Verify EventEmitter', function() {
     })
 
 
+    describe('Verify native listeners', function() {
+        it('should invoke inline and loop native listeners without javascript listeners', function(done) {
+            let thing = new bindings.EmitterThing()
+            let n = 100
+            thing.onNativeCounter('test', true)
+            thing.onNativeCounter('test2', false)
+            thing.on('test3', function(ev) {
+                if (ev === 'Test' + (n - 1)) {
+                    expect(thing.nativeCount('test', true)).to.equal(n)
+                    expect(thing.nativeCount('test2', false)).to.equal(n)
+                    done()
+                }
+            })
+
+            thing.run(n)
+        })
+
+        it('should deliver events to listeners added while they are queued', function(done) {
+            let thing = new bindings.EmitterThing()
+            let n = 10
+            thing.onNativeCounter('test3', true)
+            let received = []
+
+            thing.run(n, function() {
+                setTimeout(function() {
+                    expect(received.length).to.equal(n)
+                    done()
+                }, 0)
+            })
+
+            // hold the loop thread until the worker has emitted everything, then listen before anything is dispatched
+            let deadline = Date.now() + 5000
+            while (thing.nativeCount('test3', true) < n && Date.now() < deadline) { /* do nothing */ }
+            expect(thing.nativeCount('test3', true)).to.equal(n)
+            thing.on('test', function(value) {
+                received.push(value)
+            })
+        })
+
+        it('should drop unheard events at the producer when asked to', function(done) {
+            let thing = new bindings.EmitterThing()
+            let n = 10
+            thing.dropUnheard(true)
+            thing.onNativeCounter('test3', true)
+            thing.retain('test2', n)
+            let received = { test: [], test2: [] }
+
+            thing.run(n, function() {
+                setTimeout(function() {
+                    expect(received.test).to.equal([])
+                    expect(received.test2.length).to.equal(n)
+                    done()
+                }, 0)
+            })
+
+            // hold the loop thread until the worker has emitted everything, then listen before anything is dispatched
+            let deadline = Date.now() + 5000
+            while (thing.nativeCount('test3', true) < n && Date.now() < deadline) { /* do nothing */ }
+            expect(thing.nativeCount('test3', true)).to.equal(n)
+            for (let ev of Object.keys(received)) {
+                thing.on(ev, function(value) {
+                    received[ev].push(value)
+                })
+            }
+        })
+
+        it('should invoke inline native listeners from the reentrant worker', function(done) {
+            let thing = new bindings.EmitterThing()
+            let n = 100
+            thing.onNativeCounter('test', true)
+            thing.runReentrant(n, function() {
+                expect(thing.nativeCount('test', true)).to.equal(n)
+                done()
+            })
+        })
+    })
+
     describe('Verify callback memory is reclaimed, even if callback is not waited on', function() {
         it('Should not increase memory usage over time', function(done) {
             this.timeout(15000)
@@ -0,0 +1,246 @@
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#define CATCH_CONFIG_MAIN
+#include <catch.hpp>
+
+#include "../emit_task.hpp"
+#include "../flow_credits.hpp"
+#include "../progress_queue.hpp"
+
+using namespace std;
+using NodeEvent::EmitTask;
+using NodeEvent::EmitTaskRunner;
+using NodeEvent::Event;
+using NodeEvent::FlowCredits;
+using NodeEvent::ProgressQueue;
+using NodeEvent::QueueStats;
+using NodeEvent::Resumer;
+using NodeEvent::suspend;
+
+/// A Host queueing events as a worker does, with optional flow control, counting how often the runner tries to emit
+/// and waits
+template <size_t SIZE>
+class QueueHost {
+ public:
+    explicit QueueHost(FlowCredits* credits = nullptr)
+        : queue{std::make_shared<QueueStats>()},
+          credits(credits),
+          emitted(),
+          delivered(0),
+          attempts(0),
+          waits(0),
+          cancelled_(false) {}
+
+    bool prioritized(const char*) { return false; }
+    bool writable() { return queue.writable(); }
+
+    int emit(const char* ev, const char* value) {
+        ++attempts;
+        if (cancelled_.load()) {
+            return EVENTEMITTER_CANCELLED;
+        }
+        if (credits && !credits->acquire()) {
+            return EVENTEMITTER_THROTTLED;
+        }
+        static int report = 0;
+        if (!queue.push(&report, 1, 0)) {
+            return EVENTEMITTER_DROPPED;
+        }
+        emitted.push_back(std::string(ev) + "=" + value);
+        ++delivered;
+        return EVENTEMITTER_OK;
+    }
+
+    bool cancelled() { return cancelled_.load(); }
+
+    template <class Ready>
+    bool wait(Ready ready, std::chrono::nanoseconds timeout) {
+        ++waits;
+        return queue.wait(ready, timeout);
+    }
+
+    void cancel() {
+        cancelled_.store(true);
+        queue.wake();
+    }
+
+    ProgressQueue<int, SIZE> queue;
+    FlowCredits* credits;
+    // only read once the runner is done; delivered counts them as it goes
+    std::vector<std::string> emitted;
+    std::atomic<size_t> delivered;
+    std::atomic<size_t> attempts;
+    std::atomic<size_t> waits;
+
+ private:
+    std::atomic<bool> cancelled_;
+};
+
+/// Emits n events "<task>:<i>"
+EmitTask counter(size_t task, size_t n) {
+    for (size_t i = 0; i < n; ++i) {
+        co_yield Event{"test", std::to_string(task) + ":" + std::to_string(i)};
+    }
+}
+
+/// Counts its destruction, as a task's locals are destroyed with it
+struct Destroyed {
+    explicit Destroyed(std::atomic<size_t>& count) : count(count) {}
+    ~Destroyed() { ++count; }
+
+    std::atomic<size_t>& count;
+};
+
+/// Emits n events, then waits to be resumed through the Resumer it hands out, then emits another
+EmitTask waiter(size_t n, std::atomic<Resumer*>& resumer, std::atomic<size_t>& destroyed) {
+    Destroyed guard{destroyed};
+    for (size_t i = 0; i < n; ++i) {
+        co_yield Event{"test", std::to_string(i)};
+    }
+    co_await suspend([&resumer](Resumer resume) { resumer.store(new Resumer(resume)); });
+    co_yield Event{"test", "resumed"};
+}
+
+EmitTask thrower() {
+    co_yield Event{"test", "thrown"};
+    throw std::runtime_error("boom");
+}
+
+TEST_CASE("Verify tasks take turns and emit every event, in order per task") {
+    QueueHost<4096> host;
+    EmitTaskRunner runner{[&host]() { host.queue.wake(); }};
+    runner.spawn(counter(0, 100));
+    runner.spawn(counter(1, 100));
+    runner.spawn(thrower());
+    runner.run(host);
+
+    REQUIRE(201 == host.emitted.size());
+    // the first task has its batch, then the others get their turn
+    REQUIRE("test=0:0" == host.emitted[0]);
+    REQUIRE("test=1:0" == host.emitted[EmitTaskRunner::batch]);
+    REQUIRE("test=thrown" == host.emitted[2 * EmitTaskRunner::batch]);
+    size_t next[] = {0, 0};
+    for (auto& event : host.emitted) {
+        if (event != "test=thrown") {
+            REQUIRE(event == "test=" + std::to_string(event[5] - '0') + ":" + std::to_string(next[event[5] - '0']++));
+        }
+    }
+    REQUIRE(bool(runner.exception()));
+    REQUIRE_THROWS_AS(std::rethrow_exception(runner.exception()), std::runtime_error);
+}
+
+TEST_CASE("Verify tasks wait for room in a full queue, rather than dropping events") {
+    QueueHost<4> host;
+    EmitTaskRunner runner{[&host]() { host.queue.wake(); }};
+    runner.spawn(counter(0, 50));
+    runner.spawn(counter(1, 50));
+
+    std::atomic<bool> done{false};
+    std::thread loop([&host, &done]() {
+        ProgressQueue<int, 4>::Entry entry;
+        while (!done.load()) {
+            std::this_thread::sleep_for(std::chrono::microseconds(100));
+            while (host.queue.pop(entry)) {
+            }
+        }
+    });
+    runner.run(host);
+    done.store(true);
+    loop.join();
+
+    REQUIRE(100 == host.emitted.size());
+    REQUIRE(0 == host.queue.stats().snapshot().dropped);
+    REQUIRE(host.waits.load() > 0);
+    // only attempts which found room: a task never emits into a full queue
+    REQUIRE(100 == host.attempts.load());
+}
+
+TEST_CASE("Verify a throttled task polls for credits rather than spinning") {
+    FlowCredits credits{2, false};
+    QueueHost<4096> host{&credits};
+    EmitTaskRunner runner{[&host]() { host.queue.wake(); }};
+    runner.spawn(counter(0, 10));
+
+    std::thread worker([&runner, &host]() { runner.run(host); });
+    // nothing grants credits for a while, yet the queue has room
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    size_t attempts = host.attempts.load();
+    size_t waits = host.waits.load();
+    // a retry every throttle_poll, not one for every time round the loop
+    REQUIRE(attempts < 200);
+    REQUIRE(waits < 200);
+    REQUIRE(waits > 1);
+
+    credits.grant(8);
+    worker.join();
+    REQUIRE(10 == host.emitted.size());
+}
+
+TEST_CASE("Verify cancelling destroys a task throttled for credits") {
+    FlowCredits credits{3, false};
+    QueueHost<4096> host{&credits};
+    EmitTaskRunner runner{[&host]() { host.queue.wake(); }};
+    std::atomic<size_t> destroyed{0};
+    std::atomic<Resumer*> resumer{nullptr};
+    // throttled after its third event
+    runner.spawn(waiter(5, resumer, destroyed));
+
+    std::thread worker([&runner, &host]() { runner.run(host); });
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    REQUIRE(3 == host.delivered.load());
+    REQUIRE(0 == destroyed.load());
+
+    host.cancel();
+    worker.join();
+    REQUIRE(3 == host.emitted.size());
+    REQUIRE(1 == destroyed.load());
+}
+
+TEST_CASE("Verify cancelling destroys a task waiting for room in a full queue") {
+    QueueHost<2> host;
+    EmitTaskRunner runner{[&host]() { host.queue.wake(); }};
+    std::atomic<size_t> destroyed{0};
+    std::atomic<Resumer*> resumer{nullptr};
+    // nothing pops, so it waits after its second event
+    runner.spawn(waiter(5, resumer, destroyed));
+
+    std::thread worker([&runner, &host]() { runner.run(host); });
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    REQUIRE(2 == host.delivered.load());
+    REQUIRE(0 == destroyed.load());
+
+    host.cancel();
+    worker.join();
+    REQUIRE(2 == host.emitted.size());
+    REQUIRE(1 == destroyed.load());
+    REQUIRE(0 == host.queue.stats().snapshot().dropped);
+}
+
+TEST_CASE("Verify a task suspended when the work is cancelled is destroyed once resumed") {
+    QueueHost<4096> host;
+    EmitTaskRunner runner{[&host]() { host.queue.wake(); }};
+    std::atomic<size_t> destroyed{0};
+    std::atomic<Resumer*> resumer{nullptr};
+    runner.spawn(waiter(1, resumer, destroyed));
+    runner.spawn(counter(1, 1000));
+
+    std::thread worker([&runner, &host]() { runner.run(host); });
+    while (host.delivered.load() < 1001) {
+        std::this_thread::yield();
+    }
+    host.cancel();
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    REQUIRE(0 == destroyed.load());
+
+    (*resumer.load())();
+    worker.join();
+    delete resumer.load();
+    REQUIRE(1 == destroyed.load());
+    REQUIRE(1001 == host.emitted.size());
+}
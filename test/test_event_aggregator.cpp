@@ -0,0 +1,106 @@
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+#define CATCH_CONFIG_MAIN
+#include <catch.hpp>
+
+#include "../event_aggregator.hpp"
+
+using namespace std;
+using NodeEvent::EventAggregator;
+
+TEST_CASE("Verify only configured events with numeric values are aggregated") {
+    EventAggregator agg;
+    std::vector<EventAggregator::Summary> summaries;
+    REQUIRE(true == agg.empty());
+
+    agg.aggregate("gauge", std::chrono::milliseconds(100));
+    REQUIRE(false == agg.empty());
+    REQUIRE(false == agg.fold("other", "1", summaries));
+    REQUIRE(false == agg.fold("gauge", "not a number", summaries));
+    REQUIRE(false == agg.fold("gauge", "1x", summaries));
+    REQUIRE(false == agg.fold("gauge", "nan", summaries));
+    REQUIRE(true == agg.fold("gauge", "1.5", summaries));
+    REQUIRE(true == agg.fold("gauge", NodeEvent::StringHash::of("gauge"), "2", summaries));
+    REQUIRE(false == agg.fold("other", NodeEvent::StringHash::of("other"), "2", summaries));
+    REQUIRE(true == summaries.empty());
+
+    // configuring an event again starts it afresh
+    agg.aggregate("gauge", std::chrono::milliseconds(100));
+    agg.flush(summaries);
+    REQUIRE(true == summaries.empty());
+}
+
+TEST_CASE("Verify flush summarizes the open windows") {
+    EventAggregator agg;
+    std::vector<EventAggregator::Summary> summaries;
+    agg.aggregate("gauge", std::chrono::milliseconds(10000));
+
+    agg.fold("gauge", "1", summaries);
+    agg.fold("gauge", "3", summaries);
+    agg.fold("gauge", "-2", summaries);
+    agg.fold("gauge", "0.5", summaries);
+    REQUIRE(true == summaries.empty());
+
+    agg.flush(summaries);
+    REQUIRE(1 == summaries.size());
+    REQUIRE("gauge" == summaries[0].first);
+    REQUIRE("{\"count\":4,\"sum\":2.5,\"min\":-2,\"max\":3,\"last\":0.5}" == summaries[0].second);
+
+    // the window is empty after flushing
+    summaries.clear();
+    agg.flush(summaries);
+    REQUIRE(true == summaries.empty());
+}
+
+TEST_CASE("Verify a window is summarized by the first fold after it elapses") {
+    EventAggregator agg;
+    std::vector<EventAggregator::Summary> summaries;
+    agg.aggregate("counter", std::chrono::milliseconds(10));
+
+    agg.fold("counter", "1", summaries);
+    agg.fold("counter", "1", summaries);
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    agg.fold("counter", "5", summaries);
+
+    REQUIRE(1 == summaries.size());
+    REQUIRE("{\"count\":2,\"sum\":2,\"min\":1,\"max\":1,\"last\":1}" == summaries[0].second);
+
+    summaries.clear();
+    agg.flush(summaries);
+    REQUIRE(1 == summaries.size());
+    REQUIRE("{\"count\":1,\"sum\":5,\"min\":5,\"max\":5,\"last\":5}" == summaries[0].second);
+}
+
+TEST_CASE("Verify expire summarizes a window once it elapses, without another value") {
+    EventAggregator agg;
+    std::vector<EventAggregator::Summary> summaries;
+    REQUIRE(std::chrono::milliseconds::zero() == agg.shortest());
+    agg.aggregate("gauge", std::chrono::milliseconds(10));
+    agg.aggregate("slow", std::chrono::milliseconds(10000));
+    REQUIRE(std::chrono::milliseconds(10) == agg.shortest());
+
+    agg.fold("gauge", "1", summaries);
+    agg.fold("gauge", "2", summaries);
+    agg.fold("slow", "7", summaries);
+    agg.expire(summaries);
+    REQUIRE(true == summaries.empty());
+
+    // the gauge goes quiet; its window is still closed once it has elapsed, and the slow one is left open
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    agg.expire(summaries);
+    REQUIRE(1 == summaries.size());
+    REQUIRE("gauge" == summaries[0].first);
+    REQUIRE("{\"count\":2,\"sum\":3,\"min\":1,\"max\":2,\"last\":2}" == summaries[0].second);
+
+    // nothing more to close until another value arrives
+    summaries.clear();
+    agg.expire(summaries);
+    REQUIRE(true == summaries.empty());
+
+    agg.flush(summaries);
+    REQUIRE(1 == summaries.size());
+    REQUIRE("slow" == summaries[0].first);
+}
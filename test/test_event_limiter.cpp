@@ -0,0 +1,136 @@
+#include <atomic>
+#include <cmath>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#define CATCH_CONFIG_MAIN
+#include <catch.hpp>
+
+#include "../event_limiter.hpp"
+
+using namespace std;
+using NodeEvent::EventLimiter;
+
+static const uint64_t MS = 1000000;
+
+TEST_CASE("Verify only configured events are limited") {
+    EventLimiter limiter;
+    REQUIRE(true == limiter.empty());
+
+    limiter.sample("debug", 1000);
+    REQUIRE(false == limiter.empty());
+    for (size_t i = 0; i < 100; ++i) {
+        REQUIRE(true == limiter.admit("other"));
+    }
+    REQUIRE(1 == limiter.suppressed().size());
+    REQUIRE("debug" == limiter.suppressed()[0].event);
+}
+
+TEST_CASE("Verify sampling admits every nth event") {
+    EventLimiter limiter;
+    limiter.sample("debug", 10);
+
+    size_t admitted = 0;
+    for (size_t i = 0; i < 100; ++i) {
+        if (limiter.admit("debug")) {
+            REQUIRE(0 == i % 10);
+            ++admitted;
+        }
+    }
+    REQUIRE(10 == admitted);
+
+    auto counts = limiter.suppressed();
+    REQUIRE(10 == counts[0].admitted);
+    REQUIRE(90 == counts[0].sampled_out);
+    REQUIRE(0 == counts[0].rate_limited);
+}
+
+TEST_CASE("Verify rate limits admit bursts, then the sustained rate") {
+    EventLimiter limiter;
+    limiter.rateLimit("debug", 1000, 5);
+    uint64_t now = 1000 * MS;
+
+    // a full bucket admits the burst back to back
+    for (size_t i = 0; i < 5; ++i) {
+        REQUIRE(true == limiter.admit("debug", now));
+    }
+    REQUIRE(false == limiter.admit("debug", now));
+
+    // then one per millisecond
+    REQUIRE(false == limiter.admit("debug", now + MS / 2));
+    REQUIRE(true == limiter.admit("debug", now + MS));
+    REQUIRE(false == limiter.admit("debug", now + MS));
+    REQUIRE(true == limiter.admit("debug", now + 2 * MS));
+
+    // and refills while idle, but no further than the burst
+    now += 1000 * MS;
+    for (size_t i = 0; i < 5; ++i) {
+        REQUIRE(true == limiter.admit("debug", now));
+    }
+    REQUIRE(false == limiter.admit("debug", now));
+
+    auto counts = limiter.suppressed();
+    REQUIRE(12 == counts[0].admitted);
+    REQUIRE(4 == counts[0].rate_limited);
+    REQUIRE(0 == counts[0].sampled_out);
+}
+
+TEST_CASE("Verify rate limits apply to the sampled events") {
+    EventLimiter limiter;
+    limiter.sample("debug", 2);
+    limiter.rateLimit("debug", 1000);
+    uint64_t now = 1000 * MS;
+
+    REQUIRE(true == limiter.admit("debug", now));
+    REQUIRE(false == limiter.admit("debug", now));
+    REQUIRE(false == limiter.admit("debug", now));
+
+    auto counts = limiter.suppressed();
+    REQUIRE(1 == counts.size());
+    REQUIRE(1 == counts[0].admitted);
+    REQUIRE(1 == counts[0].sampled_out);
+    REQUIRE(1 == counts[0].rate_limited);
+}
+
+TEST_CASE("Verify rates which can't be timed are rejected") {
+    EventLimiter limiter;
+    REQUIRE_THROWS_AS(limiter.rateLimit("debug", 0), std::invalid_argument);
+    REQUIRE_THROWS_AS(limiter.rateLimit("debug", -1), std::invalid_argument);
+    REQUIRE_THROWS_AS(limiter.rateLimit("debug", std::nan("")), std::invalid_argument);
+    REQUIRE_THROWS_AS(limiter.rateLimit("debug", 1e-12), std::invalid_argument);
+    REQUIRE_THROWS_AS(limiter.rateLimit("debug", 1, 1e12), std::invalid_argument);
+    // a rejected rate limits nothing
+    REQUIRE(true == limiter.empty());
+    REQUIRE(true == limiter.admit("debug"));
+}
+
+TEST_CASE("Verify every event is counted exactly once across threads") {
+    EventLimiter limiter;
+    limiter.sample("debug", 7);
+    limiter.rateLimit("debug", 1e6, 100);
+
+    const size_t threads = 4;
+    const size_t events = 100000;
+    std::atomic<size_t> admitted{0};
+    std::vector<std::thread> emitters;
+    for (size_t t = 0; t < threads; ++t) {
+        emitters.emplace_back([&limiter, &admitted, events]() {
+            for (size_t i = 0; i < events; ++i) {
+                if (limiter.admit("debug")) {
+                    ++admitted;
+                }
+            }
+        });
+    }
+    for (auto& emitter : emitters) {
+        emitter.join();
+    }
+
+    auto counts = limiter.suppressed();
+    REQUIRE(admitted == counts[0].admitted);
+    REQUIRE(threads * events == counts[0].admitted + counts[0].rate_limited + counts[0].sampled_out);
+    // every 7th is sampled, whatever the interleaving
+    REQUIRE(threads * events / 7 + 1 == counts[0].admitted + counts[0].rate_limited);
+}
@@ -0,0 +1,165 @@
+#include <cstddef>
+#include <cstdio>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+#include <unistd.h>
+
+#define CATCH_CONFIG_MAIN
+#include <catch.hpp>
+
+#include "../event_log.hpp"
+
+using namespace std;
+namespace EventLog = NodeEvent::EventLog;
+
+static const std::string path = "/tmp/test_event_log.bin";
+
+TEST_CASE("Verify records are read back as they were written") {
+    {
+        EventLog::Writer writer{path};
+        EventLog::Report one[] = {{"test", "Test0"}};
+        EventLog::Report two[] = {{"a", ""}, {"b", std::string(1000, 'x')}};
+        writer.write(100, one, 1);
+        writer.write(200, two, 2);
+    }
+
+    EventLog::Reader reader{path};
+    EventLog::Record record;
+    REQUIRE(true == reader.next(record));
+    REQUIRE(100 == record.timestamp);
+    REQUIRE(1 == record.reports.size());
+    REQUIRE("test" == record.reports[0].first);
+    REQUIRE("Test0" == record.reports[0].second);
+    auto thread = record.thread;
+
+    REQUIRE(true == reader.next(record));
+    REQUIRE(200 == record.timestamp);
+    REQUIRE(thread == record.thread);
+    REQUIRE(2 == record.reports.size());
+    REQUIRE("" == record.reports[0].second);
+    REQUIRE(std::string(1000, 'x') == record.reports[1].second);
+
+    REQUIRE(false == reader.next(record));
+    std::remove(path.c_str());
+}
+
+TEST_CASE("Verify records from many threads are written whole") {
+    {
+        EventLog::Writer writer{path};
+        std::vector<std::thread> threads;
+        for (size_t t = 0; t < 4; ++t) {
+            threads.emplace_back([&writer, t]() {
+                for (size_t i = 0; i < 1000; ++i) {
+                    EventLog::Report report[] = {{std::to_string(t), std::to_string(i)}};
+                    writer.write(i, report, 1);
+                }
+            });
+        }
+        for (auto& t : threads) {
+            t.join();
+        }
+    }
+
+    EventLog::Reader reader{path};
+    EventLog::Record record;
+    std::vector<size_t> next(4, 0);
+    size_t n = 0;
+    while (reader.next(record)) {
+        size_t t = std::stoul(record.reports[0].first);
+        REQUIRE(next[t]++ == std::stoul(record.reports[0].second));
+        ++n;
+    }
+    REQUIRE(4000 == n);
+    std::remove(path.c_str());
+}
+
+TEST_CASE("Verify bad logs are rejected") {
+    REQUIRE_THROWS_AS(EventLog::Reader{"/nonexistent/log"}, std::system_error);
+
+    FILE* f = std::fopen(path.c_str(), "wb");
+    std::fputs("not a log", f);
+    std::fclose(f);
+    REQUIRE_THROWS_AS(EventLog::Reader{path}, std::runtime_error);
+
+    {
+        EventLog::Writer writer{path};
+        EventLog::Report report[] = {{"test", "Test0"}};
+        writer.write(1, report, 1);
+    }
+    // cut the last record short
+    f = std::fopen(path.c_str(), "r+b");
+    std::fseek(f, 0, SEEK_END);
+    long size = std::ftell(f);
+    std::fclose(f);
+    REQUIRE(0 == truncate(path.c_str(), size - 1));
+
+    EventLog::Reader reader{path};
+    EventLog::Record record;
+    REQUIRE_THROWS_AS(reader.next(record), std::runtime_error);
+
+    // cut the header of the record short
+    REQUIRE(0 == truncate(path.c_str(), sizeof(EventLog::magic) + sizeof(EventLog::RecordHeader) / 2));
+    EventLog::Reader short_header{path};
+    REQUIRE_THROWS_AS(short_header.next(record), std::runtime_error);
+    std::remove(path.c_str());
+}
+
+/// Overwrite the bytes of a log at offset
+static void corrupt(size_t offset, const void* bytes, size_t size) {
+    FILE* f = std::fopen(path.c_str(), "r+b");
+    std::fseek(f, static_cast<long>(offset), SEEK_SET);
+    std::fwrite(bytes, 1, size, f);
+    std::fclose(f);
+}
+
+TEST_CASE("Verify corrupt records are rejected rather than read beyond") {
+    const size_t record = sizeof(EventLog::magic);
+    const size_t events = record + sizeof(EventLog::RecordHeader);
+    auto write = []() {
+        EventLog::Writer writer{path};
+        EventLog::Report report[] = {{"test", "Test0"}, {"test2", "Test1"}};
+        writer.write(1, report, 2);
+    };
+    EventLog::Record read;
+
+    // an event longer than the record
+    write();
+    uint32_t huge = 1u << 30;
+    corrupt(events, &huge, sizeof(huge));
+    EventLog::Reader long_event{path};
+    REQUIRE_THROWS_AS(long_event.next(read), std::runtime_error);
+
+    // more events than the record holds
+    write();
+    uint32_t count = 1000000;
+    corrupt(record + offsetof(EventLog::RecordHeader, count), &count, sizeof(count));
+    EventLog::Reader many_events{path};
+    REQUIRE_THROWS_AS(many_events.next(read), std::runtime_error);
+
+    // fewer events than the record holds
+    write();
+    count = 1;
+    corrupt(record + offsetof(EventLog::RecordHeader, count), &count, sizeof(count));
+    EventLog::Reader few_events{path};
+    REQUIRE_THROWS_AS(few_events.next(read), std::runtime_error);
+
+    // a record longer than the log
+    write();
+    uint32_t bytes = 1u << 31;
+    corrupt(record + offsetof(EventLog::RecordHeader, bytes), &bytes, sizeof(bytes));
+    EventLog::Reader long_record{path};
+    REQUIRE_THROWS_AS(long_record.next(read), std::runtime_error);
+
+    // and the log is fine as written
+    write();
+    EventLog::Reader reader{path};
+    REQUIRE(true == reader.next(read));
+    REQUIRE(2 == read.reports.size());
+    REQUIRE("test2" == read.reports[1].first);
+    REQUIRE(false == reader.next(read));
+    std::remove(path.c_str());
+}
@@ -0,0 +1,75 @@
+#include <string>
+
+#define CATCH_CONFIG_MAIN
+#include <catch.hpp>
+
+#include "../event_pattern.hpp"
+
+using namespace std;
+using NodeEvent::EventPattern;
+
+TEST_CASE("Verify wildcard detection") {
+    REQUIRE(true == EventPattern::isPattern("solver.*"));
+    REQUIRE(true == EventPattern::isPattern("solver.**"));
+    REQUIRE(true == EventPattern::isPattern("*.iter"));
+    REQUIRE(true == EventPattern::isPattern("*"));
+    REQUIRE(false == EventPattern::isPattern("solver.iter"));
+    REQUIRE(false == EventPattern::isPattern("solver.*x"));
+    REQUIRE(false == EventPattern::isPattern("solver.***"));
+    REQUIRE(false == EventPattern::isPattern(""));
+}
+
+TEST_CASE("Verify literal patterns match only themselves") {
+    EventPattern p{"solver.iter"};
+    REQUIRE(true == p.matches("solver.iter"));
+    REQUIRE(false == p.matches("solver.iter.lp"));
+    REQUIRE(false == p.matches("solver"));
+    REQUIRE(false == p.matches("solver.iteR"));
+}
+
+TEST_CASE("Verify * matches exactly one segment") {
+    EventPattern p{"solver.*"};
+    REQUIRE(true == p.matches("solver.iter"));
+    REQUIRE(true == p.matches("solver."));
+    REQUIRE(false == p.matches("solver"));
+    REQUIRE(false == p.matches("solver.iter.lp"));
+    REQUIRE(false == p.matches("other.iter"));
+
+    EventPattern q{"*.iter.*"};
+    REQUIRE(true == q.matches("solver.iter.lp"));
+    REQUIRE(false == q.matches("solver.iter"));
+}
+
+TEST_CASE("Verify ** matches any number of segments") {
+    EventPattern p{"solver.**"};
+    REQUIRE(true == p.matches("solver"));
+    REQUIRE(true == p.matches("solver.iter"));
+    REQUIRE(true == p.matches("solver.iter.lp"));
+    REQUIRE(false == p.matches("other.iter"));
+
+    EventPattern q{"**.lp"};
+    REQUIRE(true == q.matches("lp"));
+    REQUIRE(true == q.matches("solver.iter.lp"));
+    REQUIRE(false == q.matches("solver.iter.mip"));
+
+    EventPattern r{"solver.**.done"};
+    REQUIRE(true == r.matches("solver.done"));
+    REQUIRE(true == r.matches("solver.iter.lp.done"));
+    REQUIRE(true == r.matches("solver.done.done"));
+    REQUIRE(false == r.matches("solver.done.lp"));
+
+    EventPattern s{"**.*.lp"};
+    REQUIRE(true == s.matches("iter.lp"));
+    REQUIRE(true == s.matches("solver.iter.lp"));
+    REQUIRE(false == s.matches("lp"));
+
+    EventPattern t{"a.**.b.*"};
+    REQUIRE(true == t.matches("a.b.z"));
+    REQUIRE(true == t.matches("a.x.b.y.b.z"));
+    REQUIRE(false == t.matches("a.x.b.y.b"));
+
+    REQUIRE(true == EventPattern{"**"}.matches("anything.at.all"));
+    REQUIRE(true == EventPattern{"**"}.matches(""));
+    REQUIRE(true == EventPattern{"*"}.matches(""));
+    REQUIRE(false == EventPattern{"*"}.matches("."));
+}
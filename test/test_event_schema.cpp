@@ -0,0 +1,62 @@
+#include <cstdint>
+#include <string>
+
+#define CATCH_CONFIG_MAIN
+#include <catch.hpp>
+
+#include "../event_schema.hpp"
+
+using namespace std;
+using NodeEvent::TypedEvent;
+using NodeEvent::EventSchema;
+using NodeEvent::EventValue;
+
+struct Progress : TypedEvent<double> {
+    static const char* name() { return "progress"; }
+};
+struct Done : TypedEvent<void> {
+    static const char* name() { return "done"; }
+};
+struct Iteration : TypedEvent<uint32_t> {
+    static const char* name() { return "solver.iter"; }
+};
+struct Other : TypedEvent<string> {
+    static const char* name() { return "other"; }
+};
+
+typedef EventSchema<Progress, Done, Iteration> Schema;
+
+TEST_CASE("Verify events are numbered in the order they are listed") {
+    static_assert(Schema::size == 3, "three events");
+    static_assert(Schema::index<Progress>() == 0, "progress is first");
+    static_assert(Schema::index<Done>() == 1, "done is second");
+    static_assert(Schema::index<Iteration>() == 2, "solver.iter is third");
+    static_assert(Schema::contains<Done>(), "done is in the schema");
+    static_assert(!Schema::contains<Other>(), "other is not in the schema");
+
+    REQUIRE(string("progress") == Schema::name(0));
+    REQUIRE(string("done") == Schema::name(1));
+    REQUIRE(string("solver.iter") == Schema::name(2));
+}
+
+TEST_CASE("Verify numbers survive encoding") {
+    REQUIRE("42" == EventValue<uint32_t>::encode(42));
+    REQUIRE("-7" == EventValue<int>::encode(-7));
+    REQUIRE(42u == EventValue<uint32_t>::decode("42"));
+    REQUIRE(-7 == EventValue<int>::decode("-7"));
+    REQUIRE(UINT64_MAX == EventValue<uint64_t>::decode(EventValue<uint64_t>::encode(UINT64_MAX).c_str()));
+    REQUIRE(0 == EventValue<int>::decode("x"));
+
+    REQUIRE("0.5" == EventValue<double>::encode(0.5));
+    for (double v : {0.1, 1.0 / 3, -2.5e-300, 1e300}) {
+        REQUIRE(v == EventValue<double>::decode(EventValue<double>::encode(v).c_str()));
+    }
+    REQUIRE(0.1f == EventValue<float>::decode(EventValue<float>::encode(0.1f).c_str()));
+}
+
+TEST_CASE("Verify other values survive encoding") {
+    REQUIRE("" == EventValue<void>::encode());
+    REQUIRE("true" == EventValue<bool>::encode(true));
+    REQUIRE(false == EventValue<bool>::decode(EventValue<bool>::encode(false).c_str()));
+    REQUIRE("a b" == EventValue<string>::decode(EventValue<string>::encode("a b").c_str()));
+}
@@ -0,0 +1,82 @@
+#include <map>
+#include <random>
+#include <string>
+
+#define CATCH_CONFIG_MAIN
+#include <catch.hpp>
+
+#include "../flat_string_map.hpp"
+
+using namespace std;
+using NodeEvent::FlatStringMap;
+using NodeEvent::StringHash;
+
+TEST_CASE("Verify values are found by string and by precomputed hash") {
+    FlatStringMap<int> map;
+    REQUIRE(true == map.empty());
+    REQUIRE(nullptr == map.find("test"));
+
+    REQUIRE(true == map.emplace("test", 1).second);
+    REQUIRE(true == map.emplace("test2", 2).second);
+    auto existing = map.emplace("test", 3);
+    REQUIRE(false == existing.second);
+    REQUIRE(1 == *existing.first);
+    REQUIRE(2 == map.size());
+
+    const char* ev = "test2";
+    uint64_t hash = StringHash::of(ev);
+    REQUIRE(hash == StringHash::of(string(ev)));
+    REQUIRE(nullptr != map.find(ev, hash));
+    REQUIRE(2 == *map.find(ev, hash));
+    REQUIRE(nullptr == map.find("test3"));
+    REQUIRE(nullptr == map.find("tes"));
+}
+
+TEST_CASE("Verify erase keeps colliding keys reachable") {
+    FlatStringMap<int> map;
+    for (int i = 0; i < 10; ++i) {
+        map.emplace("e" + to_string(i), i);
+    }
+    // the keys all fit in the first 16 slots, so some of them share runs
+    for (int i = 0; i < 10; i += 2) {
+        REQUIRE(true == map.erase("e" + to_string(i)));
+    }
+    REQUIRE(false == map.erase("e0"));
+    REQUIRE(5 == map.size());
+    for (int i = 0; i < 10; ++i) {
+        auto value = map.find("e" + to_string(i));
+        if (i % 2 == 0) {
+            REQUIRE(nullptr == value);
+        } else {
+            REQUIRE(nullptr != value);
+            REQUIRE(i == *value);
+        }
+    }
+}
+
+TEST_CASE("Verify the map agrees with std::map through growth and churn") {
+    FlatStringMap<int> map;
+    std::map<string, int> expected;
+    mt19937 rng{42};
+    for (int i = 0; i < 20000; ++i) {
+        string key = "solver." + to_string(rng() % 500);
+        if (rng() % 3 == 0) {
+            REQUIRE(expected.erase(key) == (map.erase(key) ? 1u : 0u));
+        } else {
+            REQUIRE(expected.emplace(key, i).second == map.emplace(key, i).second);
+        }
+    }
+
+    REQUIRE(expected.size() == map.size());
+    size_t visited = 0;
+    for (auto& entry : map) {
+        REQUIRE(expected.at(entry.first) == entry.second);
+        ++visited;
+    }
+    REQUIRE(expected.size() == visited);
+
+    map.clear();
+    REQUIRE(true == map.empty());
+    REQUIRE(map.begin() == map.end());
+    REQUIRE(nullptr == map.find("solver.1"));
+}
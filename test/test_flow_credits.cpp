@@ -0,0 +1,153 @@
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#define CATCH_CONFIG_MAIN
+#include <catch.hpp>
+
+#include "../flow_credits.hpp"
+
+using namespace std;
+using NodeEvent::FlowCredits;
+
+TEST_CASE("Verify credits are taken until they run out") {
+    FlowCredits credits{2, false};
+    REQUIRE(true == credits.acquire());
+    REQUIRE(true == credits.acquire());
+    REQUIRE(false == credits.acquire());
+    REQUIRE(false == credits.tryAcquire());
+    REQUIRE(1 == credits.throttled());
+
+    credits.grant();
+    REQUIRE(1 == credits.available());
+    REQUIRE(true == credits.acquire());
+    REQUIRE(0 == credits.available());
+}
+
+TEST_CASE("Verify consumed credits go into debt, which grants pay off first") {
+    FlowCredits credits{1, false};
+    credits.consume(3);
+    REQUIRE(-2 == credits.available());
+    REQUIRE(false == credits.acquire());
+
+    credits.grant(2);
+    REQUIRE(false == credits.acquire());
+    credits.grant();
+    REQUIRE(true == credits.acquire());
+}
+
+TEST_CASE("Verify closed credits never run out") {
+    FlowCredits credits{0, false};
+    REQUIRE(false == credits.acquire());
+    credits.close();
+    for (size_t i = 0; i < 10; ++i) {
+        REQUIRE(true == credits.acquire());
+    }
+}
+
+TEST_CASE("Verify parked producers resume when credits are granted or closed") {
+    FlowCredits credits{0};
+    std::atomic<size_t> acquired{0};
+    std::vector<std::thread> producers;
+    for (size_t i = 0; i < 4; ++i) {
+        producers.emplace_back([&credits, &acquired]() {
+            credits.acquire();
+            ++acquired;
+        });
+    }
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    REQUIRE(0 == acquired);
+
+    credits.grant();
+    while (acquired < 1) {
+        std::this_thread::yield();
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    REQUIRE(1 == acquired);
+
+    credits.grant(2);
+    while (acquired < 3) {
+        std::this_thread::yield();
+    }
+
+    credits.close();
+    for (auto& producer : producers) {
+        producer.join();
+    }
+    REQUIRE(4 == acquired);
+    REQUIRE(4 == credits.throttled());
+}
+
+TEST_CASE("Verify a parked producer gives up once told to stop and woken") {
+    FlowCredits credits{0};
+    std::atomic<bool> stop{false};
+    std::atomic<int> result{-1};
+    std::thread producer([&credits, &stop, &result]() { result = credits.acquire([&stop]() { return stop.load(); }); });
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    REQUIRE(-1 == result);
+
+    stop = true;
+    credits.wake();
+    producer.join();
+    REQUIRE(0 == result);
+    REQUIRE(0 == credits.available());
+}
+
+TEST_CASE("Verify a parked producer gives up at its timeout, unless granted a credit in time") {
+    FlowCredits credits{0};
+    auto never = []() { return false; };
+    auto started = std::chrono::steady_clock::now();
+    REQUIRE(false == credits.acquire(never, std::chrono::milliseconds(20)));
+    REQUIRE(std::chrono::steady_clock::now() - started >= std::chrono::milliseconds(20));
+    REQUIRE(0 == credits.available());
+    REQUIRE(1 == credits.throttled());
+
+    std::atomic<int> result{-1};
+    std::thread producer([&credits, &never, &result]() { result = credits.acquire(never, std::chrono::seconds(10)); });
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    REQUIRE(-1 == result);
+
+    credits.grant();
+    producer.join();
+    REQUIRE(1 == result);
+    REQUIRE(0 == credits.available());
+}
+
+TEST_CASE("Verify producers never run further ahead than their credits") {
+    const size_t window = 8;
+    const size_t events = 100000;
+    FlowCredits credits{window};
+    std::atomic<int64_t> in_flight{0};
+    std::atomic<int64_t> max_in_flight{0};
+
+    std::vector<std::thread> producers;
+    for (size_t t = 0; t < 2; ++t) {
+        producers.emplace_back([&]() {
+            for (size_t i = 0; i < events; ++i) {
+                credits.acquire();
+                int64_t n = ++in_flight;
+                int64_t max = max_in_flight.load();
+                while (n > max && !max_in_flight.compare_exchange_weak(max, n)) {
+                }
+            }
+        });
+    }
+
+    // the consumer hands a credit back for each event it takes
+    size_t consumed = 0;
+    while (consumed < 2 * events) {
+        if (in_flight.load() > 0) {
+            --in_flight;
+            ++consumed;
+            credits.grant();
+        }
+    }
+    for (auto& producer : producers) {
+        producer.join();
+    }
+    REQUIRE(max_in_flight <= static_cast<int64_t>(window));
+    REQUIRE(window == credits.available());
+}
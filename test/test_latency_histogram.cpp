@@ -0,0 +1,67 @@
+#include <thread>
+#include <vector>
+
+#define CATCH_CONFIG_MAIN
+#include <catch.hpp>
+
+#include "../latency_histogram.hpp"
+
+using namespace std;
+using NodeEvent::LatencyHistogram;
+
+TEST_CASE("Verify buckets cover every value contiguously") {
+    for (size_t b = 0; b + 1 < LatencyHistogram::num_buckets; ++b) {
+        REQUIRE(LatencyHistogram::lowestIn(b) + LatencyHistogram::widthOf(b) == LatencyHistogram::lowestIn(b + 1));
+    }
+    REQUIRE(LatencyHistogram::num_buckets - 1 == LatencyHistogram::bucketFor(LatencyHistogram::max_value));
+}
+
+TEST_CASE("Verify values land in the bucket which holds them") {
+    for (uint64_t v : {0ull, 1ull, 15ull, 16ull, 17ull, 31ull, 32ull, 1000ull, 123456789ull, 1ull << 39}) {
+        size_t b = LatencyHistogram::bucketFor(v);
+        REQUIRE(LatencyHistogram::lowestIn(b) <= v);
+        REQUIRE(v < LatencyHistogram::lowestIn(b) + LatencyHistogram::widthOf(b));
+        // log-linear: a bucket is never wider than 1/16th of the values it holds
+        REQUIRE(LatencyHistogram::widthOf(b) * 16 <= std::max<uint64_t>(16, LatencyHistogram::lowestIn(b)));
+    }
+}
+
+TEST_CASE("Verify percentiles of a uniform distribution") {
+    LatencyHistogram h;
+    REQUIRE(0 == h.percentile(0.5));
+
+    for (uint64_t v = 1; v <= 10000; ++v) {
+        h.record(v * 1000);
+    }
+
+    auto s = h.summary();
+    REQUIRE(10000 == s.count);
+    REQUIRE(10000000 == s.max);
+    REQUIRE(s.p50 == Approx(5000000).epsilon(0.04));
+    REQUIRE(s.p99 == Approx(9900000).epsilon(0.04));
+    REQUIRE(s.p999 == Approx(9990000).epsilon(0.04));
+    REQUIRE(h.percentile(1.0) == Approx(10000000).epsilon(0.04));
+}
+
+TEST_CASE("Verify concurrent recording and reset") {
+    LatencyHistogram h;
+    std::vector<std::thread> threads;
+
+    for (size_t n = 0; n < 4; ++n) {
+        threads.emplace_back([&h]() {
+            for (uint64_t i = 0; i < 10000; ++i) {
+                h.record(i);
+            }
+        });
+    }
+    for (auto& t : threads) {
+        t.join();
+    }
+
+    REQUIRE(40000 == h.count());
+    REQUIRE(9999 == h.summary().max);
+
+    h.reset();
+    REQUIRE(0 == h.count());
+    REQUIRE(0 == h.summary().p999);
+}
@@ -0,0 +1,74 @@
+#include <regex>
+#include <string>
+
+#define CATCH_CONFIG_MAIN
+#include <catch.hpp>
+
+#include "../listener_filter.hpp"
+
+using namespace std;
+using NodeEvent::ListenerFilter;
+
+TEST_CASE("Verify the default filter accepts everything") {
+    ListenerFilter f;
+    REQUIRE(true == f.acceptsAll());
+    REQUIRE(true == f.accept(""));
+    REQUIRE(true == f.accept("anything"));
+}
+
+TEST_CASE("Verify prefix filters") {
+    auto f = ListenerFilter::prefix("ERR");
+    REQUIRE(true == f.accept("ERR: disk full"));
+    REQUIRE(true == f.accept("ERR"));
+    REQUIRE(false == f.accept("ER"));
+    REQUIRE(false == f.accept("WARN: ERR"));
+}
+
+TEST_CASE("Verify regex filters") {
+    auto f = ListenerFilter::regex("^iter [0-9]+0$");
+    REQUIRE(true == f.accept("iter 10"));
+    REQUIRE(false == f.accept("iter 11"));
+    REQUIRE(false == f.accept("done"));
+
+    REQUIRE_THROWS_AS(ListenerFilter::regex("(unbalanced"), std::regex_error);
+}
+
+TEST_CASE("Verify numeric range filters") {
+    auto f = ListenerFilter::range(0.5, 10);
+    REQUIRE(true == f.accept("0.5"));
+    REQUIRE(true == f.accept("10"));
+    REQUIRE(true == f.accept("1e0"));
+    REQUIRE(false == f.accept("0.49"));
+    REQUIRE(false == f.accept("10.01"));
+    REQUIRE(false == f.accept("5 apples"));
+    REQUIRE(false == f.accept(""));
+}
+
+TEST_CASE("Verify sampling filters accept one in n, and mayAccept doesn't count") {
+    auto f = ListenerFilter::sample(3);
+    size_t accepted = 0;
+    for (size_t i = 0; i < 30; ++i) {
+        REQUIRE(true == f.mayAccept("x"));
+        if (f.accept("x")) {
+            ++accepted;
+        }
+    }
+    REQUIRE(10 == accepted);
+
+    // copies share their counter
+    auto g = f;
+    REQUIRE(true == g.accept("x"));
+    REQUIRE(false == f.accept("x"));
+
+    // instances, as each listener is given, count on their own
+    auto a = f.instance();
+    auto b = f.instance();
+    for (size_t i = 0; i < 6; ++i) {
+        REQUIRE((i % 3 == 0) == a.accept("x"));
+        REQUIRE((i % 3 == 0) == b.accept("x"));
+    }
+    REQUIRE(true == ListenerFilter::prefix("ERR").instance().accept("ERR: disk full"));
+
+    REQUIRE(true == ListenerFilter::sample(1).acceptsAll());
+    REQUIRE(true == ListenerFilter::sample(0).acceptsAll());
+}
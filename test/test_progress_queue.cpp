@@ -0,0 +1,181 @@
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#define CATCH_CONFIG_MAIN
+#include <catch.hpp>
+
+#include "../progress_queue.hpp"
+
+using namespace std;
+using NodeEvent::MemoryOverflow;
+using NodeEvent::ProgressOverflow;
+using NodeEvent::ProgressQueue;
+using NodeEvent::QueueStats;
+
+TEST_CASE("Verify reports are dequeued in order with the time they were sent") {
+    ProgressQueue<int, 4> queue{std::make_shared<QueueStats>()};
+    int reports[] = {1, 2};
+
+    REQUIRE(true == queue.push(&reports[0], 1, 100));
+    REQUIRE(true == queue.push(&reports[1], 1, 200));
+    REQUIRE(true == queue.read_available());
+
+    ProgressQueue<int, 4>::Entry entry;
+    REQUIRE(true == queue.pop(entry));
+    REQUIRE(&reports[0] == entry.data);
+    REQUIRE(1 == entry.size);
+    REQUIRE(100 == entry.enqueued);
+
+    REQUIRE(true == queue.pop(entry));
+    REQUIRE(&reports[1] == entry.data);
+    REQUIRE(200 == entry.enqueued);
+
+    REQUIRE(false == queue.pop(entry));
+    REQUIRE(false == queue.read_available());
+}
+
+TEST_CASE("Verify a full queue drops reports and counts them") {
+    auto stats = std::make_shared<QueueStats>();
+    ProgressQueue<int, 2> queue{stats};
+    int report = 0;
+
+    REQUIRE(true == queue.push(&report, 1, 0));
+    REQUIRE(true == queue.push(&report, 1, 0));
+    REQUIRE(false == queue.push(&report, 1, 0));
+
+    ProgressQueue<int, 2>::Entry entry;
+    REQUIRE(true == queue.pop(entry));
+    REQUIRE(true == queue.push(&report, 1, 0));
+
+    auto s = queue.stats().snapshot();
+    REQUIRE(3 == s.enqueued);
+    REQUIRE(1 == s.dropped);
+    REQUIRE(2 == s.high_water);
+    REQUIRE(stats.get() == &queue.stats());
+}
+
+TEST_CASE("Verify a queue overflowing into memory keeps every report, in order") {
+    auto stats = std::make_shared<QueueStats>();
+    ProgressQueue<int, 2> queue{stats};
+    queue.setOverflow(std::unique_ptr<ProgressOverflow<int>>(new MemoryOverflow<int>()));
+    REQUIRE(true == queue.empty());
+
+    for (int i = 0; i < 10; ++i) {
+        // the queue frees what it overflows, as the workers' reports are allocated with new[]
+        auto report = new int[1];
+        report[0] = i;
+        REQUIRE(true == queue.push(report, 1, i));
+    }
+    REQUIRE(false == queue.empty());
+    REQUIRE(true == queue.overflowing());
+
+    ProgressQueue<int, 2>::Entry entry;
+    for (int i = 0; i < 10; ++i) {
+        REQUIRE(true == queue.pop(entry));
+        REQUIRE(i == entry.data[0]);
+        REQUIRE(static_cast<uint64_t>(i) == entry.enqueued);
+        delete[] entry.data;
+    }
+    REQUIRE(false == queue.pop(entry));
+    REQUIRE(true == queue.empty());
+
+    auto s = stats->snapshot();
+    REQUIRE(2 == s.enqueued);
+    REQUIRE(8 == s.overflowed);
+    REQUIRE(0 == s.dropped);
+}
+
+TEST_CASE("Verify a blocking push waits for room, up to its timeout") {
+    auto stats = std::make_shared<QueueStats>();
+    ProgressQueue<int, 2> queue{stats};
+    int report = 0;
+    REQUIRE(true == queue.push_blocking(&report, 1, 0, std::chrono::milliseconds(10)));
+    REQUIRE(true == queue.push_blocking(&report, 1, 0, std::chrono::milliseconds(10)));
+
+    auto start = std::chrono::steady_clock::now();
+    REQUIRE(false == queue.push_blocking(&report, 1, 0, std::chrono::milliseconds(20)));
+    REQUIRE(std::chrono::steady_clock::now() - start >= std::chrono::milliseconds(20));
+    REQUIRE(1 == stats->snapshot().dropped);
+
+    std::atomic<bool> pushed{false};
+    std::thread producer([&queue, &report, &pushed]() {
+        pushed = queue.push_blocking(&report, 1, 0, std::chrono::nanoseconds::max());
+    });
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    REQUIRE(false == pushed);
+
+    ProgressQueue<int, 2>::Entry entry;
+    REQUIRE(true == queue.pop(entry));
+    producer.join();
+    REQUIRE(true == pushed);
+    REQUIRE(3 == stats->snapshot().enqueued);
+    REQUIRE(1 == stats->snapshot().dropped);
+}
+
+TEST_CASE("Verify a blocking push gives up once told to stop, without counting a drop") {
+    auto stats = std::make_shared<QueueStats>();
+    ProgressQueue<int, 1> queue{stats};
+    int report = 0;
+    REQUIRE(true == queue.push(&report, 1, 0));
+
+    std::atomic<bool> stop{false};
+    std::atomic<int> pushed{-1};
+    std::thread producer([&queue, &report, &stop, &pushed]() {
+        pushed = queue.push_blocking(&report, 1, 0, std::chrono::nanoseconds::max(), [&stop]() { return stop.load(); });
+    });
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    REQUIRE(-1 == pushed);
+
+    stop = true;
+    queue.wake();
+    producer.join();
+    REQUIRE(0 == pushed);
+    REQUIRE(1 == stats->snapshot().enqueued);
+    REQUIRE(0 == stats->snapshot().dropped);
+}
+
+TEST_CASE("Verify blocking pushes from many producers lose nothing") {
+    auto stats = std::make_shared<QueueStats>();
+    ProgressQueue<size_t, 4> queue{stats};
+    const size_t producers = 8;
+    const size_t reports = 2000;
+
+    // Catch assertions aren't thread safe, so the producers only count their failed pushes
+    std::atomic<size_t> failed{0};
+    std::vector<std::thread> threads;
+    for (size_t p = 0; p < producers; ++p) {
+        threads.emplace_back([&queue, &failed, p, reports]() {
+            for (size_t i = 0; i < reports; ++i) {
+                auto report = new size_t[1];
+                report[0] = p * reports + i;
+                if (!queue.push_blocking(report, 1, 0, std::chrono::nanoseconds::max())) {
+                    delete[] report;
+                    ++failed;
+                }
+            }
+        });
+    }
+
+    // every producer's reports arrive in the order it pushed them
+    std::vector<size_t> next(producers, 0);
+    ProgressQueue<size_t, 4>::Entry entry;
+    for (size_t received = 0; received < producers * reports;) {
+        if (queue.pop(entry)) {
+            size_t p = entry.data[0] / reports;
+            REQUIRE(p * reports + next[p]++ == entry.data[0]);
+            delete[] entry.data;
+            ++received;
+        } else {
+            std::this_thread::yield();
+        }
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    REQUIRE(0 == failed);
+    REQUIRE(producers * reports == stats->snapshot().enqueued);
+    REQUIRE(0 == stats->snapshot().dropped);
+}
@@ -0,0 +1,63 @@
+#include <thread>
+#include <vector>
+
+#define CATCH_CONFIG_MAIN
+#include <catch.hpp>
+
+#include "../queue_stats.hpp"
+
+using namespace std;
+using NodeEvent::QueueStats;
+
+TEST_CASE("Verify enqueued and dropped reports are counted across threads") {
+    QueueStats stats;
+    std::vector<std::thread> producers;
+
+    for (size_t n = 0; n < 8; ++n) {
+        producers.emplace_back([&stats, n]() {
+            for (size_t i = 0; i < 1000; ++i) {
+                stats.sent(i % 4 != 0, n + 1);
+            }
+        });
+    }
+    for (auto& p : producers) {
+        p.join();
+    }
+
+    auto s = stats.snapshot();
+    REQUIRE(6000 == s.enqueued);
+    REQUIRE(2000 == s.dropped);
+    REQUIRE(8 == s.high_water);
+}
+
+TEST_CASE("Verify drains are counted") {
+    QueueStats stats;
+    stats.drained(3, 100);
+    stats.drained(10, 200);
+    stats.drained(1, 300);
+
+    auto s = stats.snapshot();
+    REQUIRE(3 == s.drains);
+    REQUIRE(14 == s.drained);
+    REQUIRE(10 == s.max_drained);
+    REQUIRE(3 == s.wakeup.count);
+    REQUIRE(s.wakeup.p50 == Approx(200).epsilon(0.05));
+    REQUIRE(300 == s.wakeup.max);
+}
+
+TEST_CASE("Verify reset zeroes every counter") {
+    QueueStats stats;
+    stats.sent(true, 5);
+    stats.sent(false, 5);
+    stats.drained(1, 300);
+    stats.reset();
+
+    auto s = stats.snapshot();
+    REQUIRE(0 == s.enqueued);
+    REQUIRE(0 == s.dropped);
+    REQUIRE(0 == s.high_water);
+    REQUIRE(0 == s.drains);
+    REQUIRE(0 == s.drained);
+    REQUIRE(0 == s.max_drained);
+    REQUIRE(0 == s.wakeup.count);
+}
@@ -139,7 +139,7 @@ TEST_CASE("Test that the reader blocks correctly when ringbuffer is empty") {
 }
 
 typedef size_t TestType;
-#define enqueue(VALUE) do { auto _t = new TestType[1]; _t[0] = VALUE; buf.push_blocking(_t); } while(0)
+#define enqueue(VALUE) do { auto _t = new TestType[1]; _t[0] = VALUE; buf.push_blocking(static_cast<const TestType*>(_t)); } while(0)
 #define dequeue(VALUE) do { auto _t = buf.pop_blocking(); REQUIRE(_t[0] == VALUE); delete[] _t; } while(0)
 
 TEST_CASE("Test that the ringbuffer cycles") {
@@ -178,7 +178,7 @@ TEST_CASE("Test multi-producer/multi-consumer") {
                 while(buf.read_available()) {
                     const size_t* m;
                     if(buf.pop(m)) {
-                        delete m;
+                        delete[] m;
                         ++consumer_bucket_counts[n];
                     }
                 }
@@ -0,0 +1,154 @@
+#include <poll.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <map>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+#define CATCH_CONFIG_MAIN
+#include <catch.hpp>
+
+#include "../shared_memory_ring.hpp"
+
+using namespace std;
+using NodeEvent::SharedMemoryRing;
+
+typedef SharedMemoryRing::Report Report;
+
+static std::string ringName() { return "/node-event-test-" + std::to_string(getpid()); }
+
+TEST_CASE("Verify events are popped in the order they were pushed") {
+    SharedMemoryRing ring{ringName(), 10, 64};
+    REQUIRE(16 == ring.capacity());
+    REQUIRE(false == ring.read_available());
+
+    for (size_t i = 0; i < 16; ++i) {
+        REQUIRE(true == ring.push(Report{"test", "Test" + std::to_string(i)}));
+    }
+    REQUIRE(false == ring.push(Report{"test", "Test16"}));
+    REQUIRE(1 == ring.dropped());
+
+    // positions wrap around the slots
+    Report out;
+    for (size_t i = 0; i < 100; ++i) {
+        REQUIRE(true == ring.pop(out));
+        REQUIRE("test" == out.first);
+        REQUIRE("Test" + std::to_string(i) == out.second);
+        REQUIRE(true == ring.push(Report{"test", "Test" + std::to_string(i + 16)}));
+    }
+    REQUIRE(true == ring.read_available());
+}
+
+TEST_CASE("Verify events which can't fit in a slot are rejected") {
+    SharedMemoryRing ring{ringName(), 4, 64};
+    cemitter_shm* shm = cemitter_shm_open(ringName().c_str(), -1);
+    REQUIRE(nullptr != shm);
+
+    REQUIRE(1 == cemitter_shm_emit(shm, "test", std::string(64 - 26 - 4, 'x').c_str()));
+    REQUIRE(EVENTEMITTER_TOO_LARGE == cemitter_shm_emit(shm, "test", std::string(64 - 26 - 3, 'x').c_str()));
+    REQUIRE(EMSGSIZE == errno);
+    REQUIRE(0 == ring.dropped());
+    cemitter_shm_close(shm);
+}
+
+TEST_CASE("Verify only rings can be opened, and only once") {
+    REQUIRE(nullptr == cemitter_shm_open("/node-event-test-missing", -1));
+    REQUIRE(ENOENT == errno);
+
+    SharedMemoryRing ring{ringName(), 4, 64};
+    REQUIRE_THROWS_AS(SharedMemoryRing(ringName(), 4, 64), std::system_error);
+}
+
+TEST_CASE("Verify capacities too large to round up to a power of two are rejected") {
+    REQUIRE_THROWS_AS(SharedMemoryRing(ringName(), SharedMemoryRing::max_capacity + 1, 64), std::invalid_argument);
+    REQUIRE_THROWS_AS(SharedMemoryRing(ringName(), static_cast<size_t>(-1), 64), std::invalid_argument);
+}
+
+TEST_CASE("Verify the consumer is notified only when it sleeps") {
+    SharedMemoryRing ring{ringName(), 4, 64};
+    cemitter_shm* shm = cemitter_shm_open(ringName().c_str(), ring.fd());
+    REQUIRE(nullptr != shm);
+    struct pollfd pfd = {ring.fd(), POLLIN, 0};
+
+    REQUIRE(1 == cemitter_shm_emit(shm, "test", "Test0"));
+    REQUIRE(0 == poll(&pfd, 1, 0));
+
+    // an event is waiting, so don't sleep
+    REQUIRE(false == ring.sleep());
+    Report out;
+    REQUIRE(true == ring.pop(out));
+
+    REQUIRE(true == ring.sleep());
+    REQUIRE(1 == cemitter_shm_emit(shm, "test", "Test1"));
+    REQUIRE(1 == poll(&pfd, 1, 0));
+    ring.wake();
+    REQUIRE(0 == poll(&pfd, 1, 0));
+
+    // only the first push after sleeping notifies
+    REQUIRE(1 == cemitter_shm_emit(shm, "test", "Test2"));
+    REQUIRE(0 == poll(&pfd, 1, 0));
+    cemitter_shm_close(shm);
+}
+
+TEST_CASE("Verify events from producer processes each arrive in order") {
+    const size_t processes = 4;
+    const size_t threads = 2;
+    const size_t events = 10000;
+    const std::string name = ringName();
+    SharedMemoryRing ring{name, 64, 64};
+
+    std::vector<pid_t> children;
+    for (size_t p = 0; p < processes; ++p) {
+        pid_t pid = fork();
+        if (pid == 0) {
+            cemitter_shm* shm = cemitter_shm_open(name.c_str(), ring.fd());
+            if (!shm) {
+                _exit(1);
+            }
+            std::vector<std::thread> producers;
+            for (size_t t = 0; t < threads; ++t) {
+                producers.emplace_back([shm, p, t, events]() {
+                    auto ev = "p" + std::to_string(p) + "t" + std::to_string(t);
+                    for (size_t i = 0; i < events; ++i) {
+                        while (!cemitter_shm_emit(shm, ev.c_str(), std::to_string(i).c_str())) {
+                            std::this_thread::yield();
+                        }
+                    }
+                });
+            }
+            for (auto& producer : producers) {
+                producer.join();
+            }
+            cemitter_shm_close(shm);
+            _exit(0);
+        }
+        REQUIRE(pid > 0);
+        children.push_back(pid);
+    }
+
+    std::map<std::string, size_t> next;
+    size_t received = 0;
+    Report out;
+    while (received < processes * threads * events) {
+        if (ring.pop(out)) {
+            REQUIRE(std::to_string(next[out.first]++) == out.second);
+            ++received;
+        } else if (ring.sleep()) {
+            struct pollfd pfd = {ring.fd(), POLLIN, 0};
+            REQUIRE(1 == poll(&pfd, 1, 5000));
+            ring.wake();
+        }
+    }
+    REQUIRE(processes * threads == next.size());
+    REQUIRE(false == ring.read_available());
+
+    for (auto pid : children) {
+        int status = -1;
+        REQUIRE(pid == waitpid(pid, &status, 0));
+        REQUIRE(0 == status);
+    }
+}
@@ -0,0 +1,104 @@
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#define CATCH_CONFIG_MAIN
+#include <catch.hpp>
+
+#include "../slot_map.hpp"
+
+using namespace std;
+using NodeEvent::SlotMap;
+
+TEST_CASE("Verify insert, find and erase") {
+    SlotMap<std::string> map;
+
+    auto k1 = map.insert("Test 1");
+    auto k2 = map.insert("Test 2");
+    REQUIRE(k1 != k2);
+    REQUIRE(2 == map.size());
+    REQUIRE("Test 1" == *map.find(k1));
+    REQUIRE("Test 2" == *map.find(k2));
+
+    REQUIRE(true == map.erase(k1));
+    REQUIRE(nullptr == map.find(k1));
+    REQUIRE("Test 2" == *map.find(k2));
+    REQUIRE(1 == map.size());
+
+    // erasing twice fails the second time
+    REQUIRE(false == map.erase(k1));
+    REQUIRE(false == map.erase(SlotMap<std::string>::null_key));
+}
+
+TEST_CASE("Verify stale keys stay stale when slots are reused") {
+    SlotMap<std::string> map;
+
+    auto k1 = map.insert("Test 1");
+    map.erase(k1);
+    auto k2 = map.insert("Test 2");
+
+    // the slot is reused, but under a new generation
+    REQUIRE(static_cast<uint32_t>(k1) == static_cast<uint32_t>(k2));
+    REQUIRE(k1 != k2);
+    REQUIRE(nullptr == map.find(k1));
+    REQUIRE(false == map.erase(k1));
+    REQUIRE("Test 2" == *map.find(k2));
+}
+
+TEST_CASE("Verify values stay contiguous and keys follow moved values") {
+    SlotMap<size_t> map;
+    std::vector<SlotMap<size_t>::key_type> keys;
+
+    for (size_t i = 0; i < 100; ++i) {
+        keys.push_back(map.insert(i));
+    }
+    for (size_t i = 0; i < 100; i += 2) {
+        REQUIRE(true == map.erase(keys[i]));
+    }
+
+    REQUIRE(50 == map.size());
+    REQUIRE(50 == static_cast<size_t>(std::distance(map.begin(), map.end())));
+    for (size_t i = 1; i < 100; i += 2) {
+        REQUIRE(i == *map.find(keys[i]));
+    }
+    for (size_t pos = 0; pos < map.size(); ++pos) {
+        REQUIRE(*(map.begin() + pos) == *map.find(map.key_at(pos)));
+    }
+}
+
+TEST_CASE("Verify clear makes every key stale") {
+    SlotMap<std::string> map;
+
+    auto k1 = map.insert("Test 1");
+    auto k2 = map.insert("Test 2");
+    map.clear();
+
+    REQUIRE(true == map.empty());
+    REQUIRE(nullptr == map.find(k1));
+    REQUIRE(nullptr == map.find(k2));
+
+    auto k3 = map.insert("Test 3");
+    REQUIRE(k3 != k1);
+    REQUIRE(k3 != k2);
+    REQUIRE("Test 3" == *map.find(k3));
+}
+
+TEST_CASE("Verify values are iterated in insertion order after erasing") {
+    SlotMap<size_t> map;
+    std::vector<SlotMap<size_t>::key_type> keys;
+
+    for (size_t i = 0; i < 10; ++i) {
+        keys.push_back(map.insert(i));
+    }
+    map.erase(keys[0]);
+    map.erase(keys[4]);
+    map.erase(keys[9]);
+    // a reused slot goes to the end, as a new value should
+    map.insert(10);
+
+    REQUIRE((std::vector<size_t>{1, 2, 3, 5, 6, 7, 8, 10}) == std::vector<size_t>(map.begin(), map.end()));
+    REQUIRE(5 == *map.find(keys[5]));
+    for (size_t pos = 0; pos < map.size(); ++pos) {
+        REQUIRE(*(map.begin() + pos) == *map.find(map.key_at(pos)));
+    }
+}
@@ -0,0 +1,143 @@
+#include <memory>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#define CATCH_CONFIG_MAIN
+#include <catch.hpp>
+
+#include "../spill_file.hpp"
+
+using namespace std;
+using NodeEvent::ProgressOverflow;
+using NodeEvent::ProgressQueue;
+using NodeEvent::QueueStats;
+using NodeEvent::QueuedReport;
+using NodeEvent::SpillFile;
+
+typedef std::pair<std::string, std::string> Report;
+
+static Report* report(const std::string& ev, const std::string& value) {
+    auto r = new Report[1];
+    r[0] = {ev, value};
+    return r;
+}
+
+TEST_CASE("Verify reports are read back in order, across segments") {
+    // small segments, so that the reports span several of them
+    SpillFile<Report> spill{"/tmp", 256};
+    REQUIRE(true == spill.empty());
+
+    for (size_t i = 0; i < 100; ++i) {
+        std::unique_ptr<Report[]> r{report("test", "Test" + std::to_string(i))};
+        REQUIRE(true == spill.push(r.get(), 1, i));
+    }
+    REQUIRE(100 == spill.size());
+
+    QueuedReport<Report> out;
+    for (size_t i = 0; i < 100; ++i) {
+        REQUIRE(true == spill.pop(out));
+        REQUIRE(1 == out.size);
+        REQUIRE(i == out.enqueued);
+        REQUIRE("test" == out.data[0].first);
+        REQUIRE("Test" + std::to_string(i) == out.data[0].second);
+        delete[] out.data;
+    }
+    REQUIRE(false == spill.pop(out));
+    REQUIRE(true == spill.empty());
+}
+
+TEST_CASE("Verify multi-event reports, empty values and reports larger than a segment") {
+    SpillFile<Report> spill{"/tmp", 64};
+    std::string big(1000, 'x');
+    Report reports[] = {{"a", ""}, {"b", big}, {"", "c"}};
+    REQUIRE(true == spill.push(reports, 3, 42));
+
+    QueuedReport<Report> out;
+    REQUIRE(true == spill.pop(out));
+    REQUIRE(3 == out.size);
+    REQUIRE(42 == out.enqueued);
+    for (size_t i = 0; i < 3; ++i) {
+        REQUIRE(reports[i] == out.data[i]);
+    }
+    delete[] out.data;
+}
+
+TEST_CASE("Verify a missing directory is reported when the spill file is created") {
+    REQUIRE_THROWS_AS((SpillFile<Report>{"/nonexistent/directory", 4096}), std::system_error);
+}
+
+TEST_CASE("Verify a queue with an overflow keeps every report, in order") {
+    auto stats = std::make_shared<QueueStats>();
+    ProgressQueue<Report, 4> queue{stats};
+    queue.setOverflow(std::unique_ptr<ProgressOverflow<Report>>(new SpillFile<Report>("/tmp", 4096)));
+
+    size_t sent = 0;
+    size_t received = 0;
+    QueuedReport<Report> out;
+    auto drain = [&](size_t n) {
+        for (size_t i = 0; i < n && queue.pop(out); ++i) {
+            REQUIRE("Test" + std::to_string(received++) == out.data[0].second);
+            delete[] out.data;
+        }
+    };
+
+    // overflow, then read part of the way, so that new reports must follow the overflowed ones
+    for (; sent < 10; ++sent) {
+        REQUIRE(true == queue.push(report("test", "Test" + std::to_string(sent)), 1, sent));
+    }
+    REQUIRE(true == queue.overflowing());
+    drain(6);
+    for (; sent < 20; ++sent) {
+        REQUIRE(true == queue.push(report("test", "Test" + std::to_string(sent)), 1, sent));
+    }
+    drain(100);
+    REQUIRE(20 == received);
+    REQUIRE(false == queue.overflowing());
+    REQUIRE(false == queue.read_available());
+
+    // caught up, so the ring is used again
+    REQUIRE(true == queue.push(report("test", "Test20"), 1, 20));
+    REQUIRE(false == queue.overflowing());
+    drain(1);
+
+    auto s = stats->snapshot();
+    REQUIRE(5 == s.enqueued);
+    REQUIRE(16 == s.overflowed);
+    REQUIRE(0 == s.dropped);
+}
+
+TEST_CASE("Verify concurrent producers overflowing") {
+    ProgressQueue<Report, 16> queue{std::make_shared<QueueStats>()};
+    queue.setOverflow(std::unique_ptr<ProgressOverflow<Report>>(new SpillFile<Report>("/tmp", 1 << 16)));
+
+    std::vector<std::thread> producers;
+    for (size_t p = 0; p < 4; ++p) {
+        producers.emplace_back([&queue, p]() {
+            for (size_t i = 0; i < 5000; ++i) {
+                queue.push(report(std::to_string(p), std::to_string(i)), 1, 0);
+            }
+        });
+    }
+
+    // each producer's reports arrive in the order it sent them
+    std::vector<size_t> next(4, 0);
+    size_t received = 0;
+    QueuedReport<Report> out;
+    while (received < 20000) {
+        if (!queue.pop(out)) {
+            std::this_thread::yield();
+            continue;
+        }
+        size_t p = std::stoul(out.data[0].first);
+        REQUIRE(next[p]++ == std::stoul(out.data[0].second));
+        delete[] out.data;
+        ++received;
+    }
+    for (auto& t : producers) {
+        t.join();
+    }
+    REQUIRE(false == queue.read_available());
+}
@@ -0,0 +1,98 @@
+/*
+ * Copyright 2017 Scoop Technologies
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated
+ * documentation files (the "Software"), to deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE
+ * WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+ * OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#pragma once
+#ifndef _NODE_EVENT_TYPED_EVENT_EMITTER_H
+#define _NODE_EVENT_TYPED_EVENT_EMITTER_H
+
+#include <functional>
+#include <string>
+#include <type_traits>
+
+#include "event_schema.hpp"
+#include "eventemitter_impl.hpp"
+
+namespace NodeEvent {
+/// TypedEventEmitter is an EventEmitter for the events of a schema (see EventSchema). Each event is pinned as it is
+/// constructed, under its number in the schema, so emitting one of them by tag finds its listeners by index rather
+/// than by hashing its name, and converts its value with EventValue. Listeners added by name, including from
+/// javascript and for patterns, receive the schema's events as usual.
+template <class Schema>
+class TypedEventEmitter : public EventEmitter {
+ public:
+    typedef Schema schema_type;
+
+    TypedEventEmitter() : EventEmitter() {
+        for (size_t i = 0; i < Schema::size; ++i) {
+            pin(Schema::name(i));
+        }
+    }
+
+    using EventEmitter::emit;
+    using EventEmitter::emitInline;
+    using EventEmitter::onNative;
+
+    /// @returns the number E is pinned as
+    template <class E>
+    static constexpr size_t pinned() {
+        return Schema::template index<E>();
+    }
+
+    /// Emit a value to any registered callbacks for the event E
+    ///
+    /// @param[in] value - the value to emit
+    ///
+    /// @returns true if the event has listeners, false otherwise
+    template <class E>
+    bool emit(const typename E::value_type& value) const {
+        return emit(pinned<E>(), EventValue<typename E::value_type>::encode(value));
+    }
+
+    /// Emit the event E, which has no value
+    template <class E>
+    bool emit() const {
+        static_assert(std::is_void<typename E::value_type>::value, "the event has a value");
+        return emit(pinned<E>(), EventValue<void>::encode());
+    }
+
+    /// Set a native listener for the event E, which receives its values converted back from strings
+    ///
+    /// @param[in] listener - the listener to invoke
+    /// @param[in] dispatch - whether to invoke the listener inline on the emitting thread, or on the loop thread
+    /// @param[in] filter - the listener is only invoked for values the filter accepts
+    ///
+    /// @returns a handle for removing the listener with off()
+    template <class E>
+    ListenerHandle onNative(std::function<void(const typename E::value_type&)> listener,
+                            NativeDispatch dispatch = NativeDispatch::Loop,
+                            const ListenerFilter& filter = ListenerFilter()) {
+        typedef EventValue<typename E::value_type> Value;
+        return onNative(Schema::name(pinned<E>()),
+                        [listener](const char*, const char* value) { listener(Value::decode(value)); }, dispatch,
+                        filter);
+    }
+
+    /// Set a native listener for the event E, which has no value
+    template <class E>
+    ListenerHandle onNative(std::function<void()> listener, NativeDispatch dispatch = NativeDispatch::Loop) {
+        static_assert(std::is_void<typename E::value_type>::value, "the event has a value");
+        return onNative(Schema::name(pinned<E>()), [listener](const char*, const char*) { listener(); }, dispatch);
+    }
+};
+
+}  // namespace NodeEvent
+
+#endif